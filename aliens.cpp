@@ -1,4 +1,8 @@
+#include <algorithm>
 #include <QByteArray>
+#include <QList>
+#include <QMutexLocker>
+#include <QtConcurrent/QtConcurrentRun>
 #include "aliens.h"
 #include "imageconverter.h"
 
@@ -44,22 +48,35 @@ const QVector<QString> Aliens::s_animationMap =
 
 Aliens::Aliens(DatLibrary& lib, Palette& pal) :
   DatTable<AlienTableEntry> (lib),
-  m_pal(&pal)
+  m_pal(&pal),
+  m_frameCache(ANM_FRAME_CACHE_BUDGET_BYTES),
+  m_overlayCache(ANM_OVERLAY_CACHE_BUDGET_BYTES)
 {
-
+  // one thread for the animation that was asked for, and one for prefetching
+  m_framePool.setMaxThreadCount(2);
 }
 
 Aliens::~Aliens()
 {
-
+  m_framePool.waitForDone();
 }
 
 /**
- * Clears the locally cached data.
+ * Clears the locally cached data, including any decoded animation frames. Any background
+ * frame loads are allowed to finish first, since they read from the DAT library.
  */
 void Aliens::clear()
 {
+  m_framePool.waitForDone();
+
+  QMutexLocker lock(&m_frameCacheMutex);
+  m_frameCache.clear();
+  m_pendingFrameLoads.clear();
   m_alienList.clear();
+  DatTable<AlienTableEntry>::clear();
+
+  QMutexLocker overlayLock(&m_overlayCacheMutex);
+  m_overlayCache.clear();
 }
 
 /**
@@ -70,10 +87,7 @@ void Aliens::clear()
  */
 QMap<int,Alien> Aliens::getList()
 {
-  if (m_alienList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   return m_alienList;
 }
@@ -87,15 +101,12 @@ bool Aliens::getAlien(int id, Alien& alien)
 {
   bool status = false;
 
-  if (m_alienList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_alienList.contains(id))
   {
     status = true;
-    alien = m_alienList[id];
+    alien = m_alienList.value(id);
   }
 
   return status;
@@ -110,14 +121,11 @@ QString Aliens::getName(int id)
 {
   QString name("");
 
-  if (m_alienList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_alienList.contains(id))
   {
-    name = m_alienList[id].name;
+    name = m_alienList.value(id).name;
   }
 
   return name;
@@ -132,14 +140,11 @@ AlienRace Aliens::getRace(int id)
 {
   AlienRace race = AlienRace_Invalid;
 
-  if (m_alienList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_alienList.contains(id))
   {
-    race = m_alienList[id].race;
+    race = m_alienList.value(id).race;
   }
 
   return race;
@@ -157,7 +162,7 @@ bool Aliens::populateList()
   {
     status = true;
     int index = 0;
-    AlienTableEntry* currentEntry = getEntry(index);
+    const AlienTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -192,40 +197,209 @@ bool Aliens::getAnimationFrames(int alienId, QMap<int, QImage>& frames)
 {
   bool status = true;
 
-  if ((alienId > 0) && (alienId < s_animationMap.size()))
+  if ((alienId > 0) && (alienId < s_animationMap.size()) && !getCachedAnimationFrames(alienId, frames))
   {
-    // first, determine the filename of the ANM and attempt to open it
-    const QString anmFilename = QString("%1.ANM").arg(s_animationMap[alienId]);
-    QByteArray anmFileData;
+    const QString anmFilename = getAnmFilename(alienId);
+    QMap<int,QImage> decodedFrames;
+    status = getAnimationFramesForAnm(anmFilename, decodedFrames);
 
-    if (m_lib->getFileByName(DatFileType_ANIM, anmFilename, anmFileData))
+    if (status)
     {
-      // the ASCII string for the palette filename begins at offset 00 in the ANM file
-      const QString palFilename = QString::fromLocal8Bit(anmFileData.data());
-      QVector<QRgb> pal;
+      insertCachedFrames(anmFilename, decodedFrames);
+    }
+    frames = decodedFrames;
+  }
+
+  return status;
+}
 
-      if (m_pal->paletteByName(DatFileType_ANIM, palFilename, pal))
+/**
+ * Starts decoding the animation frames for the specified alien on a background thread,
+ * unless they are already in the cache or are already being decoded. Once the returned
+ * future has finished, the frames can be retrieved with getCachedAnimationFrames() (unless
+ * decoding failed, or they were evicted in the meantime). Requesting the frames of aliens
+ * that are likely to be viewed soon will prefetch them.
+ * @return Future that finishes when the frames are available; if they already are, the
+ * returned future is already finished.
+ */
+QFuture<void> Aliens::requestAnimationFrames(int alienId)
+{
+  QFuture<void> future;
+  const QString anmFilename = getAnmFilename(alienId);
+
+  if (!anmFilename.isEmpty())
+  {
+    // the background task can't remove itself from the list of pending loads
+    // until this lock is released, so it is always added to the list first
+    QMutexLocker lock(&m_frameCacheMutex);
+
+    if (!m_frameCache.contains(anmFilename))
+    {
+      if (m_pendingFrameLoads.contains(anmFilename))
+      {
+        future = m_pendingFrameLoads[anmFilename];
+      }
+      else
       {
-        // get a list of frame numbers, and the list of composite sections (.del files) used to build each frame
-        const QMap<int, QVector<int>> frameList = getListOfFrames(anmFileData);
+        future = QtConcurrent::run(&m_framePool, this, &Aliens::loadAnimationFrames, anmFilename);
+        m_pendingFrameLoads.insert(anmFilename, future);
+      }
+    }
+  }
 
-        // the prefix used on the .del files is the first two letters of the ANM filename, but in lowercase
-        const QString delFilenamePrefix = anmFilename.mid(0, 2).toLower();
+  return future;
+}
 
-        foreach (int frameNum, frameList.keys())
+/**
+ * Gets the animation frames for the specified alien, but only if they have already been
+ * decoded and are still in the cache.
+ * @return True if the frames were found in the cache; false otherwise.
+ */
+bool Aliens::getCachedAnimationFrames(int alienId, QMap<int,QImage>& frames)
+{
+  bool status = false;
+  const QString anmFilename = getAnmFilename(alienId);
+
+  QMutexLocker lock(&m_frameCacheMutex);
+  const QMap<int,QImage>* cachedFrames = m_frameCache.object(anmFilename);
+  if (cachedFrames)
+  {
+    frames = *cachedFrames;
+    status = true;
+  }
+
+  return status;
+}
+
+/**
+ * Decodes all the frames of the specified animation and puts them in the cache. This runs
+ * on a thread from the frame pool.
+ */
+void Aliens::loadAnimationFrames(QString anmFilename)
+{
+  QMap<int,QImage> frames;
+  const bool status = getAnimationFramesForAnm(anmFilename, frames);
+
+  if (status)
+  {
+    insertCachedFrames(anmFilename, frames);
+  }
+
+  QMutexLocker lock(&m_frameCacheMutex);
+  m_pendingFrameLoads.remove(anmFilename);
+}
+
+/**
+ * Adds a set of decoded animation frames to the cache, with a cost equal to their total
+ * size in bytes. (Callers only cache animations that decoded successfully, so that a
+ * failure is retried the next time the animation is requested.)
+ */
+void Aliens::insertCachedFrames(QString anmFilename, const QMap<int,QImage>& frames)
+{
+  qsizetype cost = 0;
+  foreach (const QImage& frame, frames)
+  {
+    cost += frame.sizeInBytes();
+  }
+
+  QMutexLocker lock(&m_frameCacheMutex);
+  m_frameCache.insert(anmFilename, new QMap<int,QImage>(frames), static_cast<int>(qMax<qsizetype>(cost, 1)));
+}
+
+/**
+ * Gets the name of the animation (.ANM) file used for the specified alien, or an empty
+ * string if the alien ID is out of range.
+ */
+QString Aliens::getAnmFilename(int alienId)
+{
+  QString anmFilename;
+
+  if ((alienId > 0) && (alienId < s_animationMap.size()))
+  {
+    anmFilename = QString("%1.ANM").arg(s_animationMap[alienId]);
+  }
+
+  return anmFilename;
+}
+
+/**
+ * Populates the supplied container with a series of QImages, where each one is an
+ * animation frame from the specified .ANM file. A missing .ANM file is not treated
+ * as an error; the container is simply left empty.
+ * @return True when all of the frame data was read and decoded successfully; false otherwise.
+ */
+bool Aliens::getAnimationFramesForAnm(QString anmFilename, QMap<int, QImage>& frames) const
+{
+  bool status = true;
+  QByteArray anmFileData;
+
+  if (m_lib->getFileByName(DatFileType_ANIM, anmFilename, anmFileData))
+  {
+    // the ASCII string for the palette filename begins at offset 00 in the ANM file
+    const QString palFilename = QString::fromLocal8Bit(anmFileData.constData());
+    QVector<QRgb> pal;
+
+    if (m_pal->paletteByName(DatFileType_ANIM, palFilename, pal))
+    {
+      // get a list of frame numbers, and the list of composite sections (.del files) used to build each frame
+      const QMap<int, QVector<int>> frameList = getListOfFrames(anmFileData);
+
+      // the prefix used on the .del files is the first two letters of the ANM filename, but in lowercase
+      const QByteArray delFilenamePrefix = anmFilename.mid(0, 2).toLower().toLatin1();
+
+      // Most frames begin with the same few overlays as other frames (typically a full
+      // background image followed by a few small changes), so the overlay lists form a
+      // tree with the common prefixes near the root. Visiting the frames in order of their
+      // overlay lists walks this tree depth-first: the partial image after each prefix is
+      // kept on a stack, and each frame only needs the overlays that follow the prefix it
+      // shares with the previous one.
+      QList<QVector<int> > overlayLists = frameList.values();
+      std::sort(overlayLists.begin(), overlayLists.end());
+
+      QMap<QVector<int>, QImage> builtFrames;
+      QVector<int> prefix;
+      QVector<QImage> partialImages;
+      partialImages.append(QImage());
+
+      foreach (const QVector<int>& overlayList, overlayLists)
+      {
+        int shared = 0;
+        while ((shared < prefix.size()) && (shared < overlayList.size()) &&
+               (prefix[shared] == overlayList[shared]))
         {
-          if (status)
+          shared++;
+        }
+        prefix.resize(shared);
+        partialImages.resize(shared + 1);
+
+        while (status && (prefix.size() < overlayList.size()))
+        {
+          const int delNumber = overlayList[prefix.size()];
+          QImage image = partialImages.last();
+          DelOverlay overlay;
+
+          // an overlay file that isn't present in the DAT is skipped
+          if (getOverlay(delFilenamePrefix, delNumber, overlay) &&
+              !ImageConverter::applyOverlay(overlay, pal, image))
           {
-            QImage frame;
-            if (buildFrame(frameList[frameNum], delFilenamePrefix, pal, frame))
-            {
-              frames.insert(frameNum, frame);
-            }
-            else
-            {
-              status = false;
-            }
+            status = false;
           }
+
+          prefix.append(delNumber);
+          partialImages.append(image);
+        }
+
+        if (status)
+        {
+          builtFrames.insert(overlayList, partialImages.last());
+        }
+      }
+
+      if (status)
+      {
+        foreach (int frameNum, frameList.keys())
+        {
+          frames.insert(frameNum, builtFrames.value(frameList[frameNum]));
         }
       }
     }
@@ -235,31 +409,39 @@ bool Aliens::getAnimationFrames(int alienId, QMap<int, QImage>& frames)
 }
 
 /**
- * Reads each of the delta-encoded frame overlay files (*.DEL) specified by the
- * delIdList parameter, decodes them with the supplied palette data, and overlays
- * them all in the QImage provided by reference to produce a single complete
- * animation frame.
- * @return True when all of the DEL files were read and decoded successfully;
- * false otherwise.
+ * Gets the decoded overlay from the specified DEL file, decoding it (and adding it to the
+ * overlay cache) if it has not been decoded yet.
+ * @return True when the DEL file was found and decoded; false otherwise.
  */
-bool Aliens::buildFrame(QVector<int> delIdList, QString delFilenamePrefix, const QVector<QRgb> pal, QImage& frame) const
+bool Aliens::getOverlay(const QByteArray& delFilenamePrefix, int delNumber, DelOverlay& overlay) const
 {
-  bool status = true;
-  QByteArray delFileData;
+  bool status = false;
+  char delFilename[INDEX_FILENAME_LEN];
+  qsnprintf(delFilename, sizeof(delFilename), "%s%04d.del", delFilenamePrefix.constData(), delNumber);
+  const QString key = QString::fromLatin1(delFilename);
 
-  foreach (int delNumber, delIdList)
   {
-    const QString delFilename = delFilenamePrefix + QString("%1.del").arg(delNumber, 4, 10, QChar('0'));
-
-    if (status && m_lib->getFileByName(DatFileType_ANIM, delFilename, delFileData))
+    QMutexLocker lock(&m_overlayCacheMutex);
+    const DelOverlay* cachedOverlay = m_overlayCache.object(key);
+    if (cachedOverlay)
     {
-      if (!ImageConverter::delToImage(delFileData, pal, frame))
-      {
-        status = false;
-      }
+      overlay = *cachedOverlay;
+      status = true;
     }
   }
 
+  QByteArray delFileData;
+  if (!status &&
+      m_lib->getFileByKey(DatFileType_ANIM, DatFileKey(delFilename), delFileData) &&
+      ImageConverter::delToOverlay(delFileData, overlay))
+  {
+    status = true;
+
+    // if another thread decoded the same overlay in the meantime, this simply replaces it
+    QMutexLocker lock(&m_overlayCacheMutex);
+    m_overlayCache.insert(key, new DelOverlay(overlay), ImageConverter::overlaySize(overlay));
+  }
+
   return status;
 }
 
@@ -6,13 +6,25 @@
 #include <QString>
 #include <QImage>
 #include <QMap>
+#include <QHash>
+#include <QCache>
+#include <QMutex>
+#include <QFuture>
+#include <QThreadPool>
 #include "enums.h"
 #include "palette.h"
 #include "dattable.h"
+#include "imageconverter.h"
 
 #define ANM_RECORD_SIZE_BYTES 16
 #define ANM_FIRST_RECORD_OFFSET 0x1A
 
+//! Default limit on the total size of the decoded animation frames kept in the cache
+#define ANM_FRAME_CACHE_BUDGET_BYTES (48 * 1024 * 1024)
+
+//! Default limit on the total size of the decoded DEL overlays kept in the cache
+#define ANM_OVERLAY_CACHE_BUDGET_BYTES (16 * 1024 * 1024)
+
 struct Alien
 {
   int id;
@@ -27,7 +39,7 @@ typedef struct __attribute__((packed)) AlienTableEntry
   uint8_t unknown[5];
 } AlienTableEntry;
 
-class Aliens : DatTable<AlienTableEntry>
+class Aliens : public DatTable<AlienTableEntry>
 {
 public:
   Aliens(DatLibrary& lib, Palette& pal);
@@ -38,6 +50,11 @@ public:
   AlienRace getRace(int id);
   bool getAlien(int id, Alien& alien);
   bool getAnimationFrames(int id, QMap<int,QImage>& frames);
+  bool getAnimationFramesForAnm(QString anmFilename, QMap<int,QImage>& frames) const;
+  static QString getAnmFilename(int id);
+
+  QFuture<void> requestAnimationFrames(int id);
+  bool getCachedAnimationFrames(int id, QMap<int,QImage>& frames);
 
 protected:
   bool populateList();
@@ -47,8 +64,24 @@ private:
   static const QVector<QString> s_animationMap;
   QMap<int,Alien> m_alienList;
 
+  // decoded frames for each ANM file, shared by all the aliens that use the same
+  // file, and the background loads that are still in progress (both keyed by the
+  // ANM filename, and both guarded by m_frameCacheMutex)
+  QMutex m_frameCacheMutex;
+  QCache<QString,QMap<int,QImage> > m_frameCache;
+  QHash<QString,QFuture<void> > m_pendingFrameLoads;
+  QThreadPool m_framePool;
+
+  // decoded DEL overlays, keyed by DEL filename; the same overlays are used by many
+  // frames, and by every ANM file that shares a filename prefix
+  mutable QMutex m_overlayCacheMutex;
+  mutable QCache<QString,DelOverlay> m_overlayCache;
+
+  void loadAnimationFrames(QString anmFilename);
+  void insertCachedFrames(QString anmFilename, const QMap<int,QImage>& frames);
+
   QMap< int, QVector<int> > getListOfFrames(const QByteArray& anmData) const;
-  bool buildFrame(QVector<int> delIdList, QString delFilenamePrefix, const QVector<QRgb> pal, QImage& frame) const;
+  bool getOverlay(const QByteArray& delFilenamePrefix, int delNumber, DelOverlay& overlay) const;
 };
 
 #endif // ALIENS_H
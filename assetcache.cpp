@@ -0,0 +1,253 @@
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
+#include <QtEndian>
+#include "assetcache.h"
+
+// the primes used by the xxHash64 algorithm
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static inline quint64 rotl64(quint64 val, int bits)
+{
+  return (val << bits) | (val >> (64 - bits));
+}
+
+static inline quint64 xxhRound(quint64 acc, quint64 input)
+{
+  acc += input * XXH_PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * XXH_PRIME64_1;
+}
+
+static inline quint64 xxhMergeRound(quint64 acc, quint64 val)
+{
+  acc ^= xxhRound(0, val);
+  return (acc * XXH_PRIME64_1) + XXH_PRIME64_4;
+}
+
+AssetCache::AssetCache() :
+  m_maxBytes(ASSET_CACHE_DEFAULT_BUDGET_BYTES)
+{
+}
+
+/**
+ * Sets the directory that the cached assets are kept in, creating it if necessary, and then
+ * deletes the least recently used entries in it until the rest fit within the provided number
+ * of bytes. An empty string disables the cache. (The entries written during a session can take
+ * the directory past its budget until the next time it is set.)
+ */
+void AssetCache::setDirectory(const QString& dir, qint64 maxBytes)
+{
+  m_dir = (!dir.isEmpty() && QDir().mkpath(dir)) ? dir : QString();
+  m_maxBytes = qMax(maxBytes, static_cast<qint64>(0));
+
+  if (isEnabled())
+  {
+    prune();
+  }
+}
+
+/**
+ * Returns the directory that the cached assets are kept in, or an empty string if the
+ * cache is disabled.
+ */
+QString AssetCache::getDirectory() const
+{
+  return m_dir;
+}
+
+/**
+ * Returns true if a cache directory has been set.
+ */
+bool AssetCache::isEnabled() const
+{
+  return !m_dir.isEmpty();
+}
+
+QString AssetCache::getEntryFilename(quint64 key) const
+{
+  return QString("%1/%2" ASSET_CACHE_ENTRY_SUFFIX).arg(m_dir).arg(key, 16, 16, QChar('0'));
+}
+
+/**
+ * Deletes the least recently used entries until the total size of the rest is within the
+ * budget. Loading an entry updates its modification time, so the entries are kept in order
+ * of modification time, newest first, until the budget runs out.
+ */
+void AssetCache::prune() const
+{
+  const QFileInfoList entries = QDir(m_dir).entryInfoList(QStringList() << ("*" ASSET_CACHE_ENTRY_SUFFIX),
+                                                          QDir::Files, QDir::Time);
+  qint64 totalBytes = 0;
+
+  foreach (const QFileInfo& entry, entries)
+  {
+    totalBytes += entry.size();
+    if (totalBytes > m_maxBytes)
+    {
+      QFile::remove(entry.absoluteFilePath());
+    }
+  }
+}
+
+/**
+ * Computes the 64-bit xxHash (XXH64) of the provided data, which is fast enough to key the
+ * cache by the content of an asset's source data rather than by its name or location.
+ */
+quint64 AssetCache::hash(const char* data, int len, quint64 seed)
+{
+  const uchar* pos = reinterpret_cast<const uchar*>(data);
+  const uchar* const end = pos + qMax(len, 0);
+  quint64 h = 0;
+
+  if (len >= 32)
+  {
+    quint64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+    quint64 v2 = seed + XXH_PRIME64_2;
+    quint64 v3 = seed;
+    quint64 v4 = seed - XXH_PRIME64_1;
+
+    // the bulk of the data is consumed in 32-byte stripes, as four independent lanes
+    while ((end - pos) >= 32)
+    {
+      v1 = xxhRound(v1, qFromLittleEndian<quint64>(pos));
+      v2 = xxhRound(v2, qFromLittleEndian<quint64>(pos + 8));
+      v3 = xxhRound(v3, qFromLittleEndian<quint64>(pos + 16));
+      v4 = xxhRound(v4, qFromLittleEndian<quint64>(pos + 24));
+      pos += 32;
+    }
+
+    h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+    h = xxhMergeRound(h, v1);
+    h = xxhMergeRound(h, v2);
+    h = xxhMergeRound(h, v3);
+    h = xxhMergeRound(h, v4);
+  }
+  else
+  {
+    h = seed + XXH_PRIME64_5;
+  }
+
+  h += static_cast<quint64>(qMax(len, 0));
+
+  while ((end - pos) >= 8)
+  {
+    h ^= xxhRound(0, qFromLittleEndian<quint64>(pos));
+    h = (rotl64(h, 27) * XXH_PRIME64_1) + XXH_PRIME64_4;
+    pos += 8;
+  }
+
+  if ((end - pos) >= 4)
+  {
+    h ^= static_cast<quint64>(qFromLittleEndian<quint32>(pos)) * XXH_PRIME64_1;
+    h = (rotl64(h, 23) * XXH_PRIME64_2) + XXH_PRIME64_3;
+    pos += 4;
+  }
+
+  while (pos < end)
+  {
+    h ^= static_cast<quint64>(*pos) * XXH_PRIME64_5;
+    h = rotl64(h, 11) * XXH_PRIME64_1;
+    pos++;
+  }
+
+  // final avalanche, so that every input bit affects every output bit
+  h ^= h >> 33;
+  h *= XXH_PRIME64_2;
+  h ^= h >> 29;
+  h *= XXH_PRIME64_3;
+  h ^= h >> 32;
+
+  return h;
+}
+
+/**
+ * Reads the asset with the provided key from the cache. The entry is rejected (and deleted) if
+ * its header doesn't match, or if its contents don't match the hash that was stored with them
+ * (as would be the case if the file were truncated or damaged.) A successful load marks the
+ * entry as recently used by updating its modification time, where the platform allows that
+ * for a file that is open for reading.
+ * @return True if the asset was found and intact; false otherwise.
+ */
+bool AssetCache::load(quint64 key, QByteArray& data) const
+{
+  bool status = false;
+
+  if (isEnabled())
+  {
+    QFile inFile(getEntryFilename(key));
+
+    if (inFile.open(QIODevice::ReadOnly))
+    {
+      QDataStream ds(&inFile);
+      ds.setVersion(QDataStream::Qt_5_12);
+
+      quint32 magic = 0;
+      quint32 version = 0;
+      quint64 storedKey = 0;
+      quint64 dataHash = 0;
+      ds >> magic >> version >> storedKey >> dataHash;
+
+      if ((ds.status() == QDataStream::Ok) && (magic == ASSET_CACHE_MAGIC) &&
+          (version == ASSET_CACHE_VERSION) && (storedKey == key))
+      {
+        ds >> data;
+        status = (ds.status() == QDataStream::Ok) && (hash(data.constData(), data.size()) == dataHash);
+      }
+
+      if (status)
+      {
+        inFile.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+        inFile.close();
+      }
+      else
+      {
+        // the entry would only fail again next time, so it may as well not take up space
+        inFile.close();
+        inFile.remove();
+      }
+    }
+  }
+
+  if (!status)
+  {
+    data.clear();
+  }
+
+  return status;
+}
+
+/**
+ * Writes an asset to the cache under the provided key, replacing any existing entry.
+ * @return True if the entry was written; false otherwise (which only means that the
+ * asset will have to be decoded again next time.)
+ */
+bool AssetCache::store(quint64 key, const QByteArray& data) const
+{
+  bool status = false;
+
+  if (isEnabled())
+  {
+    QSaveFile outFile(getEntryFilename(key));
+
+    if (outFile.open(QIODevice::WriteOnly))
+    {
+      QDataStream ds(&outFile);
+      ds.setVersion(QDataStream::Qt_5_12);
+
+      ds << quint32(ASSET_CACHE_MAGIC) << quint32(ASSET_CACHE_VERSION) << key
+         << hash(data.constData(), data.size()) << data;
+
+      status = (ds.status() == QDataStream::Ok) && outFile.commit();
+    }
+  }
+
+  return status;
+}
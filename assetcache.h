@@ -0,0 +1,56 @@
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+//! Identifies a cached asset file ("NACH")
+#define ASSET_CACHE_MAGIC 0x4843414E
+
+//! Version of the cached asset file format, which also seeds the content keys; bump this
+//! whenever the format or the decoding of any cached asset changes
+#define ASSET_CACHE_VERSION 1
+
+//! Default limit on the total size of the entries kept in the cache directory
+#define ASSET_CACHE_DEFAULT_BUDGET_BYTES (64 * 1024 * 1024)
+
+//! Extension of the cached asset files, which are named for their keys
+#define ASSET_CACHE_ENTRY_SUFFIX ".bin"
+
+/**
+ * Persistent cache of decoded assets on disk, so that work done in one session (such as
+ * decompressing the larger DAT entries) doesn't have to be repeated in the next. Each asset
+ * is stored in its own file, named for a 64-bit key that the caller derives from the content
+ * that the asset was decoded from (see hash()). A changed input therefore simply produces a
+ * different key, and the stale entry is no longer looked up; it is eventually deleted when the
+ * directory is set again, since the total size of the entries is kept within a budget by
+ * deleting the least recently used ones. Entries that fail to load are deleted straight away.
+ *
+ * Thread safety: setDirectory() must only be called while no other thread is using the cache.
+ * Otherwise, load() and store() may be called from any number of threads at once; entries are
+ * written to a temporary file and then renamed into place, so a reader never sees a partial
+ * entry.
+ */
+class AssetCache
+{
+public:
+  AssetCache();
+
+  void setDirectory(const QString& dir, qint64 maxBytes = ASSET_CACHE_DEFAULT_BUDGET_BYTES);
+  QString getDirectory() const;
+  bool isEnabled() const;
+
+  bool load(quint64 key, QByteArray& data) const;
+  bool store(quint64 key, const QByteArray& data) const;
+
+  static quint64 hash(const char* data, int len, quint64 seed = 0);
+
+private:
+  QString m_dir;
+  qint64 m_maxBytes;
+
+  QString getEntryFilename(quint64 key) const;
+  void prune() const;
+};
+
+#endif // ASSETCACHE_H
@@ -0,0 +1,426 @@
+#include "batchexporter.h"
+#include "imageconverter.h"
+#include "shipmodeldata.h"
+#include "gifwriter.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QFuture>
+#include <QImage>
+#include <QList>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+BatchExporter::ExportContext::ExportContext(DatLibrary& datLib) :
+  lib(datLib),
+  pal(datLib),
+  fullscreen(datLib, pal),
+  stamps(datLib, pal),
+  aliens(datLib, pal),
+  audio(datLib)
+{
+}
+
+BatchExporter::BatchExporter(QString gameDir, QString outputDir) :
+  m_gameDir(gameDir),
+  m_outputDir(outputDir),
+  m_threadCount(QThread::idealThreadCount()),
+  m_filesWritten(0)
+{
+}
+
+/**
+ * Sets the number of worker threads used for the conversion. A value less than 1 selects
+ * the number of processor cores.
+ */
+void BatchExporter::setThreadCount(int threads)
+{
+  m_threadCount = (threads > 0) ? threads : QThread::idealThreadCount();
+}
+
+/**
+ * Returns the total number of output files written by the last export.
+ */
+int BatchExporter::getFilesWritten() const
+{
+  return m_filesWritten;
+}
+
+/**
+ * Returns the number of source files that could not be converted in the last export.
+ */
+int BatchExporter::getJobsFailed() const
+{
+  return m_failedFiles.size();
+}
+
+/**
+ * Returns the names of the source files that could not be converted in the last export.
+ */
+QStringList BatchExporter::getFailedFiles() const
+{
+  return m_failedFiles;
+}
+
+/**
+ * Builds the list of source files to convert, and then converts all of them across the
+ * configured number of worker threads. Each worker pulls the next unclaimed job from the
+ * shared list, so that a few large files can't leave the other workers idle.
+ * @return True if the data files could be opened and every file was converted; false otherwise.
+ */
+bool BatchExporter::exportAll()
+{
+  bool status = false;
+  QVector<ExportJob> jobs;
+  DatLibrary lib;
+
+  m_filesWritten = 0;
+  m_failedFiles.clear();
+
+  if (lib.openData(m_gameDir))
+  {
+    ExportContext ctx(lib);
+    queueJobs(ctx, jobs);
+
+    QAtomicInt nextJob(0);
+    QList<QFuture<void> > workers;
+    const int workerCount = qMax(1, qMin(m_threadCount, jobs.size()));
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(workerCount);
+
+    for (int workerIdx = 0; workerIdx < workerCount; workerIdx++)
+    {
+      workers.append(QtConcurrent::run(&pool, this, &BatchExporter::runWorker, &lib, &jobs, &nextJob));
+    }
+
+    foreach (QFuture<void> worker, workers)
+    {
+      worker.waitForFinished();
+    }
+
+    foreach (const ExportJob& job, jobs)
+    {
+      m_filesWritten += job.filesWritten;
+      if (!job.success)
+      {
+        m_failedFiles.append(job.filename);
+      }
+    }
+
+    status = m_failedFiles.isEmpty();
+  }
+
+  return status;
+}
+
+/**
+ * Enumerates every convertible file in the game data, and adds a job for each.
+ */
+void BatchExporter::queueJobs(ExportContext& ctx, QVector<ExportJob>& jobs) const
+{
+  ExportJob job;
+  job.filesWritten = 0;
+  job.success = false;
+
+  const QMap<DatFileType,QStringList> lbmList = ctx.fullscreen.getAllLbmList();
+  const QMap<DatFileType,QStringList> stampList = ctx.stamps.getAllStampsList();
+  const QMap<DatFileType,QStringList> nnvList = ctx.audio.getAllSoundList();
+
+  job.type = ExportAssetType_LBM;
+  foreach (DatFileType dat, lbmList.keys())
+  {
+    job.dat = dat;
+    foreach (QString filename, lbmList[dat])
+    {
+      job.filename = filename;
+      jobs.append(job);
+    }
+  }
+
+  job.type = ExportAssetType_Stamp;
+  foreach (DatFileType dat, stampList.keys())
+  {
+    job.dat = dat;
+    foreach (QString filename, stampList[dat])
+    {
+      job.filename = filename;
+      jobs.append(job);
+    }
+  }
+
+  job.type = ExportAssetType_NNV;
+  foreach (DatFileType dat, nnvList.keys())
+  {
+    job.dat = dat;
+    foreach (QString filename, nnvList[dat])
+    {
+      job.filename = filename;
+      jobs.append(job);
+    }
+  }
+
+  // planet surface textures have no fixed palette; instead, each is shown in game
+  // with one of several palettes that share the first seven characters of its name
+  // (e.g. WORLD05a.pln is used with WORLD05a.pal, WORLD05b.pal, etc.)
+  job.type = ExportAssetType_PLN;
+  job.dat = DatFileType_TEST;
+  const QStringList palList = ctx.lib.getFilenamesByExtension(DatFileType_TEST, ".pal");
+  foreach (QString filename, ctx.lib.getFilenamesByExtension(DatFileType_TEST, ".pln"))
+  {
+    job.filename = filename;
+    foreach (QString palFilename, palList)
+    {
+      if ((filename.length() > 7) && palFilename.startsWith(filename.left(7), Qt::CaseInsensitive))
+      {
+        job.palFilename = palFilename;
+        jobs.append(job);
+      }
+    }
+  }
+  job.palFilename.clear();
+
+  job.type = ExportAssetType_ANM;
+  job.dat = DatFileType_ANIM;
+  foreach (QString filename, ctx.lib.getFilenamesByExtension(DatFileType_ANIM, ".anm"))
+  {
+    job.filename = filename;
+    jobs.append(job);
+  }
+
+  job.type = ExportAssetType_BIN;
+  job.dat = DatFileType_TEST;
+  foreach (QString filename, ctx.lib.getFilenamesByExtension(DatFileType_TEST, ".bin"))
+  {
+    if (ShipModelData::isModelFile(filename))
+    {
+      job.filename = filename;
+      jobs.append(job);
+    }
+  }
+}
+
+/**
+ * Body of a single worker thread. Sets up a private set of decoding objects on the shared
+ * DatLibrary, and then repeatedly claims and runs the next job from the shared list until
+ * there are none left.
+ */
+void BatchExporter::runWorker(DatLibrary* lib, QVector<ExportJob>* jobs, QAtomicInt* nextJob) const
+{
+  ExportContext ctx(*lib);
+
+  int jobIdx = nextJob->fetchAndAddRelaxed(1);
+  while (jobIdx < jobs->size())
+  {
+    runJob(ctx, (*jobs)[jobIdx]);
+    jobIdx = nextJob->fetchAndAddRelaxed(1);
+  }
+}
+
+/**
+ * Converts the source file described by a single job.
+ */
+void BatchExporter::runJob(ExportContext& ctx, ExportJob& job) const
+{
+  const QString containerDir = m_outputDir + "/" + QFileInfo(DatLibrary::s_datFileNames[job.dat]).completeBaseName();
+
+  if (QDir().mkpath(containerDir))
+  {
+    switch (job.type)
+    {
+    case ExportAssetType_LBM:
+      job.success = exportLbm(ctx, job);
+      break;
+    case ExportAssetType_Stamp:
+      job.success = exportStamp(ctx, job);
+      break;
+    case ExportAssetType_PLN:
+      job.success = exportPln(ctx, job);
+      break;
+    case ExportAssetType_ANM:
+      job.success = exportAnm(ctx, job);
+      break;
+    case ExportAssetType_NNV:
+      job.success = exportNnv(ctx, job);
+      break;
+    case ExportAssetType_BIN:
+      job.success = exportBin(ctx, job);
+      break;
+    }
+  }
+}
+
+/**
+ * Builds the path of an output file, which is placed in a subdirectory named after the
+ * source file's DAT container. The provided suffix (which includes the extension) replaces
+ * the extension of the source filename.
+ */
+QString BatchExporter::outputPath(const ExportJob& job, QString suffix) const
+{
+  const QString containerName = QFileInfo(DatLibrary::s_datFileNames[job.dat]).completeBaseName();
+  return QString("%1/%2/%3%4").arg(m_outputDir).arg(containerName).arg(QFileInfo(job.filename).completeBaseName()).arg(suffix);
+}
+
+/**
+ * Converts a fullscreen .LBM image to PNG.
+ */
+bool BatchExporter::exportLbm(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = false;
+  QImage img;
+
+  if (ctx.fullscreen.getImage(job.dat, job.filename, img) && img.save(outputPath(job, ".png"), "PNG"))
+  {
+    job.filesWritten++;
+    status = true;
+  }
+
+  return status;
+}
+
+/**
+ * Converts a stamp (.STP) image to PNG, or a stamp roll (.ROL) to one PNG per stamp.
+ */
+bool BatchExporter::exportStamp(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = false;
+  QList<QImage> images;
+
+  if (ctx.stamps.getStamp(job.dat, job.filename, images))
+  {
+    const bool isRoll = job.filename.endsWith(ROLL_EXTENSION, Qt::CaseInsensitive);
+    status = true;
+
+    for (int imageIdx = 0; imageIdx < images.size(); imageIdx++)
+    {
+      const QString suffix = isRoll ? QString("_%1.png").arg(imageIdx, 2, 10, QChar('0')) : QString(".png");
+      if (images[imageIdx].save(outputPath(job, suffix), "PNG"))
+      {
+        job.filesWritten++;
+      }
+      else
+      {
+        status = false;
+      }
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Converts a planet surface texture (.PLN) to PNG, using the palette named in the job.
+ * The output filename includes the palette name, since each texture is exported once per palette.
+ */
+bool BatchExporter::exportPln(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = false;
+  QByteArray plnData;
+  QVector<QRgb> pal;
+  QImage img;
+
+  if (ctx.pal.paletteByName(job.dat, job.palFilename, pal) &&
+      ctx.lib.getFileByName(job.dat, job.filename, plnData) &&
+      ImageConverter::plnToPixmap(plnData, pal, img))
+  {
+    const QString suffix = QString("_%1.png").arg(QFileInfo(job.palFilename).completeBaseName());
+    if (img.save(outputPath(job, suffix), "PNG"))
+    {
+      job.filesWritten++;
+      status = true;
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Builds each frame of an alien animation (.ANM, composed of .DEL overlays) and writes
+ * each one as a PNG, and then writes the whole sequence as a single animated GIF.
+ */
+bool BatchExporter::exportAnm(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = false;
+  QMap<int,QImage> frames;
+
+  if (ctx.aliens.getAnimationFramesForAnm(job.filename, frames))
+  {
+    status = true;
+
+    foreach (int frameNum, frames.keys())
+    {
+      const QString suffix = QString("_%1.png").arg(frameNum, 2, 10, QChar('0'));
+      if (frames[frameNum].save(outputPath(job, suffix), "PNG"))
+      {
+        job.filesWritten++;
+      }
+      else
+      {
+        status = false;
+      }
+    }
+
+    if (!frames.isEmpty())
+    {
+      GifWriter gif;
+      if (gif.write(outputPath(job, ".gif"), frames.values().toVector()))
+      {
+        job.filesWritten++;
+      }
+      else
+      {
+        status = false;
+      }
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Decodes each of the sounds in an .NNV container and writes each one as a WAV file.
+ */
+bool BatchExporter::exportNnv(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = true;
+  const int soundCount = ctx.audio.getNumberOfSoundsInNNV(job.dat, job.filename);
+
+  for (int soundId = 0; soundId < soundCount; soundId++)
+  {
+    QByteArray pcmData;
+    const QString suffix = QString("_%1.wav").arg(soundId, 3, 10, QChar('0'));
+
+    if (ctx.audio.readSound(job.dat, job.filename, soundId, pcmData) &&
+        ctx.audio.writeWavFile(outputPath(job, suffix), pcmData))
+    {
+      job.filesWritten++;
+    }
+    else
+    {
+      status = false;
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Converts a 3D model (.BIN) to a Wavefront OBJ file.
+ */
+bool BatchExporter::exportBin(ExportContext& ctx, ExportJob& job) const
+{
+  bool status = false;
+  QByteArray binData;
+  ShipModelData model;
+  QString modelInfo;
+
+  if (ctx.lib.getFileByName(job.dat, job.filename, binData) &&
+      model.loadData(binData, modelInfo) &&
+      model.writeObjFile(outputPath(job, ".obj")))
+  {
+    job.filesWritten++;
+    status = true;
+  }
+
+  return status;
+}
@@ -0,0 +1,91 @@
+#ifndef BATCHEXPORTER_H
+#define BATCHEXPORTER_H
+
+#include <QString>
+#include <QVector>
+#include <QAtomicInt>
+#include "datlibrary.h"
+#include "palette.h"
+#include "fullscreenimages.h"
+#include "stampimages.h"
+#include "aliens.h"
+#include "audio.h"
+
+enum ExportAssetType
+{
+  ExportAssetType_LBM,
+  ExportAssetType_Stamp,
+  ExportAssetType_PLN,
+  ExportAssetType_ANM,
+  ExportAssetType_NNV,
+  ExportAssetType_BIN
+};
+
+/**
+ * Converts every image, animation, sound, and 3D model in the game data to a common
+ * format (PNG, GIF, WAV, or OBJ). Each source file is converted by a separate job, and the
+ * jobs are spread across a number of worker threads. No GUI classes are used, so this
+ * may be run without a display.
+ */
+class BatchExporter
+{
+public:
+  BatchExporter(QString gameDir, QString outputDir);
+
+  void setThreadCount(int threads);
+  bool exportAll();
+
+  int getFilesWritten() const;
+  int getJobsFailed() const;
+  QStringList getFailedFiles() const;
+
+private:
+  //! A single source file to be converted
+  struct ExportJob
+  {
+    ExportAssetType type;
+    DatFileType dat;
+    QString filename;
+    QString palFilename;
+    int filesWritten;
+    bool success;
+  };
+
+  /**
+   * The decoding objects used by a single worker thread. The DatLibrary may be read from
+   * any number of threads at once, so every worker shares the same one (and its cache of
+   * decompressed files), but the palette and table classes keep unguarded state of their
+   * own, so each worker has a private set of those.
+   */
+  struct ExportContext
+  {
+    ExportContext(DatLibrary& datLib);
+
+    DatLibrary& lib;
+    Palette pal;
+    FullscreenImages fullscreen;
+    StampImages stamps;
+    Aliens aliens;
+    Audio audio;
+  };
+
+  QString m_gameDir;
+  QString m_outputDir;
+  int m_threadCount;
+  int m_filesWritten;
+  QStringList m_failedFiles;
+
+  void queueJobs(ExportContext& ctx, QVector<ExportJob>& jobs) const;
+  void runWorker(DatLibrary* lib, QVector<ExportJob>* jobs, QAtomicInt* nextJob) const;
+  void runJob(ExportContext& ctx, ExportJob& job) const;
+  QString outputPath(const ExportJob& job, QString suffix) const;
+
+  bool exportLbm(ExportContext& ctx, ExportJob& job) const;
+  bool exportStamp(ExportContext& ctx, ExportJob& job) const;
+  bool exportPln(ExportContext& ctx, ExportJob& job) const;
+  bool exportAnm(ExportContext& ctx, ExportJob& job) const;
+  bool exportNnv(ExportContext& ctx, ExportJob& job) const;
+  bool exportBin(ExportContext& ctx, ExportJob& job) const;
+};
+
+#endif // BATCHEXPORTER_H
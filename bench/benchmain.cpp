@@ -0,0 +1,690 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QTemporaryDir>
+#include <QStringList>
+#include <QFile>
+#include <QPair>
+#include <string.h>
+#include <limits.h>
+#include <QtEndian>
+#include <stdio.h>
+#include "datlibrary.h"
+#include "imageconverter.h"
+#include "referencedecoders.h"
+#include "testdatbuilder.h"
+
+//! Number of times each pass over the inputs is timed (the fastest pass is reported)
+#define BENCH_DEFAULT_REPEATS 5
+
+//! Largest stored entry that the original LZ decoder can handle, since its input position is 16 bits
+#define BENCH_REFERENCE_LZ_MAX_INPUT 0xFFFF
+
+typedef bool (*ImageDecoder)(const QByteArray&, QVector<QRgb>, QImage&);
+
+//! A compressed entry in a DAT container, and the stored bytes that it is decompressed from
+struct LzEntry
+{
+  int index;
+  QByteArray stored;
+  int skipUncompressedBytes;
+  int expectedSize;
+};
+
+//! An image format, and the original and current decoders for it
+struct ImageBench
+{
+  const char* name;
+  const char* extension;
+  ImageDecoder reference;
+  ImageDecoder current;
+  //! True if the decoder draws onto an existing image (so both are given the same blank one to compare)
+  bool overlay;
+};
+
+static const ImageBench s_imageBenches[] =
+{
+  { "LBM", ".lbm", &ReferenceDecoders::lbmToImage,  &ImageConverter::lbmToImage,  false },
+  { "PLN", ".pln", &ReferenceDecoders::plnToPixmap, &ImageConverter::plnToPixmap, false },
+  { "STP", ".stp", &ReferenceDecoders::stpToImage,  &ImageConverter::stpToImage,  false },
+  { "DEL", ".del", &ReferenceDecoders::delToImage,  &ImageConverter::delToImage,  true }
+};
+
+/**
+ * Generates a sprite-like picture: a flat-shaded ellipse with a little noise, on a background
+ * of palette index 0 (which the STP and DEL encodings skip over).
+ */
+static QByteArray makePicture(QRandomGenerator& rng, int width, int height)
+{
+  QByteArray pixels(width * height, '\0');
+  const int baseColor = 16 + rng.bounded(200);
+
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      const double dx = (x - (width / 2.0)) / (width / 2.0);
+      const double dy = (y - (height / 2.0)) / (height / 2.0);
+
+      if (((dx * dx) + (dy * dy)) < 0.8)
+      {
+        const int noise = (rng.bounded(8) == 0) ? rng.bounded(4) : 0;
+        pixels[(y * width) + x] = static_cast<char>(baseColor + (x / 16) + noise);
+      }
+    }
+  }
+
+  return pixels;
+}
+
+static QByteArray makeHeader(int width, int height, int size)
+{
+  QByteArray header(size, '\0');
+  qToLittleEndian<quint16>(static_cast<quint16>(width), header.data());
+  if (size >= 4)
+  {
+    qToLittleEndian<quint16>(static_cast<quint16>(height), header.data() + 2);
+  }
+  return header;
+}
+
+/**
+ * RLE-encodes a picture as STP data: runs of index 0 are skipped, runs of three or more of
+ * the same index are filled, and everything else is copied.
+ */
+static QByteArray encodeStp(const QByteArray& pixels, int width, int height)
+{
+  QByteArray stp = makeHeader(width, height, 8);
+  int pos = 0;
+
+  while (pos < pixels.size())
+  {
+    int run = 1;
+    while (((pos + run) < pixels.size()) && (pixels[pos + run] == pixels[pos]) && (run < 0x3F))
+    {
+      run++;
+    }
+
+    if (pixels[pos] == 0)
+    {
+      stp.append(static_cast<char>(0x80 | run));
+      pos += run;
+    }
+    else if (run >= 3)
+    {
+      stp.append(static_cast<char>(0x40 | run));
+      stp.append(pixels[pos]);
+      pos += run;
+    }
+    else
+    {
+      int count = 0;
+      while (((pos + count) < pixels.size()) && (count < 0x3F) && (pixels[pos + count] != 0))
+      {
+        count++;
+      }
+      stp.append(static_cast<char>(count));
+      stp.append(pixels.mid(pos, count));
+      pos += count;
+    }
+  }
+
+  return stp;
+}
+
+/**
+ * Delta-encodes the pixels of a frame that differ from the base picture as DEL data, using
+ * each kind of command: skips, repeats, single bytes, and delta sequences.
+ */
+static QByteArray encodeDel(const QByteArray& base, const QByteArray& frame, int width, int height)
+{
+  QByteArray del = makeHeader(width, height, 4);
+  const uchar* const pixels = reinterpret_cast<const uchar*>(frame.constData());
+  int pos = 0;
+
+  while (pos < frame.size())
+  {
+    int run = 0;
+
+    if (frame[pos] == base[pos])
+    {
+      while (((pos + run) < frame.size()) && (frame[pos + run] == base[pos + run]) && (run < 0xFF))
+      {
+        run++;
+      }
+
+      if (run < 0x40)
+      {
+        del.append(static_cast<char>(0x02 | (run << 2)));
+      }
+      else
+      {
+        del.append(static_cast<char>(0x02));
+        del.append(static_cast<char>(run));
+      }
+      pos += run;
+      continue;
+    }
+
+    while (((pos + run) < frame.size()) && (frame[pos + run] == frame[pos]) && (run < 0x3F))
+    {
+      run++;
+    }
+
+    int deltaRun = 1;
+    while (((pos + deltaRun) < frame.size()) && (deltaRun <= DEL_MAX_DELTA_COUNT) &&
+           (frame[pos + deltaRun] != base[pos + deltaRun]))
+    {
+      const int delta = static_cast<int8_t>(pixels[pos + deltaRun] - pixels[pos + deltaRun - 1]);
+      if ((delta < -8) || (delta > 7))
+      {
+        break;
+      }
+      deltaRun++;
+    }
+
+    if (run >= 4)
+    {
+      del.append(static_cast<char>(0x01 | (run << 2)));
+      del.append(frame[pos]);
+      pos += run;
+    }
+    else if (deltaRun >= 3)
+    {
+      del.append(static_cast<char>(deltaRun << 2));
+      del.append(frame[pos]);
+      for (int deltaIdx = 1; deltaIdx < deltaRun; deltaIdx += 2)
+      {
+        const int high = (pixels[pos + deltaIdx] - pixels[pos + deltaIdx - 1]) & 0x0F;
+        const int low = ((deltaIdx + 1) < deltaRun) ? ((pixels[pos + deltaIdx + 1] - pixels[pos + deltaIdx]) & 0x0F) : 0;
+        del.append(static_cast<char>((high << 4) | low));
+      }
+      pos += deltaRun;
+    }
+    else
+    {
+      del.append(static_cast<char>(0x03));
+      del.append(frame[pos]);
+      pos++;
+    }
+  }
+
+  return del;
+}
+
+/**
+ * Writes a synthetic set of DAT containers with images in each of the benchmarked formats,
+ * for when no game data is provided.
+ */
+static bool writeSyntheticData(const QString& dir)
+{
+  QRandomGenerator rng(0x4E524542);
+  TestDatBuilder builder;
+
+  for (int lbmIdx = 0; lbmIdx < 8; lbmIdx++)
+  {
+    builder.addFile(DatFileType_ANIM, QString("SCREEN%1.LBM").arg(lbmIdx),
+                    makeHeader(320, 200, 4) + makePicture(rng, 320, 200), true);
+  }
+
+  for (int plnIdx = 0; plnIdx < 8; plnIdx++)
+  {
+    QByteArray texture(256 * 128, '\0');
+    for (int pixelIdx = 0; pixelIdx < texture.size(); pixelIdx++)
+    {
+      texture[pixelIdx] = static_cast<char>(rng.bounded(256));
+    }
+    builder.addFile(DatFileType_TEST, QString("PLANET%1.PLN").arg(plnIdx), makeHeader(256, 0, 2) + texture, true);
+  }
+
+  for (int stpIdx = 0; stpIdx < 100; stpIdx++)
+  {
+    const int width = 16 + rng.bounded(100);
+    const int height = 16 + rng.bounded(80);
+    builder.addFile(DatFileType_INVENT, QString("STAMP%1.STP").arg(stpIdx),
+                    encodeStp(makePicture(rng, width, height), width, height), true);
+  }
+
+  for (int animIdx = 0; animIdx < 10; animIdx++)
+  {
+    const int width = 120 + rng.bounded(60);
+    const int height = 100 + rng.bounded(40);
+    const QByteArray base = makePicture(rng, width, height);
+
+    for (int frameIdx = 0; frameIdx < 20; frameIdx++)
+    {
+      // each frame changes a band of the base picture (such as a mouth or eyes moving)
+      QByteArray frame = base;
+      const int top = rng.bounded(height / 2);
+      const int bottom = top + rng.bounded(height / 2);
+      for (int pixelIdx = top * width; pixelIdx < (bottom * width); pixelIdx++)
+      {
+        if (frame[pixelIdx] != 0)
+        {
+          frame[pixelIdx] = static_cast<char>(frame[pixelIdx] + rng.bounded(3));
+        }
+      }
+
+      builder.addFile(DatFileType_ANIM, QString("AL%1%2.DEL").arg(animIdx, 2, 10, QChar('0')).arg(frameIdx, 4, 10, QChar('0')),
+                      encodeDel(QByteArray(base.size(), '\0'), frame, width, height), true);
+    }
+  }
+
+  // conversation text, which is what most of CONVERSE.DAT holds
+  const QStringList words = QString("the a of to and you we are is ship trade planet alien "
+                                    "commander fuel cargo mission Korok Phelonian Bjorn "
+                                    "Altrusian gateway translator station, hello! why? yes.").split(' ');
+  for (int textIdx = 0; textIdx < 30; textIdx++)
+  {
+    QByteArray text;
+    const int size = 2000 + rng.bounded(30000);
+    while (text.size() < size)
+    {
+      text.append(words[rng.bounded(words.size())].toLatin1());
+      text.append((rng.bounded(12) == 0) ? '\0' : ' ');
+    }
+    builder.addFile(DatFileType_CONVERSE, QString("CONV%1.TXT").arg(textIdx), text, true, (textIdx % 2) == 0);
+  }
+
+  return builder.write(dir);
+}
+
+/**
+ * Reads every file with the provided extension from all of the containers.
+ */
+static QList<QByteArray> readFiles(const DatLibrary& lib, const QString& extension)
+{
+  QList<QByteArray> files;
+
+  foreach (DatFileType dat, DatLibrary::s_datFileNames.keys())
+  {
+    foreach (QString filename, lib.getFilenamesByExtension(dat, extension))
+    {
+      QByteArray data;
+      if (lib.getFileByName(dat, filename, data))
+      {
+        files.append(data);
+      }
+    }
+  }
+
+  return files;
+}
+
+/**
+ * Decodes each input with both decoders and counts the inputs whose results differ. Pixels are
+ * only compared when decoding succeeds, since neither decoder writes the rest of the image
+ * when the input runs out.
+ */
+static int countMismatches(const ImageBench& bench, const QList<QByteArray>& inputs, const QVector<QRgb>& palette)
+{
+  int mismatches = 0;
+
+  foreach (const QByteArray& input, inputs)
+  {
+    QImage refImage;
+    QImage image;
+
+    if (bench.overlay && (input.size() >= 4))
+    {
+      refImage = QImage(qFromLittleEndian<quint16>(input.constData()), qFromLittleEndian<quint16>(input.constData() + 2),
+                        QImage::Format_Indexed8);
+      refImage.setColorTable(palette);
+      refImage.fill(0);
+      image = refImage.copy();
+    }
+
+    const bool refStatus = bench.reference(input, palette, refImage);
+    const bool status = bench.current(input, palette, image);
+
+    if ((refStatus != status) || (status && (refImage != image)))
+    {
+      mismatches++;
+    }
+  }
+
+  return mismatches;
+}
+
+/**
+ * Times a pass over all of the inputs with the provided decoder, several times over.
+ * @return Duration of the fastest pass, in nanoseconds.
+ */
+static qint64 timeDecoder(ImageDecoder decoder, const QList<QByteArray>& inputs, const QVector<QRgb>& palette, int repeats)
+{
+  qint64 fastest = -1;
+
+  for (int pass = 0; pass < repeats; pass++)
+  {
+    QElapsedTimer timer;
+    timer.start();
+
+    foreach (const QByteArray& input, inputs)
+    {
+      QImage image;
+      decoder(input, palette, image);
+    }
+
+    const qint64 elapsed = timer.nsecsElapsed();
+    fastest = (fastest < 0) ? elapsed : qMin(fastest, elapsed);
+  }
+
+  return fastest;
+}
+
+static void printResult(const char* name, int count, qint64 refNs, qint64 curNs, int mismatches)
+{
+  printf("%-13s %7d %15.3f %15.3f %9.2fx %11d\n", name, count, refNs / 1.0e6, curNs / 1.0e6,
+         (curNs > 0) ? (static_cast<double>(refNs) / curNs) : 0.0, mismatches);
+}
+
+/**
+ * Compares the original pixel-by-pixel image decoders with the current ones, over every image
+ * of each format in the game data. The reported times are for the fastest of several passes.
+ */
+static void benchImages(const DatLibrary& lib, int repeats)
+{
+  QVector<QRgb> palette;
+  for (int palIdx = 0; palIdx < 256; palIdx++)
+  {
+    palette.append(qRgb(palIdx, palIdx, palIdx));
+  }
+
+  printf("%-13s %7s %15s %15s %10s %11s\n", "Format", "Files", "Reference (ms)", "Current (ms)", "Speedup", "Mismatches");
+
+  for (unsigned int benchIdx = 0; benchIdx < (sizeof(s_imageBenches) / sizeof(s_imageBenches[0])); benchIdx++)
+  {
+    const ImageBench& bench = s_imageBenches[benchIdx];
+    const QList<QByteArray> inputs = readFiles(lib, bench.extension);
+    const int mismatches = countMismatches(bench, inputs, palette);
+    const qint64 refNs = timeDecoder(bench.reference, inputs, palette, repeats);
+    const qint64 curNs = timeDecoder(bench.current, inputs, palette, repeats);
+
+    printResult(bench.name, inputs.size(), refNs, curNs, mismatches);
+  }
+}
+
+/**
+ * Reads the index of the specified container directly from its file, and collects the stored
+ * bytes of every compressed entry (as the original decoder was given them.) Entries whose stored
+ * bytes are larger than the provided size are counted but left out.
+ */
+static QVector<LzEntry> readLzEntries(const DatLibrary& lib, const QString& gameDir, DatFileType dat,
+                                      int maxStoredSize, int& skipped)
+{
+  QVector<LzEntry> entries;
+  QFile datFile(gameDir + "/" + DatLibrary::s_datFileNames[dat]);
+  skipped = 0;
+
+  if (datFile.open(QIODevice::ReadOnly))
+  {
+    const QByteArray contents = datFile.readAll();
+    datFile.close();
+
+    for (int index = 0; index < lib.getFileCount(dat); index++)
+    {
+      DatFileIndex indexEntry;
+      memcpy(&indexEntry, contents.constData() + 2 + (index * sizeof(DatFileIndex)), sizeof(DatFileIndex));
+
+      if (indexEntry.flags_b & 0x01)
+      {
+        LzEntry entry;
+        entry.index = index;
+        entry.skipUncompressedBytes = (~indexEntry.flags_a & 0x04) ? 4 : 0;
+        entry.stored = contents.mid(static_cast<int>(indexEntry.offset), indexEntry.compressed_size + entry.skipUncompressedBytes);
+        entry.expectedSize = indexEntry.uncompressed_size + entry.skipUncompressedBytes;
+
+        if (entry.stored.size() <= maxStoredSize)
+        {
+          entries.append(entry);
+        }
+        else
+        {
+          skipped++;
+        }
+      }
+    }
+  }
+
+  return entries;
+}
+
+/**
+ * Compares the original LZ decoder (which appended each byte to a QByteArray) with the current
+ * one, over every compressed entry in CONVERSE.DAT and ANIM.DAT. The current decoder is timed
+ * through DatLibrary::decodeFileAtIndex(), which bypasses the caches. The original decoder writes
+ * all of the final codeword even if that runs past the size in the index, so only the bytes up to
+ * that size are compared.
+ */
+static void benchLz(const DatLibrary& lib, const QString& gameDir, int repeats)
+{
+  const DatFileType lzDats[] = { DatFileType_CONVERSE, DatFileType_ANIM };
+
+  printf("\n%-13s %7s %15s %15s %10s %11s\n", "LZ container", "Entries", "Reference (ms)", "Current (ms)", "Speedup", "Mismatches");
+
+  for (unsigned int datIdx = 0; datIdx < (sizeof(lzDats) / sizeof(lzDats[0])); datIdx++)
+  {
+    const DatFileType dat = lzDats[datIdx];
+    int skipped = 0;
+    const QVector<LzEntry> entries = readLzEntries(lib, gameDir, dat, BENCH_REFERENCE_LZ_MAX_INPUT, skipped);
+    int mismatches = 0;
+    qint64 refNs = -1;
+    qint64 curNs = -1;
+
+    foreach (const LzEntry& entry, entries)
+    {
+      QByteArray refData;
+      QByteArray data;
+      const bool refStatus = ReferenceDecoders::lzDecompress(entry.stored, refData, entry.skipUncompressedBytes);
+      const bool status = lib.decodeFileAtIndex(dat, entry.index, data);
+
+      if ((refStatus != status) || (refData.left(entry.expectedSize) != data))
+      {
+        mismatches++;
+      }
+    }
+
+    for (int pass = 0; pass < repeats; pass++)
+    {
+      QElapsedTimer timer;
+      timer.start();
+      foreach (const LzEntry& entry, entries)
+      {
+        QByteArray data;
+        ReferenceDecoders::lzDecompress(entry.stored, data, entry.skipUncompressedBytes);
+      }
+      const qint64 elapsed = timer.nsecsElapsed();
+      refNs = (refNs < 0) ? elapsed : qMin(refNs, elapsed);
+    }
+
+    for (int pass = 0; pass < repeats; pass++)
+    {
+      QElapsedTimer timer;
+      timer.start();
+      foreach (const LzEntry& entry, entries)
+      {
+        QByteArray data;
+        lib.decodeFileAtIndex(dat, entry.index, data);
+      }
+      const qint64 elapsed = timer.nsecsElapsed();
+      curNs = (curNs < 0) ? elapsed : qMin(curNs, elapsed);
+    }
+
+    printResult(qPrintable(DatLibrary::s_datFileNames[dat]), entries.size(), refNs, curNs, mismatches);
+    if (skipped > 0)
+    {
+      printf("  (%d entries larger than 64 KB were left out)\n", skipped);
+    }
+  }
+}
+
+/**
+ * Times three ways of getting a set of compressed entries: decoding them directly, and reading
+ * them through a library with the disk cache enabled (and the memory cache disabled), first with
+ * an empty cache directory (when each entry is decoded and then stored) and then once the entries
+ * are in it. Only entries of DAT_DISK_CACHE_MIN_BYTES and larger are kept on disk, so the smaller
+ * ones show the overhead of the library's read path alone. The cached entries are read back
+ * through the OS file cache, so the warm times don't include reading from the disk itself.
+ */
+static void timeDiskCache(const char* name, const DatLibrary& lib, const DatLibrary& cachedLib,
+                          const QList<QPair<DatFileType,LzEntry> >& entries, int repeats)
+{
+  qint64 decodeNs = -1;
+  qint64 warmNs = -1;
+  int mismatches = 0;
+
+  for (int pass = 0; pass < repeats; pass++)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    for (int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+    {
+      QByteArray data;
+      lib.decodeFileAtIndex(entries[entryIdx].first, entries[entryIdx].second.index, data);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    decodeNs = (decodeNs < 0) ? elapsed : qMin(decodeNs, elapsed);
+  }
+
+  QStringList filenames;
+  for (int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+  {
+    filenames.append(lib.getFilenameAtIndex(entries[entryIdx].first, entries[entryIdx].second.index));
+  }
+
+  QElapsedTimer coldTimer;
+  coldTimer.start();
+  for (int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+  {
+    QByteArray data;
+    cachedLib.getFileByName(entries[entryIdx].first, filenames[entryIdx], data);
+  }
+  const qint64 coldNs = coldTimer.nsecsElapsed();
+
+  for (int pass = 0; pass < repeats; pass++)
+  {
+    QElapsedTimer timer;
+    timer.start();
+    for (int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+    {
+      QByteArray data;
+      cachedLib.getFileByName(entries[entryIdx].first, filenames[entryIdx], data);
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+    warmNs = (warmNs < 0) ? elapsed : qMin(warmNs, elapsed);
+  }
+
+  for (int entryIdx = 0; entryIdx < entries.size(); entryIdx++)
+  {
+    QByteArray expected;
+    QByteArray data;
+    const bool expectedStatus = lib.getFileByName(entries[entryIdx].first, filenames[entryIdx], expected);
+    const bool status = cachedLib.getFileByName(entries[entryIdx].first, filenames[entryIdx], data);
+
+    if ((expectedStatus != status) || (expected != data))
+    {
+      mismatches++;
+    }
+  }
+
+  printf("%-13s %7d %15.3f %15.3f %15.3f %9.2fx %11d\n", name, entries.size(), decodeNs / 1.0e6,
+         coldNs / 1.0e6, warmNs / 1.0e6, (warmNs > 0) ? (static_cast<double>(decodeNs) / warmNs) : 0.0, mismatches);
+}
+
+/**
+ * Compares decoding the compressed entries in every container with reading them back from the
+ * disk cache, for the entries below the disk cache's minimum size and for those at or above it.
+ */
+static void benchDiskCache(const DatLibrary& lib, const QString& gameDir, int repeats)
+{
+  QList<QPair<DatFileType,LzEntry> > smallEntries;
+  QList<QPair<DatFileType,LzEntry> > largeEntries;
+
+  foreach (DatFileType dat, DatLibrary::s_datFileNames.keys())
+  {
+    int skipped = 0;
+    foreach (const LzEntry& entry, readLzEntries(lib, gameDir, dat, INT_MAX, skipped))
+    {
+      if ((entry.expectedSize - entry.skipUncompressedBytes) >= DAT_DISK_CACHE_MIN_BYTES)
+      {
+        largeEntries.append(qMakePair(dat, entry));
+      }
+      else
+      {
+        smallEntries.append(qMakePair(dat, entry));
+      }
+    }
+  }
+
+  QTemporaryDir cacheDir;
+  DatLibrary cachedLib;
+
+  if (cacheDir.isValid() && cachedLib.openData(gameDir))
+  {
+    // with no memory cache, every read goes through the disk cache (or the decoder)
+    cachedLib.setCacheBudget(0);
+    cachedLib.setDiskCacheDirectory(cacheDir.path());
+
+    printf("\n%-13s %7s %15s %15s %15s %10s %11s\n", "Disk cache", "Entries", "Decode (ms)", "Cold (ms)",
+           "Warm (ms)", "Speedup", "Mismatches");
+    timeDiskCache("Below 16 KB", lib, cachedLib, smallEntries, repeats);
+    timeDiskCache("16 KB and up", lib, cachedLib, largeEntries, repeats);
+  }
+  else
+  {
+    fprintf(stderr, "Error: could not set up a disk cache directory.\n");
+  }
+}
+
+/**
+ * Entry point for the benchmark, which compares the speed of the current decoders with that of
+ * the original ones (see ReferenceDecoders), and of decoding with reading from the disk cache,
+ * on the game data, or on synthetic data if no game directory is provided.
+ */
+int main(int argc, char *argv[])
+{
+  QCoreApplication a(argc, argv);
+  a.setApplicationName("nre-bench");
+
+  QCommandLineParser parser;
+  QCommandLineOption repeatsOption(QStringList() << "n" << "repeats", "Number of timed passes over each set of inputs.",
+                                   "count", QString::number(BENCH_DEFAULT_REPEATS));
+  parser.setApplicationDescription("Compares the speed of the current image and LZ decoders with the original ones, and of the disk cache");
+  parser.addHelpOption();
+  parser.addOption(repeatsOption);
+  parser.addPositionalArgument("gamedir", "Directory containing game data files (synthetic data is used if omitted)", "[gamedir]");
+  parser.process(a);
+
+  const QStringList args = parser.positionalArguments();
+  const int repeats = qMax(parser.value(repeatsOption).toInt(), 1);
+  QTemporaryDir syntheticDir;
+  QString gameDir;
+  int status = 0;
+
+  if (!args.isEmpty())
+  {
+    gameDir = args[0];
+  }
+  else if (syntheticDir.isValid() && writeSyntheticData(syntheticDir.path()))
+  {
+    gameDir = syntheticDir.path();
+    printf("No game directory provided; using synthetic data.\n");
+  }
+
+  DatLibrary lib;
+  if (!gameDir.isEmpty() && lib.openData(gameDir))
+  {
+    benchImages(lib, repeats);
+    benchLz(lib, gameDir, repeats);
+    benchDiskCache(lib, gameDir, repeats);
+  }
+  else
+  {
+    fprintf(stderr, "Error: could not open the game data files in '%s'.\n", qPrintable(gameDir));
+    status = 1;
+  }
+
+  return status;
+}
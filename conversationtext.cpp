@@ -12,6 +12,14 @@ ConversationText::ConversationText(DatLibrary& lib, Aliens& aliens, GameText& gt
 
 }
 
+/**
+ * Discards the topic indices, which must be done whenever the game data is closed.
+ */
+void ConversationText::clear()
+{
+  m_topicIndices.clear();
+}
+
 /**
  * Gets a list of dialog lines, each one being a response from the specified alien about the
  * thing with the provided ID in the specified conversation topic category.
@@ -19,13 +27,10 @@ ConversationText::ConversationText(DatLibrary& lib, Aliens& aliens, GameText& gt
 QString ConversationText::getConversationText(int alienId, ConvTopicCategory topic, int thingId, QVector<QPair<GTxtCmd, int> >& commands)
 {
   QString dialogLine;
-  QByteArray tlktData;
   ConvTableType tableType = ConvTableType_Individual;
   int alienOrRaceId = alienId;
 
-  getTLKTData(tableType, alienOrRaceId, tlktData);
-
-  int tlknIndex = getTLKNIndex(topic, thingId, tlktData);
+  int tlknIndex = getTLKNIndex(tableType, alienOrRaceId, topic, thingId);
 
   // if the individual-specific tables didn't have any entries for this topic,
   // fall back to the generic tables used by all members of an alien race
@@ -33,8 +38,7 @@ QString ConversationText::getConversationText(int alienId, ConvTopicCategory top
   {
     tableType = ConvTableType_Race;
     alienOrRaceId = m_aliens->getRace(alienId);
-    getTLKTData(tableType, alienOrRaceId, tlktData);
-    tlknIndex = getTLKNIndex(topic, thingId, tlktData);
+    tlknIndex = getTLKNIndex(tableType, alienOrRaceId, topic, thingId);
   }
 
   if (tlknIndex >= 0)
@@ -62,24 +66,16 @@ QString ConversationText::getConversationText(int alienId, ConvTopicCategory top
 bool ConversationText::getTLKXData(ConvTableType tableType, int id, QByteArray& indexData, QByteArray& strData)
 {
   bool status = false;
-  QString idxFilename;
-  QString strFilename;
 
   if (tableType == ConvTableType_Individual)
   {
-    idxFilename = getTLKXCIndexFilename(id);
-    strFilename = getTLKXCStringsFilename(id);
+    status = (m_lib->getFileByKey(DatFileType_CONVERSE, getTLKXCIndexFilename(id), indexData) &&
+              m_lib->getFileByKey(DatFileType_CONVERSE, getTLKXCStringsFilename(id), strData));
   }
   else if (tableType == ConvTableType_Race)
   {
-    idxFilename = getTLKXRIndexFilename(id);
-    strFilename = getTLKXRStringsFilename(id);
-  }
-
-  if (!idxFilename.isEmpty() && !strFilename.isEmpty())
-  {
-    status = (m_lib->getFileByName(DatFileType_CONVERSE, idxFilename, indexData) &&
-              m_lib->getFileByName(DatFileType_CONVERSE, strFilename, strData));
+    status = (m_lib->getFileByKey(DatFileType_CONVERSE, getTLKXRIndexFilename(id), indexData) &&
+              m_lib->getFileByKey(DatFileType_CONVERSE, getTLKXRStringsFilename(id), strData));
   }
 
   return status;
@@ -116,11 +112,11 @@ bool ConversationText::getTLKNData(ConvTableType tableType, int id, QByteArray&
 
   if (tableType == ConvTableType_Individual)
   {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, getTLKNCFilename(id), data);
+    status = m_lib->getFileByKey(DatFileType_CONVERSE, getTLKNCFilename(id), data);
   }
   else if (tableType == ConvTableType_Race)
   {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, getTLKNRFilename(id), data);
+    status = m_lib->getFileByKey(DatFileType_CONVERSE, getTLKNRFilename(id), data);
   }
 
   return status;
@@ -136,54 +132,65 @@ bool ConversationText::getTLKTData(ConvTableType tableType, int id, QByteArray&
 
   if (tableType == ConvTableType_Individual)
   {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, getTLKTCFilename(id), data);
+    status = m_lib->getFileByKey(DatFileType_CONVERSE, getTLKTCFilename(id), data);
   }
   else if (tableType == ConvTableType_Race)
   {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, getTLKTRFilename(id), data);
+    status = m_lib->getFileByKey(DatFileType_CONVERSE, getTLKTRFilename(id), data);
   }
 
   return status;
 }
 
-const QString ConversationText::getTLKNCFilename(int id)
+/**
+ * Builds a DAT lookup key for one of the numbered conversation table files without
+ * allocating, since these keys are generated for every topic lookup.
+ */
+DatFileKey ConversationText::makeKey(const char* format, int id)
+{
+  char filename[INDEX_FILENAME_LEN];
+  qsnprintf(filename, sizeof(filename), format, id);
+  return DatFileKey(filename);
+}
+
+const DatFileKey ConversationText::getTLKNCFilename(int id)
 {
-  return QString("TLKNC%1.TAB").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKNC%03d.TAB", id);
 }
 
-const QString ConversationText::getTLKNRFilename(int id)
+const DatFileKey ConversationText::getTLKNRFilename(int id)
 {
-  return QString("TLKNR%1.TAB").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKNR%03d.TAB", id);
 }
 
-const QString ConversationText::getTLKTCFilename(int id)
+const DatFileKey ConversationText::getTLKTCFilename(int id)
 {
-  return QString("TLKTC%1.TAB").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKTC%03d.TAB", id);
 }
 
-const QString ConversationText::getTLKTRFilename(int id)
+const DatFileKey ConversationText::getTLKTRFilename(int id)
 {
-  return QString("TLKTR%1.TAB").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKTR%03d.TAB", id);
 }
 
-const QString ConversationText::getTLKXCIndexFilename(int id)
+const DatFileKey ConversationText::getTLKXCIndexFilename(int id)
 {
-  return QString("TLKXC%1.IDX").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKXC%03d.IDX", id);
 }
 
-const QString ConversationText::getTLKXCStringsFilename(int id)
+const DatFileKey ConversationText::getTLKXCStringsFilename(int id)
 {
-  return QString("TLKXC%1.TXT").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKXC%03d.TXT", id);
 }
 
-const QString ConversationText::getTLKXRIndexFilename(int id)
+const DatFileKey ConversationText::getTLKXRIndexFilename(int id)
 {
-  return QString("TLKXR%1.IDX").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKXR%03d.IDX", id);
 }
 
-const QString ConversationText::getTLKXRStringsFilename(int id)
+const DatFileKey ConversationText::getTLKXRStringsFilename(int id)
 {
-  return QString("TLKXR%1.TXT").arg(id, 3, 10, QChar('0'));
+  return makeKey("TLKXR%03d.TXT", id);
 }
 
 /**
@@ -200,118 +207,215 @@ int ConversationText::getTLKXIndex(int tlknIndex, const QByteArray& tlknData)
 }
 
 /**
- * Gets the list of indices from the provided TLKT data that match the specified thing ID in the specified
- * conversation topic category. If none match, an empty list is returned.
+ * Gets the index (into the TLKN file) of the line of dialogue that the specified alien or race
+ * speaks about the thing with the provided ID in the specified conversation topic category.
+ * @return The TLKN index, or -1 if the TLKT file has no entry for that topic.
  */
-int ConversationText::getTLKNIndex(ConvTopicCategory topic, int requestedId, const QByteArray& tlktData)
+int ConversationText::getTLKNIndex(ConvTableType tableType, int id, ConvTopicCategory topic, int thingId)
 {
-  int index = -1;
-  int highestPriority = 0;
+  const TopicIndex& topicIndex = getTopicIndex(tableType, id);
+  TopicIndex::const_iterator entry = topicIndex.constFind(topicKey(topic, thingId));
+
+  return (entry != topicIndex.constEnd()) ? entry.value().tlknIndex : -1;
+}
 
-  const uint8_t* data = reinterpret_cast<const uint8_t*>(tlktData.data());
+/**
+ * Gets the topic index for the TLKT file of the specified alien or race, reading the file
+ * and building the index if this hasn't been done yet. (A missing TLKT file produces an
+ * empty index, which is kept so that the file isn't looked up again.)
+ */
+const ConversationText::TopicIndex& ConversationText::getTopicIndex(ConvTableType tableType, int id)
+{
+  const quint32 tableKey = (static_cast<quint32>(tableType) << 16) | (id & 0xFFFF);
+  QHash<quint32,TopicIndex>::iterator topicIndex = m_topicIndices.find(tableKey);
+
+  if (topicIndex == m_topicIndices.end())
+  {
+    QByteArray tlktData;
+    topicIndex = m_topicIndices.insert(tableKey, TopicIndex());
+
+    if (getTLKTData(tableType, id, tlktData))
+    {
+      buildTopicIndex(tlktData, topicIndex.value());
+    }
+  }
+
+  return topicIndex.value();
+}
+
+/**
+ * Indexes each of the records in the provided TLKT data under every topic that it covers.
+ */
+void ConversationText::buildTopicIndex(const QByteArray& tlktData, TopicIndex& topicIndex)
+{
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(tlktData.constData());
+  QVector<QPair<ConvTopicCategory,int> > topics;
   int offset = 0;
 
-  while (offset < tlktData.size())
+  while ((offset + TLKT_RECORDSIZE) <= tlktData.size())
   {
-    const int firstByte = data[offset];
     const int priority  = data[offset + 1];
-    const int alienId   = data[offset + 3];
-    const int placeId   = data[offset + 4] + (0x100 * data[offset + 5]);
-    const int objectId  = data[offset + 6];
-    const int miscId    = data[offset + 7];
     const int tlknIndex = data[offset + 8] + (0x100 * data[offset + 9]);
 
-    if (priority >= highestPriority)
+    getTopicsForRecord(data + offset, topics);
+    for (int topicIdx = 0; topicIdx < topics.size(); topicIdx++)
     {
-      if ((topic == ConvTopicCategory_GreetingInitial) && (firstByte == TLKN_CMD_GREETFIRST))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_GreetingSubsequent) && (firstByte == TLKN_CMD_GREETNEXT))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_DisplayObject) && (firstByte == TLKN_CMD_DISPOBJECT) && (objectId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_GiveObject) && (firstByte == TLKN_CMD_GIVEOBJECT) && (objectId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_SeesObject) && (firstByte == TLKN_CMD_SEESOBJ) && (objectId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_AskAboutRace) && (firstByte == TLKN_CMD_ASKABOUTRACE) && (miscId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_AskAboutPerson) && (firstByte == TLKN_CMD_ASKABOUT) && (alienId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_AskAboutObject) && (firstByte == TLKN_CMD_ASKABOUT) && (objectId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_AskAboutLocation) && (firstByte == TLKN_CMD_ASKABOUT) && (placeId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-      else if ((topic == ConvTopicCategory_GiveFact) && (firstByte == TLKN_CMD_ASKABOUT) && (miscId == requestedId))
-      {
-        index = tlknIndex;
-      highestPriority = priority;
-      }
-
+      addTopic(topicIndex, topics[topicIdx].first, topics[topicIdx].second, priority, tlknIndex);
     }
 
     offset += TLKT_RECORDSIZE;
   }
-
-  return index;
 }
 
 /**
- * Returns true if there are lines of dialogue associated specifically with the given alien ID,
- * about the provided topic ID in the provided category. Return false if the game will select
- * a generic fallback dialogue line for the provided combination.
+ * Gets the topics (each a category and the ID of the thing being talked about) that are covered
+ * by a single TLKT record. A record that describes the response to being asked about something
+ * covers a person, a location, an object, and a fact all at once (each with its own ID field.)
+ * The greeting categories don't refer to any particular thing, so their thing ID is always 0.
  */
-bool ConversationText::doesInterestingDialogExist(int alienId, ConvTopicCategory category, int thingId)
+void ConversationText::getTopicsForRecord(const uint8_t* record, QVector<QPair<ConvTopicCategory,int> >& topics)
 {
-  bool status = false;
+  const int firstByte = record[0];
+  const int alienId   = record[3];
+  const int placeId   = record[4] + (0x100 * record[5]);
+  const int objectId  = record[6];
+  const int miscId    = record[7];
+
+  topics.clear();
+
+  switch (firstByte)
+  {
+  case TLKN_CMD_GREETFIRST:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_GreetingInitial, 0));
+    break;
+  case TLKN_CMD_GREETNEXT:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_GreetingSubsequent, 0));
+    break;
+  case TLKN_CMD_DISPOBJECT:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_DisplayObject, objectId));
+    break;
+  case TLKN_CMD_GIVEOBJECT:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_GiveObject, objectId));
+    break;
+  case TLKN_CMD_SEESOBJ:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_SeesObject, objectId));
+    break;
+  case TLKN_CMD_ASKABOUTRACE:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_AskAboutRace, miscId));
+    break;
+  case TLKN_CMD_ASKABOUT:
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_AskAboutPerson, alienId));
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_AskAboutObject, objectId));
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_AskAboutLocation, placeId));
+    topics.append(QPair<ConvTopicCategory,int>(ConvTopicCategory_GiveFact, miscId));
+    break;
+  default:
+    break;
+  }
+}
 
+/**
+ * Reads every record in the TLKT file of the specified alien or race, along with the line of
+ * dialogue that each record selects. Unlike the other lookups, this doesn't use or build the
+ * topic indices, so it may be called from any thread while the game data is open.
+ * @return True if all of the conversation files for the alien or race could be read; false
+ * otherwise.
+ */
+bool ConversationText::getAllTopicLines(ConvTableType tableType, int id, QVector<ConvTopicLine>& lines)
+{
   QByteArray tlktData;
-  ConvTableType tableType = ConvTableType_Individual;
-  int alienOrRaceId = alienId;
+  QByteArray tlknData;
+  QByteArray tlkxIndexData;
+  QByteArray tlkxStrData;
 
-  getTLKTData(tableType, alienOrRaceId, tlktData);
+  lines.clear();
 
-  int tlknIndex = getTLKNIndex(category, thingId, tlktData);
+  const bool status = getTLKTData(tableType, id, tlktData) &&
+                      getTLKNData(tableType, id, tlknData) &&
+                      getTLKXData(tableType, id, tlkxIndexData, tlkxStrData);
 
-  if (tlknIndex >= 0)
+  if (status)
   {
-    status = true;
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(tlktData.constData());
+    int offset = 0;
+
+    while ((offset + TLKT_RECORDSIZE) <= tlktData.size())
+    {
+      ConvTopicLine line;
+      line.priority = data[offset + 1];
+      line.tlknIndex = data[offset + 8] + (0x100 * data[offset + 9]);
+      line.tlkxIndex = -1;
+      getTopicsForRecord(data + offset, line.topics);
+
+      // records that point outside of the other tables are kept, but without any text
+      if (((line.tlknIndex + 1) * TLKN_RECORDSIZE) <= tlknData.size())
+      {
+        line.tlkxIndex = getTLKXIndex(line.tlknIndex, tlknData);
+        const int tlkxIndexOffset = (line.tlkxIndex * TLKX_RECORDSIZE) + TLKX_RECORDSIZE;
+
+        if ((tlkxIndexOffset + TLKX_RECORDSIZE) <= tlkxIndexData.size())
+        {
+          const uint32_t tlkxStrOffset =
+            qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(tlkxIndexData.constData()) + tlkxIndexOffset);
+
+          if (tlkxStrOffset < static_cast<uint32_t>(tlkxStrData.size()))
+          {
+            // the string is only tokenized once, for both its rich text and plain text forms
+            GTxtTokenList tokens;
+            const int maxlen = qMin(0x1000, tlkxStrData.size() - static_cast<int>(tlkxStrOffset));
+            GameText::tokenize(tlkxStrData, static_cast<int>(tlkxStrOffset), tokens, maxlen);
+            GameText::getCommands(tokens, line.commands);
+            line.text = m_gtext->renderHtml(tokens, true);
+            line.plainText = m_gtext->renderPlainText(tokens);
+          }
+        }
+      }
+
+      lines.append(line);
+      offset += TLKT_RECORDSIZE;
+    }
   }
-  else
+
+  return status;
+}
+
+/**
+ * Records a TLKT entry in the topic index, unless the topic already has an entry with a higher
+ * priority. Among entries with the same priority, the last one in the file is the one used.
+ */
+void ConversationText::addTopic(TopicIndex& topicIndex, ConvTopicCategory topic, int thingId, int priority, int tlknIndex)
+{
+  TopicEntry& entry = topicIndex[topicKey(topic, thingId)];
+
+  // a newly inserted entry is value-initialized, with a priority of 0
+  if (priority >= entry.priority)
   {
-    tableType = ConvTableType_Race;
-    alienOrRaceId = m_aliens->getRace(alienId);
-    getTLKTData(tableType, alienOrRaceId, tlktData);
-    tlknIndex = getTLKNIndex(category, thingId, tlktData);
+    entry.tlknIndex = tlknIndex;
+    entry.priority = priority;
+  }
+}
 
-    status = (tlknIndex >= 0);
+/**
+ * Builds the key under which a topic is stored in a topic index. The greeting categories
+ * don't refer to any particular thing, so their thing ID is ignored.
+ */
+quint32 ConversationText::topicKey(ConvTopicCategory topic, int thingId)
+{
+  if ((topic == ConvTopicCategory_GreetingInitial) || (topic == ConvTopicCategory_GreetingSubsequent))
+  {
+    thingId = -1;
   }
 
-  return status;
+  return (static_cast<quint32>(topic) << 16) | (static_cast<quint32>(thingId) & 0xFFFF);
+}
+
+/**
+ * Returns true if there are lines of dialogue associated specifically with the given alien ID,
+ * about the provided topic ID in the provided category. Return false if the game will select
+ * a generic fallback dialogue line for the provided combination.
+ */
+bool ConversationText::doesInterestingDialogExist(int alienId, ConvTopicCategory category, int thingId)
+{
+  return (getTLKNIndex(ConvTableType_Individual, alienId, category, thingId) >= 0) ||
+         (getTLKNIndex(ConvTableType_Race, m_aliens->getRace(alienId), category, thingId) >= 0);
 }
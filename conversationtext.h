@@ -4,6 +4,10 @@
 #include <QStringList>
 #include <QByteArray>
 #include <QList>
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QVector>
 #include "datlibrary.h"
 #include "gametext.h"
 #include "aliens.h"
@@ -35,6 +39,21 @@ enum ConvTopicCategory
   ConvTopicCategory_SeesObject,
 };
 
+//! Names of the conversation topic categories, as shown in the UI
+static const QMap<ConvTopicCategory,QString> g_convTopicCategoryName =
+{
+  { ConvTopicCategory_GreetingInitial,    "Greeting (initial)" },
+  { ConvTopicCategory_GreetingSubsequent, "Greeting (subsequent)" },
+  { ConvTopicCategory_AskAboutPerson,     "Ask about person" },
+  { ConvTopicCategory_AskAboutLocation,   "Ask about location" },
+  { ConvTopicCategory_AskAboutObject,     "Ask about object" },
+  { ConvTopicCategory_AskAboutRace,       "Ask about race" },
+  { ConvTopicCategory_DisplayObject,      "Display object" },
+  { ConvTopicCategory_GiveObject,         "Give object" },
+  { ConvTopicCategory_GiveFact,           "Give fact" },
+  { ConvTopicCategory_SeesObject,         "Sees item in inventory" }
+};
+
 enum ConvTableType
 {
   ConvTableType_Individual,
@@ -42,33 +61,73 @@ enum ConvTableType
   ConvTableType_Invalid
 };
 
+/**
+ * A single record from a TLKT file, along with the line of dialogue that it selects
+ */
+struct ConvTopicLine
+{
+  int priority;
+  int tlknIndex;
+  int tlkxIndex;
+  QVector<QPair<ConvTopicCategory,int> > topics;
+  QString text;
+  QString plainText;
+  QVector<QPair<GTxtCmd,int> > commands;
+};
+
+/**
+ * Looks up the lines of dialogue that aliens speak about each conversation topic. The topic
+ * table (TLKT) of each individual alien and race is indexed the first time it is needed, so
+ * that each later lookup is a single hash lookup rather than a scan of the whole table.
+ */
 class ConversationText
 {
 public:
   ConversationText(DatLibrary& lib, Aliens& aliens, GameText& gtext);
+  void clear();
   QString getConversationText(int alienId, ConvTopicCategory topic, int thingId, QVector<QPair<GTxtCmd,int> >& commands);
   bool doesInterestingDialogExist(int alienId, ConvTopicCategory category, int thingId);
+  bool getAllTopicLines(ConvTableType tableType, int id, QVector<ConvTopicLine>& lines);
+  static void getTopicsForRecord(const uint8_t* record, QVector<QPair<ConvTopicCategory,int> >& topics);
 
 private:
+  //! The TLKN index and priority of the dialogue chosen for a single topic
+  struct TopicEntry
+  {
+    int tlknIndex;
+    int priority;
+  };
+
+  //! Index of a single TLKT file, keyed by topic category and thing ID (see topicKey())
+  typedef QHash<quint32,TopicEntry> TopicIndex;
+
   DatLibrary* m_lib;
   Aliens* m_aliens;
   GameText* m_gtext;
 
+  //! Topic indices that have been built so far, keyed by table type and alien/race ID
+  QHash<quint32,TopicIndex> m_topicIndices;
+
   bool getTLKTData(ConvTableType tableType, int id, QByteArray& data);
   bool getTLKNData(ConvTableType tableType, int id, QByteArray& data);
   bool getTLKXData(ConvTableType tableType, int id, QByteArray& indexData, QByteArray& strData);
 
-  //! Searches the provided TLKTR or TLKTC file to get a list of TLKN indices that match the provided criteria
-  int getTLKNIndex(ConvTopicCategory topic, int thingId, const QByteArray& tlktData);
-
-  const QString getTLKNCFilename(int id);
-  const QString getTLKNRFilename(int id);
-  const QString getTLKTCFilename(int id);
-  const QString getTLKTRFilename(int id);
-  const QString getTLKXCIndexFilename(int id);
-  const QString getTLKXRIndexFilename(int id);
-  const QString getTLKXCStringsFilename(int id);
-  const QString getTLKXRStringsFilename(int id);
+  //! Looks up the TLKN index of the line spoken about a topic in the specified alien's or race's TLKT file
+  int getTLKNIndex(ConvTableType tableType, int id, ConvTopicCategory topic, int thingId);
+  const TopicIndex& getTopicIndex(ConvTableType tableType, int id);
+  static void buildTopicIndex(const QByteArray& tlktData, TopicIndex& topicIndex);
+  static void addTopic(TopicIndex& topicIndex, ConvTopicCategory topic, int thingId, int priority, int tlknIndex);
+  static quint32 topicKey(ConvTopicCategory topic, int thingId);
+
+  static DatFileKey makeKey(const char* format, int id);
+  const DatFileKey getTLKNCFilename(int id);
+  const DatFileKey getTLKNRFilename(int id);
+  const DatFileKey getTLKTCFilename(int id);
+  const DatFileKey getTLKTRFilename(int id);
+  const DatFileKey getTLKXCIndexFilename(int id);
+  const DatFileKey getTLKXRIndexFilename(int id);
+  const DatFileKey getTLKXCStringsFilename(int id);
+  const DatFileKey getTLKXRStringsFilename(int id);
 
   //! Reads data from the provided TLKNC or TLKNR data to provide an index into a TLKXC/TLKXR file
   int getTLKXIndex(int tlknIndex, const QByteArray& tlknData);
@@ -0,0 +1,176 @@
+#include "datextractor.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSet>
+#include <QtConcurrent/QtConcurrentMap>
+
+DatExtractor::DatExtractor(const DatLibrary& lib) :
+  m_lib(&lib),
+  m_filesWritten(0),
+  m_filesFailed(0),
+  m_bytesWritten(0)
+{
+}
+
+/**
+ * Extracts the contents of every DAT container into the specified output directory.
+ * The files from each container are written to a subdirectory named after the container
+ * (e.g. "ANIM" for ANIM.DAT).
+ * @return True if every file was extracted successfully; false otherwise (including when
+ * no output directory is given.)
+ */
+bool DatExtractor::extractAll(QString outputDir)
+{
+  bool status = false;
+  QVector<ExtractJob> jobs;
+
+  // an empty directory would put the output at the root of the filesystem
+  if (!outputDir.isEmpty())
+  {
+    foreach (DatFileType dat, DatLibrary::s_datFileNames.keys())
+    {
+      queueContainer(dat, outputDir, jobs);
+    }
+
+    status = runJobs(jobs);
+  }
+
+  return status;
+}
+
+/**
+ * Extracts the contents of a single DAT container into a subdirectory (named after the
+ * container) of the specified output directory.
+ * @return True if every file was extracted successfully; false otherwise (including when
+ * no output directory is given.)
+ */
+bool DatExtractor::extractContainer(DatFileType dat, QString outputDir)
+{
+  bool status = false;
+  QVector<ExtractJob> jobs;
+
+  if (!outputDir.isEmpty())
+  {
+    queueContainer(dat, outputDir, jobs);
+    status = runJobs(jobs);
+  }
+
+  return status;
+}
+
+/**
+ * Returns the number of files written by the last extraction.
+ */
+int DatExtractor::getFilesWritten() const
+{
+  return m_filesWritten;
+}
+
+/**
+ * Returns the number of files that could not be decompressed or written by the last extraction.
+ */
+int DatExtractor::getFilesFailed() const
+{
+  return m_filesFailed;
+}
+
+/**
+ * Returns the total number of bytes written by the last extraction.
+ */
+qint64 DatExtractor::getBytesWritten() const
+{
+  return m_bytesWritten;
+}
+
+/**
+ * Creates the output subdirectory for the specified container and adds a job for each of
+ * its index entries. If the same filename appears more than once in a container, only the
+ * first occurrence is extracted (which is also the one found by a lookup by name); this
+ * also ensures that no two jobs ever write to the same output file. If the subdirectory
+ * can't be created, the jobs are still added (so that they're counted as failures), but
+ * they're marked so that they aren't run.
+ */
+void DatExtractor::queueContainer(DatFileType dat, QString outputDir, QVector<ExtractJob>& jobs) const
+{
+  const QString subdirName = QFileInfo(DatLibrary::s_datFileNames[dat]).completeBaseName();
+  const QString containerDir = outputDir + "/" + subdirName;
+  const int fileCount = m_lib->getFileCount(dat);
+  const bool dirCreated = QDir().mkpath(containerDir);
+  QSet<QString> namesSeen;
+
+  jobs.reserve(jobs.size() + fileCount);
+
+  for (int index = 0; index < fileCount; index++)
+  {
+    const QString filename = m_lib->getFilenameAtIndex(dat, index);
+    const QString nameKey = filename.toUpper();
+
+    if (!filename.isEmpty() && !namesSeen.contains(nameKey))
+    {
+      namesSeen.insert(nameKey);
+
+      ExtractJob job;
+      job.dat = dat;
+      job.index = index;
+      job.outputPath = containerDir + "/" + filename;
+      job.runnable = dirCreated;
+      job.bytesWritten = 0;
+      job.success = false;
+      jobs.append(job);
+    }
+  }
+}
+
+/**
+ * Runs each of the provided jobs on the global thread pool, blocking until they have all
+ * completed, and then tallies the results.
+ * @return True if every job succeeded; false otherwise.
+ */
+bool DatExtractor::runJobs(QVector<ExtractJob>& jobs)
+{
+  const DatLibrary* lib = m_lib;
+  QtConcurrent::blockingMap(jobs, [lib](ExtractJob& job) { extractEntry(lib, job); });
+
+  m_filesWritten = 0;
+  m_filesFailed = 0;
+  m_bytesWritten = 0;
+
+  foreach (const ExtractJob& job, jobs)
+  {
+    if (job.success)
+    {
+      m_filesWritten++;
+      m_bytesWritten += job.bytesWritten;
+    }
+    else
+    {
+      m_filesFailed++;
+    }
+  }
+
+  return (m_filesFailed == 0);
+}
+
+/**
+ * Decompresses a single entry and writes it to its output file. The decoded data is
+ * written with a single unbuffered call, since it is already entirely in memory and
+ * copying it through QFile's internal buffer would only add overhead. The library's
+ * uncached decode path is used here, because each entry is only read once, so caching
+ * it would only evict more useful entries.
+ */
+void DatExtractor::extractEntry(const DatLibrary* lib, ExtractJob& job)
+{
+  QByteArray data;
+
+  if (job.runnable && lib->decodeFileAtIndex(job.dat, static_cast<unsigned int>(job.index), data))
+  {
+    QFile outFile(job.outputPath);
+    if (outFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+    {
+      job.bytesWritten = outFile.write(data);
+      job.success = (job.bytesWritten == data.size());
+      outFile.close();
+    }
+  }
+}
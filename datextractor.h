@@ -0,0 +1,48 @@
+#ifndef DATEXTRACTOR_H
+#define DATEXTRACTOR_H
+
+#include <QString>
+#include <QVector>
+#include "datlibrary.h"
+
+/**
+ * Extracts (and decompresses) every file from the open DAT containers into a directory
+ * tree on disk, with one subdirectory per container. Each entry is handled as a separate
+ * task on the global thread pool, and no GUI classes are used, so this may be run headless.
+ */
+class DatExtractor
+{
+public:
+  DatExtractor(const DatLibrary& lib);
+
+  bool extractAll(QString outputDir);
+  bool extractContainer(DatFileType dat, QString outputDir);
+
+  int getFilesWritten() const;
+  int getFilesFailed() const;
+  qint64 getBytesWritten() const;
+
+private:
+  //! A single index entry to be decompressed and written out
+  struct ExtractJob
+  {
+    DatFileType dat;
+    int index;
+    QString outputPath;
+    //! False if the output directory for the job couldn't be created
+    bool runnable;
+    qint64 bytesWritten;
+    bool success;
+  };
+
+  const DatLibrary* m_lib;
+  int m_filesWritten;
+  int m_filesFailed;
+  qint64 m_bytesWritten;
+
+  void queueContainer(DatFileType dat, QString outputDir, QVector<ExtractJob>& jobs) const;
+  bool runJobs(QVector<ExtractJob>& jobs);
+  static void extractEntry(const DatLibrary* lib, ExtractJob& job);
+};
+
+#endif // DATEXTRACTOR_H
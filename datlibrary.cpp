@@ -1,10 +1,16 @@
 #include "datlibrary.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDataStream>
 #include <QIODevice>
 #include <QtEndian>
+#include <QMutexLocker>
 #include <QImage>
 #include <QRgb>
+#include <ctype.h>
 #include <string.h>
+#include <stddef.h>
 
 const QMap<DatFileType,QString> DatLibrary::s_datFileNames
 {
@@ -15,31 +21,103 @@ const QMap<DatFileType,QString> DatLibrary::s_datFileNames
   {DatFileType_TEST,     DAT_FILENAME_TEST}
 };
 
-DatLibrary::DatLibrary()
+/**
+ * Builds a lookup key from a null-terminated filename. Only the first
+ * (INDEX_FILENAME_LEN - 1) characters are significant.
+ */
+DatFileKey::DatFileKey(const char* filename)
 {
+  int pos = 0;
+  while ((pos < (INDEX_FILENAME_LEN - 1)) && (filename[pos] != 0))
+  {
+    name[pos] = static_cast<char>(toupper(static_cast<unsigned char>(filename[pos])));
+    pos++;
+  }
+  memset(name + pos, 0, INDEX_FILENAME_LEN - pos);
 
+  hash = DatLibrary::hashFilename(name, INDEX_FILENAME_LEN);
 }
 
-DatLibrary::~DatLibrary()
+/**
+ * Builds a lookup key from a filename in a QString. Filenames in the DAT indices are
+ * plain ASCII, so each character is simply narrowed to Latin-1.
+ */
+DatFileKey::DatFileKey(const QString& filename)
 {
+  const int len = qMin(filename.size(), INDEX_FILENAME_LEN - 1);
+  const QChar* chars = filename.constData();
+  int pos = 0;
 
+  while ((pos < len) && !chars[pos].isNull())
+  {
+    name[pos] = static_cast<char>(toupper(static_cast<unsigned char>(chars[pos].toLatin1())));
+    pos++;
+  }
+  memset(name + pos, 0, INDEX_FILENAME_LEN - pos);
+
+  hash = DatLibrary::hashFilename(name, INDEX_FILENAME_LEN);
+}
+
+DatLibrary::DatLibrary() :
+  m_gameTextLoaded(0)
+{
+  for (int datIdx = 0; datIdx < DatFileType_NUM_DAT_FILES; datIdx++)
+  {
+    m_mappedData[datIdx] = nullptr;
+  }
+
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    m_cacheShards[shardIdx].cache.setMaxCost(DAT_CACHE_DEFAULT_BUDGET_BYTES / DAT_CACHE_SHARD_COUNT);
+    m_cacheShards[shardIdx].hits = 0;
+    m_cacheShards[shardIdx].misses = 0;
+  }
+}
+
+DatLibrary::~DatLibrary()
+{
+  closeData();
 }
 
 /**
- * Opens and reads each of the .DAT container files in the provided game data directory.
+ * Opens each of the .DAT container files in the provided game data directory. By default,
+ * the containers are memory-mapped rather than read in, so that opening the data costs
+ * almost nothing and pages are only faulted in for the entries that are actually accessed.
+ * If a container cannot be mapped (or if useMemoryMap is false), its full contents are read
+ * into memory instead.
  * @return True if all files were present and readable, false otherwise.
  */
-bool DatLibrary::openData(QString pathToGameDir)
+bool DatLibrary::openData(QString pathToGameDir, bool useMemoryMap)
 {
   bool status = true;
+  closeData();
+
   foreach (DatFileType dat, s_datFileNames.keys())
   {
     const QString fullpath = pathToGameDir + "/" + s_datFileNames[dat];
-    QFile datFile(fullpath);
+    QFile& datFile = m_datFiles[dat];
+    datFile.setFileName(fullpath);
 
     if (datFile.open(QIODevice::ReadOnly))
     {
-      m_datContents[dat] = datFile.readAll();
+      const qint64 datSize = datFile.size();
+      uchar* mapped = (useMemoryMap && (datSize > 0)) ? datFile.map(0, datSize) : nullptr;
+
+      if (mapped)
+      {
+        m_mappedData[dat] = mapped;
+
+        // the QByteArray doesn't own or copy the mapped data; it only provides
+        // a view of it that stays valid until the file is unmapped in closeData()
+        m_datContents[dat] = QByteArray::fromRawData(reinterpret_cast<const char*>(mapped), static_cast<int>(datSize));
+      }
+      else
+      {
+        m_datContents[dat] = datFile.readAll();
+        datFile.close();
+      }
+
+      buildNameIndex(dat);
     }
     else
     {
@@ -51,36 +129,51 @@ bool DatLibrary::openData(QString pathToGameDir)
 }
 
 /**
- * Clears the cached contents of all the DAT files that were read in.
+ * Clears the cached contents of all the DAT files that were read in, and unmaps
+ * any containers that were memory-mapped.
  */
 void DatLibrary::closeData()
 {
   foreach (DatFileType datType, s_datFileNames.keys())
   {
     m_datContents[datType].clear();
+    m_nameIndex[datType].clear();
+
+    if (m_mappedData[datType])
+    {
+      m_datFiles[datType].unmap(m_mappedData[datType]);
+      m_mappedData[datType] = nullptr;
+    }
+    m_datFiles[datType].close();
+  }
+
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    m_cacheShards[shardIdx].cache.clear();
   }
 
   m_gameText.clear();
+  m_gameTextStrings.clear();
+  m_gameTextLoaded.storeRelease(0);
 }
 
 /**
- * Reads file at the specified index in the DAT container and LZ decompress it (if necessary). The
- * decompressed data is returned in the provided QByteArray.
- * @return True when the requested file was found and decompressed successfully; false otherwise.
+ * Reads the index entry for the file at the specified index in the DAT container, and locates
+ * the stored (possibly compressed) file data within the container.
+ * @return Pointer to the first byte of the stored file, or nullptr if the index number is out of
+ * range or the stored file does not lie entirely within the container.
  */
-bool DatLibrary::getFileAtIndex(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const
+const char* DatLibrary::getStoredFile(DatFileType dat, unsigned int index, DatFileIndex& indexEntry, int& skipUncompressedBytes) const
 {
-  bool status = false;
+  const char* storedFile = nullptr;
   const unsigned long indexEntryOffset = 2 + (index * sizeof(DatFileIndex));
 
   if (m_datContents[dat].size() >= static_cast<int>((indexEntryOffset + sizeof(DatFileIndex))))
   {
     const char* rawDat = m_datContents[dat].constData();
-    int skipUncompressedBytes = 0;
-
-    DatFileIndex indexEntry;
     memcpy(&indexEntry, rawDat + indexEntryOffset, sizeof(DatFileIndex));
 
+    skipUncompressedBytes = 0;
     if ((indexEntry.flags_b & 0x01) && (~indexEntry.flags_a & 0x04))
     {
       skipUncompressedBytes = 4;
@@ -88,18 +181,96 @@ bool DatLibrary::getFileAtIndex(DatFileType dat, unsigned int index, QByteArray&
 
     // note that files with the uncompressed 4-byte header must have those
     // four bytes added to the listed compressed size when copying
-    QByteArray storedFile;
-    storedFile.append(rawDat + indexEntry.offset, indexEntry.compressed_size + skipUncompressedBytes);
+    const qint64 storedSize = static_cast<qint64>(indexEntry.compressed_size) + skipUncompressedBytes;
+
+    // since the container may be memory-mapped, the stored file must lie entirely within
+    // the container; reading past the end of a mapping would fault rather than just
+    // returning garbage
+    if ((indexEntry.compressed_size >= 0) &&
+        ((static_cast<qint64>(indexEntry.offset) + storedSize) <= m_datContents[dat].size()))
+    {
+      storedFile = rawDat + indexEntry.offset;
+    }
+  }
+
+  return storedFile;
+}
+
+/**
+ * Reads file at the specified index in the DAT container and LZ decompress it (if necessary). The
+ * decompressed data is returned in the provided QByteArray.
+ * @return True when the requested file was found and decompressed successfully; false otherwise.
+ */
+bool DatLibrary::getFileAtIndex(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const
+{
+  bool status = false;
+  const quint32 cacheKey = (static_cast<quint32>(dat) << 16) | (index & 0xFFFF);
+  CacheShard& shard = cacheShard(cacheKey);
+
+  {
+    // the cached QByteArray is implicitly shared, so handing out a copy of it is cheap
+    QMutexLocker lock(&shard.mutex);
+    const QByteArray* cached = shard.cache.object(cacheKey);
+    if (cached)
+    {
+      shard.hits++;
+      decompressedFile = *cached;
+      return true;
+    }
+    shard.misses++;
+  }
+
+  // the lock isn't held while decoding, so that other threads can be served from the
+  // cache in the meantime; if two threads miss on the same entry, both decode it and
+  // the second insertion simply replaces the first
+  status = decodeFileWithDiskCache(dat, index, decompressedFile);
+
+  if (status)
+  {
+    // entries larger than the shard's share of the budget are simply not cached
+    QMutexLocker lock(&shard.mutex);
+    shard.cache.insert(cacheKey, new QByteArray(decompressedFile), qMax(decompressedFile.size(), 1));
+  }
+
+  return status;
+}
+
+/**
+ * Reads the file at the specified index in the DAT container and LZ decompresses it (if
+ * necessary), without consulting or updating the cache. Since this only reads from the
+ * containers, it may be called from several threads at once (as long as the containers
+ * are not closed or reopened in the meantime).
+ * @return True when the requested file was found and decompressed successfully; false otherwise.
+ */
+bool DatLibrary::decodeFileAtIndex(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const
+{
+  bool status = false;
+  DatFileIndex indexEntry;
+  int skipUncompressedBytes = 0;
+  const char* storedFile = getStoredFile(dat, index, indexEntry, skipUncompressedBytes);
+
+  if (storedFile)
+  {
+    const int storedSize = indexEntry.compressed_size + skipUncompressedBytes;
 
     // if the file is stored with some form of compression
     if (indexEntry.flags_b & 0x1)
     {
-      status = lzDecompress(storedFile, decompressedFile, skipUncompressedBytes);
+      // size the output from the index entry up front, so that the decoder
+      // never needs to grow the buffer as it goes
+      const int expectedSize = qMax(indexEntry.uncompressed_size, 0) + skipUncompressedBytes;
+      decompressedFile.resize(expectedSize);
+
+      const int outputSize = lzDecompress(reinterpret_cast<const uint8_t*>(storedFile), storedSize,
+                                          reinterpret_cast<uint8_t*>(decompressedFile.data()), expectedSize,
+                                          skipUncompressedBytes);
+      status = (outputSize >= 0);
+      decompressedFile.resize(qMax(outputSize, 0));
     }
     else
     {
       // the file is not compressed, and may be copied byte-for-byte from the .DAT
-      decompressedFile = storedFile;
+      decompressedFile = QByteArray(storedFile, storedSize);
       status = true;
     }
   }
@@ -108,39 +279,368 @@ bool DatLibrary::getFileAtIndex(DatFileType dat, unsigned int index, QByteArray&
 }
 
 /**
- * Searches the DAT container for the file with the specified name, reads and decompresses it,
- * and returns the decompressed data in the provided QByteArray.
- * @return True if the file was found, read, and decompressed successfully; false otherwise.
+ * Decompresses the file at the specified index in the DAT container as decodeFileAtIndex()
+ * does, except that large compressed entries are first looked for in the disk cache, and are
+ * stored there after being decompressed. The disk cache key is a hash of the stored entry and
+ * its index fields, so an entry that changes in the container is simply decompressed again.
+ * @return True when the requested file was found and decompressed successfully; false otherwise.
  */
-bool DatLibrary::getFileByName(DatFileType dat, QString filename, QByteArray& filedata) const
+bool DatLibrary::decodeFileWithDiskCache(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const
 {
-  const char* rawdat = m_datContents[dat].constData();
-  const long datsize = m_datContents[dat].size();
-  bool found = false;
   bool status = false;
-  long currentIndexOffset = 2;
-  const DatFileIndex* index = nullptr;
-  unsigned int indexNum = 0;
+  DatFileIndex indexEntry;
+  int skipUncompressedBytes = 0;
+  const char* storedFile = getStoredFile(dat, index, indexEntry, skipUncompressedBytes);
 
-  while (!found && ((currentIndexOffset + sizeof(DatFileIndex)) < datsize))
+  if (storedFile && (indexEntry.flags_b & 0x1) && m_diskCache.isEnabled() &&
+      (indexEntry.uncompressed_size >= DAT_DISK_CACHE_MIN_BYTES))
   {
-    // point to the index struct at the current location
-    index = reinterpret_cast<const DatFileIndex*>(rawdat + currentIndexOffset);
+    // the flags and sizes decide how the stored data is decompressed, so they're part of the key
+    const quint64 seed = ASSET_CACHE_VERSION ^
+                         AssetCache::hash(reinterpret_cast<const char*>(&indexEntry), offsetof(DatFileIndex, filename));
+    const quint64 key = AssetCache::hash(storedFile, indexEntry.compressed_size + skipUncompressedBytes, seed);
+
+    status = m_diskCache.load(key, decompressedFile);
+    if (!status)
+    {
+      status = decodeFileAtIndex(dat, index, decompressedFile);
+      if (status)
+      {
+        m_diskCache.store(key, decompressedFile);
+      }
+    }
+  }
+  else
+  {
+    status = decodeFileAtIndex(dat, index, decompressedFile);
+  }
+
+  return status;
+}
+
+/**
+ * Gets a read-only view of the file at the specified index in the DAT container. When the file
+ * is stored without compression, the returned QByteArray does not own its data; it refers
+ * directly to the bytes in the container (or its memory mapping), so no copy is made. Compressed
+ * files are decompressed (or fetched from the cache) exactly as with getFileAtIndex().
+ *
+ * A view is only valid until closeData() is called. Modifying it causes Qt to detach it
+ * into a private copy, so it can never be used to write to the container.
+ * @return True when the requested file was found (and decompressed, if necessary); false otherwise.
+ */
+bool DatLibrary::getFileViewAtIndex(DatFileType dat, unsigned int index, QByteArray& view) const
+{
+  bool status = false;
+  DatFileIndex indexEntry;
+  int skipUncompressedBytes = 0;
+  const char* storedFile = getStoredFile(dat, index, indexEntry, skipUncompressedBytes);
 
-    if (strncmp(filename.toStdString().c_str(), index->filename, INDEX_FILENAME_LEN) == 0)
+  if (storedFile)
+  {
+    if (indexEntry.flags_b & 0x1)
     {
-      found = true;
+      status = getFileAtIndex(dat, index, view);
     }
     else
     {
-      currentIndexOffset += sizeof(DatFileIndex);
-      indexNum++;
+      view = QByteArray::fromRawData(storedFile, indexEntry.compressed_size);
+      status = true;
     }
-  };
+  }
+
+  return status;
+}
+
+/**
+ * Returns the cache shard that holds the entry with the specified key. Consecutive index
+ * numbers in a container go to different shards, as do the same index numbers in different
+ * containers.
+ */
+DatLibrary::CacheShard& DatLibrary::cacheShard(quint32 cacheKey) const
+{
+  return m_cacheShards[(cacheKey ^ (cacheKey >> 16)) % DAT_CACHE_SHARD_COUNT];
+}
+
+/**
+ * Sets the maximum total size (in bytes) of the decompressed entries that are kept in the
+ * cache. The budget is split evenly between the shards, so a single entry is only cached if
+ * it is no larger than a shard's share. Least-recently-used entries are evicted if the cache
+ * is already over the new budget.
+ */
+void DatLibrary::setCacheBudget(int bytes)
+{
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    QMutexLocker lock(&m_cacheShards[shardIdx].mutex);
+    m_cacheShards[shardIdx].cache.setMaxCost(bytes / DAT_CACHE_SHARD_COUNT);
+  }
+}
+
+/**
+ * Returns the maximum total size (in bytes) of the decompressed entries kept in the cache.
+ */
+int DatLibrary::getCacheBudget() const
+{
+  int budget = 0;
+
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    QMutexLocker lock(&m_cacheShards[shardIdx].mutex);
+    budget += m_cacheShards[shardIdx].cache.maxCost();
+  }
+
+  return budget;
+}
+
+/**
+ * Discards all cached decompressed entries and resets the hit/miss counters.
+ */
+void DatLibrary::clearCache()
+{
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    QMutexLocker lock(&m_cacheShards[shardIdx].mutex);
+    m_cacheShards[shardIdx].cache.clear();
+    m_cacheShards[shardIdx].hits = 0;
+    m_cacheShards[shardIdx].misses = 0;
+  }
+}
+
+/**
+ * Returns the number of file reads that were satisfied from the cache.
+ */
+quint64 DatLibrary::getCacheHits() const
+{
+  quint64 hits = 0;
+
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    QMutexLocker lock(&m_cacheShards[shardIdx].mutex);
+    hits += m_cacheShards[shardIdx].hits;
+  }
+
+  return hits;
+}
+
+/**
+ * Returns the number of file reads that required the entry to be decompressed.
+ */
+quint64 DatLibrary::getCacheMisses() const
+{
+  quint64 misses = 0;
+
+  for (int shardIdx = 0; shardIdx < DAT_CACHE_SHARD_COUNT; shardIdx++)
+  {
+    QMutexLocker lock(&m_cacheShards[shardIdx].mutex);
+    misses += m_cacheShards[shardIdx].misses;
+  }
+
+  return misses;
+}
+
+/**
+ * Sets the directory in which the larger decompressed entries are kept between sessions, and
+ * the limit on their total size (see AssetCache::setDirectory()). An empty string disables the
+ * disk cache. This must not be called while another thread is using the library.
+ */
+void DatLibrary::setDiskCacheDirectory(const QString& dir, qint64 maxBytes)
+{
+  m_diskCache.setDirectory(dir, maxBytes);
+}
+
+/**
+ * Returns the directory in which decompressed entries are kept between sessions, or an
+ * empty string if the disk cache is disabled.
+ */
+QString DatLibrary::getDiskCacheDirectory() const
+{
+  return m_diskCache.getDirectory();
+}
+
+/**
+ * Returns the number of files listed in the index of the specified DAT container. If the
+ * container is too short to hold as many index entries as its header claims, only the
+ * entries that are actually present are counted.
+ */
+int DatLibrary::getFileCount(DatFileType dat) const
+{
+  int count = 0;
+  const long datsize = m_datContents[dat].size();
+
+  if (datsize >= 2)
+  {
+    const long maxEntries = (datsize - 2) / static_cast<long>(sizeof(DatFileIndex));
+    count = static_cast<int>(qMin<long>(qFromLittleEndian<quint16>(m_datContents[dat].constData()), maxEntries));
+  }
+
+  return count;
+}
+
+/**
+ * Returns the name of the file at the specified index in the DAT container, or an empty
+ * string if the index number is out of range.
+ */
+QString DatLibrary::getFilenameAtIndex(DatFileType dat, int index) const
+{
+  QString filename;
 
-  if (found)
+  if ((index >= 0) && (index < getFileCount(dat)))
   {
-    status = getFileAtIndex(dat, indexNum, filedata);
+    const DatFileIndex* entry =
+      reinterpret_cast<const DatFileIndex*>(m_datContents[dat].constData() + 2 + (index * sizeof(DatFileIndex)));
+    filename = QString::fromLatin1(entry->filename, static_cast<int>(qstrnlen(entry->filename, INDEX_FILENAME_LEN)));
+  }
+
+  return filename;
+}
+
+/**
+ * Computes a case-insensitive FNV-1a hash of the provided filename, stopping at the
+ * first null or after maxlen characters (whichever comes first).
+ */
+uint32_t DatLibrary::hashFilename(const char* filename, int maxlen)
+{
+  uint32_t hash = 2166136261u;
+
+  for (int pos = 0; (pos < maxlen) && (filename[pos] != 0); pos++)
+  {
+    hash ^= static_cast<uint8_t>(toupper(static_cast<unsigned char>(filename[pos])));
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/**
+ * Parses the index of the specified DAT container into an open-addressed hash table
+ * keyed by filename, so that lookups by name don't need to walk the index. If the
+ * same name appears more than once, lookups will find the first occurrence (which
+ * matches the behavior of a linear search).
+ */
+void DatLibrary::buildNameIndex(DatFileType dat)
+{
+  const char* rawdat = m_datContents[dat].constData();
+  const long datsize = m_datContents[dat].size();
+  QVector<DatIndexSlot>& table = m_nameIndex[dat];
+
+  table.clear();
+
+  if (datsize >= 2)
+  {
+    const int fileCount = getFileCount(dat);
+
+    // keep the load factor at or below one half so that probe sequences stay short
+    int tableSize = 16;
+    while (tableSize < (fileCount * 2))
+    {
+      tableSize *= 2;
+    }
+
+    const DatIndexSlot emptySlot = { 0, -1 };
+    table.fill(emptySlot, tableSize);
+    const int mask = tableSize - 1;
+
+    for (int indexNum = 0; indexNum < fileCount; indexNum++)
+    {
+      const DatFileIndex* index = reinterpret_cast<const DatFileIndex*>(rawdat + 2 + (indexNum * sizeof(DatFileIndex)));
+      const uint32_t hash = hashFilename(index->filename, INDEX_FILENAME_LEN);
+
+      int slot = static_cast<int>(hash & mask);
+      while (table[slot].index >= 0)
+      {
+        slot = (slot + 1) & mask;
+      }
+
+      table[slot].hash = hash;
+      table[slot].index = indexNum;
+    }
+  }
+}
+
+/**
+ * Looks up the provided key in the filename hash table for the specified DAT container.
+ * @return Index of the matching file in the container, or -1 if no file has that name.
+ */
+int DatLibrary::findIndex(DatFileType dat, const DatFileKey& key) const
+{
+  const QVector<DatIndexSlot>& table = m_nameIndex[dat];
+  int foundIndex = -1;
+
+  if (!table.isEmpty())
+  {
+    const char* rawdat = m_datContents[dat].constData();
+    const int mask = table.size() - 1;
+    int slot = static_cast<int>(key.hash & mask);
+
+    while ((foundIndex < 0) && (table[slot].index >= 0))
+    {
+      if (table[slot].hash == key.hash)
+      {
+        const DatFileIndex* index = reinterpret_cast<const DatFileIndex*>(rawdat + 2 + (table[slot].index * sizeof(DatFileIndex)));
+        if (qstrnicmp(key.name, index->filename, INDEX_FILENAME_LEN) == 0)
+        {
+          foundIndex = table[slot].index;
+        }
+      }
+      slot = (slot + 1) & mask;
+    }
+  }
+
+  return foundIndex;
+}
+
+/**
+ * Searches the DAT container for the file with the specified name, reads and decompresses it,
+ * and returns the decompressed data in the provided QByteArray. The name comparison is not
+ * case-sensitive.
+ * @return True if the file was found, read, and decompressed successfully; false otherwise.
+ */
+bool DatLibrary::getFileByName(DatFileType dat, QString filename, QByteArray& filedata) const
+{
+  return getFileByKey(dat, DatFileKey(filename), filedata);
+}
+
+/**
+ * Searches the DAT container for the file matching the provided (pre-hashed) key, reads and
+ * decompresses it, and returns the decompressed data in the provided QByteArray.
+ * @return True if the file was found, read, and decompressed successfully; false otherwise.
+ */
+bool DatLibrary::getFileByKey(DatFileType dat, const DatFileKey& key, QByteArray& filedata) const
+{
+  bool status = false;
+  const int indexNum = findIndex(dat, key);
+
+  if (indexNum >= 0)
+  {
+    status = getFileAtIndex(dat, static_cast<unsigned int>(indexNum), filedata);
+  }
+
+  return status;
+}
+
+/**
+ * Searches the DAT container for the file with the specified name and returns a read-only
+ * view of it. See getFileViewAtIndex() for the lifetime of the returned data.
+ * @return True if the file was found (and decompressed, if necessary); false otherwise.
+ */
+bool DatLibrary::getFileViewByName(DatFileType dat, QString filename, QByteArray& view) const
+{
+  return getFileViewByKey(dat, DatFileKey(filename), view);
+}
+
+/**
+ * Searches the DAT container for the file matching the provided (pre-hashed) key and returns
+ * a read-only view of it. See getFileViewAtIndex() for the lifetime of the returned data.
+ * @return True if the file was found (and decompressed, if necessary); false otherwise.
+ */
+bool DatLibrary::getFileViewByKey(DatFileType dat, const DatFileKey& key, QByteArray& view) const
+{
+  bool status = false;
+  const int indexNum = findIndex(dat, key);
+
+  if (indexNum >= 0)
+  {
+    status = getFileViewAtIndex(dat, static_cast<unsigned int>(indexNum), view);
   }
 
   return status;
@@ -150,7 +650,7 @@ bool DatLibrary::getFileByName(DatFileType dat, QString filename, QByteArray& fi
  * Gets a list of all the files in the specified DAT who names match the provided file extension.
  * @return List of matching filenames
  */
-QStringList DatLibrary::getFilenamesByExtension(DatFileType dat, QString extension)
+QStringList DatLibrary::getFilenamesByExtension(DatFileType dat, QString extension) const
 {
   const char* rawdat = m_datContents[dat].constData();
   const long datsize = m_datContents[dat].size();
@@ -181,124 +681,172 @@ QStringList DatLibrary::getFilenamesByExtension(DatFileType dat, QString extensi
 }
 
 /**
- * @brief DatLibrary::lzDecompress
- * @return True if the file was successfully decompressed; false otherwise.
+ * Builds a signature of the DAT containers that are currently open, from the name, size, and
+ * modification time of each one. Data that was derived from the containers and saved to disk
+ * can be stored along with this signature, and then only reused while the signature matches.
  */
-bool DatLibrary::lzDecompress(QByteArray compressedfile, QByteArray& decompressedFile, int skipUncompressedBytes) const
+QByteArray DatLibrary::getDataSignature() const
 {
-  bool status = true;
-
-  uint8_t lzRingBuffer[LZ_RINGBUF_SIZE];
-  memset (lzRingBuffer, 0x20, LZ_RINGBUF_SIZE);
+  QByteArray signature;
+  QDataStream ds(&signature, QIODevice::WriteOnly);
 
-  uint16_t bufPos = 0xFEE;
-  uint16_t inputPos = 0;
-  uint8_t codeword[2];
-  uint8_t flagByte = 0;
-  uint8_t decodeByte = 0;
-  uint8_t chunkIndex = 0;
-  uint8_t byteIndexInChunk = 0;
-  uint8_t chunkSize = 0;
-  uint16_t chunkSource = 0;
-  const int inputBufLen = compressedfile.size();
+  foreach (DatFileType dat, s_datFileNames.keys())
+  {
+    const QFileInfo info(m_datFiles[dat].fileName());
+    ds << s_datFileNames[dat];
+    ds << static_cast<qint64>(info.exists() ? info.size() : -1);
+    ds << static_cast<qint64>(info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1);
+  }
 
-  decompressedFile.clear();
+  return signature;
+}
 
-  if (skipUncompressedBytes > 0)
+/**
+ * Decodes LZ-compressed data from the provided input range into the provided output buffer,
+ * which the caller sizes up front from the index entry. The first skipUncompressedBytes of
+ * the input are copied through unchanged. Decoding stops when either the input is exhausted
+ * or the output buffer is full.
+ * @return Number of bytes written to the output buffer, or -1 if the input was too short to
+ * contain the uncompressed header.
+ */
+int DatLibrary::lzDecompress(const uint8_t* input, int inputLen, uint8_t* output, int outputLen, int skipUncompressedBytes)
+{
+  if ((skipUncompressedBytes > inputLen) || (skipUncompressedBytes > outputLen))
   {
-    if (inputBufLen >= skipUncompressedBytes)
-    {
-      decompressedFile.append(compressedfile.data(), skipUncompressedBytes);
-      inputPos += skipUncompressedBytes;
-    }
-    else
-    {
-      status = false;
-    }
+    return -1;
   }
 
-  while (status && (inputPos < inputBufLen))
+  uint8_t lzRingBuffer[LZ_RINGBUF_SIZE];
+  memset(lzRingBuffer, 0x20, LZ_RINGBUF_SIZE);
+
+  memcpy(output, input, skipUncompressedBytes);
+  int inputPos = skipUncompressedBytes;
+  int outputPos = skipUncompressedBytes;
+  int bufPos = 0xFEE;
+
+  while ((inputPos < inputLen) && (outputPos < outputLen))
   {
-    flagByte = static_cast<uint8_t>(compressedfile[inputPos++]);
+    unsigned int flagByte = input[inputPos++];
 
-    chunkIndex = 0;
-    while ((chunkIndex < 8) && (inputPos < inputBufLen))
+    for (int chunkIndex = 0; (chunkIndex < 8) && (inputPos < inputLen) && (outputPos < outputLen); chunkIndex++)
     {
-      if ((flagByte & (1 << chunkIndex)) != 0)
+      if (flagByte & 0x01)
       {
         // single byte literal
-        decodeByte = static_cast<uint8_t>(compressedfile[inputPos++]);
-        decompressedFile.append(static_cast<char>(decodeByte));
-
-        lzRingBuffer[bufPos++] = decodeByte;
-        if (bufPos >= LZ_RINGBUF_SIZE)
-        {
-          bufPos = 0;
-        }
+        const uint8_t decodeByte = input[inputPos++];
+        output[outputPos++] = decodeByte;
+        lzRingBuffer[bufPos] = decodeByte;
+        bufPos = (bufPos + 1) & (LZ_RINGBUF_SIZE - 1);
       }
-      else
+      else if ((inputPos + 1) < inputLen)
       {
         // two-byte reference to a sequence in the circular buffer
-        codeword[0] = static_cast<uint8_t>(compressedfile[inputPos++]);
-        codeword[1] = static_cast<uint8_t>(compressedfile[inputPos++]);
-
-        chunkSize =   ((codeword[1] & 0xF0) >> 4) + 3;
-        chunkSource = static_cast<uint16_t>(((codeword[1] & 0x0F) << 8) | codeword[0]);
-
-        byteIndexInChunk = 0;
-        while (byteIndexInChunk < chunkSize)
+        const uint8_t codewordLow = input[inputPos++];
+        const uint8_t codewordHigh = input[inputPos++];
+        const int chunkSize = qMin(((codewordHigh & 0xF0) >> 4) + 3, outputLen - outputPos);
+        int chunkSource = ((codewordHigh & 0x0F) << 8) | codewordLow;
+
+        if (((chunkSource + chunkSize) <= LZ_RINGBUF_SIZE) &&
+            ((bufPos + chunkSize) <= LZ_RINGBUF_SIZE) &&
+            ((chunkSource >= bufPos) || ((chunkSource + chunkSize) <= bufPos)))
         {
-          decodeByte = static_cast<uint8_t>(lzRingBuffer[chunkSource]);
-          decompressedFile.append(static_cast<char>(decodeByte));
-
-          if (++chunkSource >= LZ_RINGBUF_SIZE)
-          {
-            chunkSource = 0;
-          }
-
-          lzRingBuffer[bufPos] = decodeByte;
-          if (++bufPos >= LZ_RINGBUF_SIZE)
-          {
-            bufPos = 0;
-          }
-
-          byteIndexInChunk += 1;
+          // Neither the source nor the destination wraps around the end of the ring buffer, and
+          // the source never reads a byte that was written earlier in this same sequence, so the
+          // whole sequence can be copied as a block.
+          memmove(lzRingBuffer + bufPos, lzRingBuffer + chunkSource, chunkSize);
+          memcpy(output + outputPos, lzRingBuffer + bufPos, chunkSize);
+          outputPos += chunkSize;
+          bufPos = (bufPos + chunkSize) & (LZ_RINGBUF_SIZE - 1);
         }
-
-        if (byteIndexInChunk < chunkSize)
+        else
         {
-          status = false;
+          for (int byteIndexInChunk = 0; byteIndexInChunk < chunkSize; byteIndexInChunk++)
+          {
+            const uint8_t decodeByte = lzRingBuffer[chunkSource];
+            output[outputPos++] = decodeByte;
+            lzRingBuffer[bufPos] = decodeByte;
+            chunkSource = (chunkSource + 1) & (LZ_RINGBUF_SIZE - 1);
+            bufPos = (bufPos + 1) & (LZ_RINGBUF_SIZE - 1);
+          }
         }
       }
+      else
+      {
+        // the input ends partway through a codeword
+        inputPos = inputLen;
+      }
 
-      chunkIndex += 1;
-    } // end for chunkIndex 0 to 7
+      flagByte >>= 1;
+    }
   }
 
-  return status;
+  return outputPos;
 }
 
 /**
  * Convenience function that returns the string at the specified offset in GAMETEXT.TXT.
  * This function is provided because the GAMETEXT strings are used by many different parts of the game.
+ * The strings are decoded once, when the file is loaded, so most lookups only copy a shared QString.
  * @return The null-terminated string found at the specified offset, or an empty string if
  * an invalid offset was specified.
  */
-QString DatLibrary::getGameText(int offset)
+QString DatLibrary::getGameText(int offset) const
 {
-  QString txt("");
+  // the first caller loads the file; any other thread that gets here in the
+  // meantime waits on the mutex, and then sees that it has been loaded
+  if (!m_gameTextLoaded.loadAcquire())
+  {
+    QMutexLocker lock(&m_gameTextMutex);
+    if (!m_gameTextLoaded.loadAcquire())
+    {
+      QString filename("GAMETEXT.TXT");
+      getFileByName(DatFileType_CONVERSE, filename, m_gameText);
+      internGameText();
+      m_gameTextLoaded.storeRelease(1);
+    }
+  }
 
-  if (m_gameText.isEmpty())
+  // the interned table isn't modified again until the containers are closed,
+  // so it can be read without a lock
+  QHash<int,QString>::const_iterator interned = m_gameTextStrings.constFind(offset);
+  if (interned != m_gameTextStrings.constEnd())
   {
-    QString filename("GAMETEXT.TXT");
-    getFileByName(DatFileType_CONVERSE, filename, m_gameText);
+    return interned.value();
   }
 
-  if (offset < m_gameText.size())
+  QString txt("");
+
+  // an offset that points into the middle of a string (rather than at the start of one)
+  // still refers to a valid string, but it isn't interned
+  if ((offset >= 0) && (offset < m_gameText.size()))
   {
-    const char* rawdata = m_gameText.data();
+    const char* rawdata = m_gameText.constData();
     txt = QString::fromUtf8(rawdata + offset);
   }
 
   return txt;
 }
+
+/**
+ * Decodes every null-terminated string in GAMETEXT.TXT, and stores each one in a table
+ * keyed by the offset at which it starts.
+ */
+void DatLibrary::internGameText() const
+{
+  const char* const rawdata = m_gameText.constData();
+  const int size = m_gameText.size();
+  int start = 0;
+
+  m_gameTextStrings.clear();
+
+  while (start < size)
+  {
+    const char* const end = static_cast<const char*>(memchr(rawdata + start, 0, size - start));
+    const int length = end ? static_cast<int>(end - (rawdata + start)) : (size - start);
+
+    m_gameTextStrings.insert(start, QString::fromUtf8(rawdata + start, length));
+    start += length + 1;
+  }
+
+  m_gameTextStrings.squeeze();
+}
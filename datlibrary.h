@@ -5,11 +5,17 @@
 #include <QByteArray>
 #include <QString>
 #include <QMap>
+#include <QHash>
 #include <QImage>
 #include <QVector>
 #include <QRgb>
 #include <QPixmap>
 #include <QStringList>
+#include <QFile>
+#include <QCache>
+#include <QMutex>
+#include <QAtomicInt>
+#include "assetcache.h"
 
 #define LZ_RINGBUF_SIZE 0x1000
 
@@ -21,6 +27,15 @@
 
 #define INDEX_FILENAME_LEN    14
 
+//! Default limit on the total size of the decompressed entries kept in the cache
+#define DAT_CACHE_DEFAULT_BUDGET_BYTES (32 * 1024 * 1024)
+
+//! Number of independently locked parts that the cache is split into (each gets an equal share of the budget)
+#define DAT_CACHE_SHARD_COUNT 8
+
+//! Smallest decompressed entry that is kept in the on-disk cache; smaller entries decompress faster than they can be read back
+#define DAT_DISK_CACHE_MIN_BYTES (16 * 1024)
+
 enum DatFileType
 {
   DatFileType_ANIM,
@@ -43,26 +58,116 @@ typedef struct __attribute__((packed)) DatFileIndex
   uint32_t offset;
 } DatFileIndex;
 
+/**
+ * Lookup key for a file stored in a DAT container. The hash is computed over the
+ * upper-cased 8.3 filename, so a key can be built once (or on the stack, without
+ * allocating) and then used for any number of case-insensitive lookups.
+ */
+struct DatFileKey
+{
+  DatFileKey(const char* filename);
+  DatFileKey(const QString& filename);
+
+  uint32_t hash;
+  char name[INDEX_FILENAME_LEN];
+};
+
+/**
+ * Provides access to the files stored in the game's DAT containers.
+ *
+ * Thread safety: openData() and closeData() must only be called while no other thread is
+ * using the library. In between, every other member function may be called from any number
+ * of threads at once:
+ * - The container data and the filename index are not modified while the containers are
+ *   open, so index lookups, file listings, and reads of uncompressed files take no locks.
+ * - Decompressed files are cached in DAT_CACHE_SHARD_COUNT separately locked shards (chosen
+ *   by container and index number), so threads reading different files rarely wait on one
+ *   another. A lock is only held to look up or insert an entry, never while decompressing.
+ * - If a disk cache directory has been set, the larger compressed entries are also kept
+ *   there (keyed by a hash of their compressed data), so that they're only decompressed
+ *   once across sessions. setDiskCacheDirectory() is subject to the same rule as openData().
+ * - GAMETEXT.TXT is loaded once, by whichever thread asks for a string first.
+ * Views and copies returned by the read paths may be kept and used by the thread that got
+ * them; views are only valid until closeData() is called.
+ */
 class DatLibrary
 {
 public:
   DatLibrary();
   virtual ~DatLibrary();
-  bool openData(QString pathToGameDir);
+  bool openData(QString pathToGameDir, bool useMemoryMap = true);
   void closeData();
 
   static const QMap<DatFileType,QString> s_datFileNames;
 
   bool getFileByName(DatFileType dat, QString filename, QByteArray& filedata) const;
-  QString getGameText(int offset);
-  QStringList getFilenamesByExtension(DatFileType dat, QString extension);
+  bool getFileByKey(DatFileType dat, const DatFileKey& key, QByteArray& filedata) const;
+  bool getFileViewByName(DatFileType dat, QString filename, QByteArray& view) const;
+  bool getFileViewByKey(DatFileType dat, const DatFileKey& key, QByteArray& view) const;
+  QString getGameText(int offset) const;
+  QStringList getFilenamesByExtension(DatFileType dat, QString extension) const;
+  QByteArray getDataSignature() const;
+
+  int getFileCount(DatFileType dat) const;
+  QString getFilenameAtIndex(DatFileType dat, int index) const;
+  bool decodeFileAtIndex(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const;
+
+  void setCacheBudget(int bytes);
+  int getCacheBudget() const;
+  void clearCache();
+  quint64 getCacheHits() const;
+  quint64 getCacheMisses() const;
+  void setDiskCacheDirectory(const QString& dir, qint64 maxBytes = ASSET_CACHE_DEFAULT_BUDGET_BYTES);
+  QString getDiskCacheDirectory() const;
+
+  static uint32_t hashFilename(const char* filename, int maxlen);
 
 private:
+  //! Slot in the open-addressed filename hash table built for each container
+  struct DatIndexSlot
+  {
+    uint32_t hash;
+    int index;
+  };
+
+  QFile m_datFiles[DatFileType_NUM_DAT_FILES];
+  uchar* m_mappedData[DatFileType_NUM_DAT_FILES];
   QByteArray m_datContents[DatFileType_NUM_DAT_FILES];
-  QByteArray m_gameText; // keep a copy of GAMETEXT.TXT since it is referenced frequently
+  QVector<DatIndexSlot> m_nameIndex[DatFileType_NUM_DAT_FILES];
+  // keep a copy of GAMETEXT.TXT since it is referenced frequently, along with each of its
+  // strings (keyed by offset); these are loaded by the first thread that needs them (under
+  // m_gameTextMutex), and only read once m_gameTextLoaded is set
+  mutable QByteArray m_gameText;
+  mutable QHash<int,QString> m_gameTextStrings;
+  mutable QMutex m_gameTextMutex;
+  mutable QAtomicInt m_gameTextLoaded;
+
+  //! One part of the LRU cache of decompressed entries, along with its hit/miss counters
+  struct CacheShard
+  {
+    QMutex mutex;   //!< Guards the other members, since even a lookup reorders the LRU list
+    QCache<quint32,QByteArray> cache;
+    quint64 hits;
+    quint64 misses;
+  };
+
+  // cache of decompressed entries, keyed by container and index number, with the cost
+  // of each entry being its size in bytes
+  mutable CacheShard m_cacheShards[DAT_CACHE_SHARD_COUNT];
+
+  // decompressed entries that persist between sessions
+  AssetCache m_diskCache;
+
+  void buildNameIndex(DatFileType dat);
+  CacheShard& cacheShard(quint32 cacheKey) const;
+  void internGameText() const;
+  int findIndex(DatFileType dat, const DatFileKey& key) const;
 
-  bool lzDecompress(QByteArray compressedfile, QByteArray& decompressedFile, int skipUncompressedBytes) const;
+  static int lzDecompress(const uint8_t* input, int inputLen, uint8_t* output, int outputLen, int skipUncompressedBytes);
+  const char* getStoredFile(DatFileType dat, unsigned int index, DatFileIndex& indexEntry, int& skipUncompressedBytes) const;
   bool getFileAtIndex(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const;
+  bool decodeFileWithDiskCache(DatFileType dat, unsigned int index, QByteArray& decompressedFile) const;
+  bool getFileViewAtIndex(DatFileType dat, unsigned int index, QByteArray& view) const;
 };
 
 #endif // DATLIBRARY_H
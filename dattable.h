@@ -4,20 +4,92 @@
 #include <QByteArray>
 #include <QMap>
 #include <QString>
+#include <QFuture>
+#include <QMutex>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
 #include "datlibrary.h"
 
+/**
+ * Non-template base of the data table classes, which allows a set of tables of different
+ * types to be populated in the background (see TableLoader). Each table is populated once,
+ * by whichever comes first: the background load, or a call to one of its getters (which
+ * otherwise waits for the background load to finish.) A table whose data turned out to be
+ * empty is not populated again until it is cleared, so the getters may be called from any
+ * number of threads at once.
+ */
+class DatTableBase
+{
+public:
+  /**
+   * Starts populating the table on a thread from the provided pool.
+   */
+  QFuture<bool> startLoad(QThreadPool* pool)
+  {
+    return QtConcurrent::run(pool, this, &DatTableBase::load);
+  }
+
+protected:
+  DatTableBase() :
+    m_loaded(false),
+    m_loadStatus(false)
+  {
+  }
+
+  virtual ~DatTableBase()
+  {
+  }
+
+  /**
+   * Populates the table unless that has already been done since it was last cleared. If
+   * another thread is populating it, this waits for that to finish instead.
+   * @return True if the table was populated successfully; false otherwise.
+   */
+  bool load()
+  {
+    QMutexLocker lock(&m_loadMutex);
+
+    if (!m_loaded)
+    {
+      m_loadStatus = populateList();
+      m_loaded = true;
+    }
+
+    return m_loadStatus;
+  }
+
+  /**
+   * Marks the table as needing to be populated again. This must only be called when the
+   * table is being cleared, while no other thread is using it.
+   */
+  void resetLoad()
+  {
+    QMutexLocker lock(&m_loadMutex);
+    m_loaded = false;
+    m_loadStatus = false;
+  }
+
+  virtual bool populateList() = 0;
+
+private:
+  QMutex m_loadMutex;
+  bool m_loaded;
+  bool m_loadStatus;
+};
+
 /**
  * Template for classes that handle the game's data table files. The base functionality
  * in this template provides the ability to sequence through the entries in such a
  * data table.
  */
 template <typename StructType>
-class DatTable
+class DatTable : public DatTableBase
 {
 public:
   void clear()
   {
     m_rawdata.clear();
+    resetLoad();
   }
 
 protected:
@@ -32,21 +104,26 @@ protected:
   {
   }
 
-  StructType* getEntry(int index)
+  const StructType* getEntry(int index) const
   {
-    StructType* ptr = nullptr;
+    const StructType* ptr = nullptr;
 
     if (((index * s_entrySize) + s_entrySize) <= m_rawdata.size())
     {
-      ptr = reinterpret_cast<StructType*>(&m_rawdata.data()[index * s_entrySize]);
+      ptr = reinterpret_cast<const StructType*>(m_rawdata.constData() + (index * s_entrySize));
     }
 
     return ptr;
   }
 
+  /**
+   * Loads the table from the named file. Tables stored without compression are read in place
+   * (see DatLibrary::getFileViewByName()), so the table is only valid while the DAT
+   * containers remain open.
+   */
   bool openFile(DatFileType dat, QString filename)
   {
-    return m_lib->getFileByName(dat, filename, m_rawdata);
+    return m_lib->getFileViewByName(dat, filename, m_rawdata);
   }
 
   QString getGameText(int offset) const
@@ -59,8 +136,6 @@ protected:
     return (!m_rawdata.isEmpty());
   }
 
-  virtual bool populateList() = 0;
-
 private:
   QByteArray m_rawdata;
   static const int s_entrySize = sizeof(StructType);
@@ -0,0 +1,499 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QtConcurrent/QtConcurrentMap>
+#include "dialoguexref.h"
+
+DialogueXref::DialogueXref(DatLibrary& lib, ConversationText& convText) :
+  m_lib(&lib),
+  m_convText(&convText)
+{
+}
+
+/**
+ * Discards the cross-reference, which must be done whenever the game data is closed.
+ */
+void DialogueXref::clear()
+{
+  m_lines.clear();
+  m_refs.clear();
+}
+
+/**
+ * Returns true if the cross-reference hasn't been built or loaded.
+ */
+bool DialogueXref::isEmpty() const
+{
+  return m_lines.isEmpty();
+}
+
+/**
+ * Reads the conversation tables of every alien and race and builds the cross-reference from
+ * them. The tables are read in parallel, and their results are then merged in a fixed order
+ * so that the line indices are the same every time.
+ * @return True if at least one conversation table could be read; false otherwise.
+ */
+bool DialogueXref::build()
+{
+  clear();
+
+  const QList<SpeakerXref> speakerXrefs =
+    QtConcurrent::blockingMapped<QList<SpeakerXref> >(getSpeakerTables(), &DialogueXref::readSpeakerTable);
+
+  foreach (const SpeakerXref& speakerXref, speakerXrefs)
+  {
+    const int firstLineIndex = m_lines.size();
+    m_lines += speakerXref.lines;
+
+    for (int refIdx = 0; refIdx < speakerXref.refs.size(); refIdx++)
+    {
+      DialogueRef ref = speakerXref.refs[refIdx].second;
+      ref.lineIndex += firstLineIndex;
+      m_refs[speakerXref.refs[refIdx].first].append(ref);
+    }
+  }
+
+  m_lines.squeeze();
+
+  return !m_lines.isEmpty();
+}
+
+/**
+ * Gets the list of conversation tables in the CONVERSE container, from the names of the
+ * TLKT files (of the form TLKTCnnn.TAB for individual aliens and TLKTRnnn.TAB for races.)
+ */
+QList<DialogueXref::SpeakerTable> DialogueXref::getSpeakerTables() const
+{
+  QList<SpeakerTable> tables;
+  const QStringList filenames = m_lib->getFilenamesByExtension(DatFileType_CONVERSE, ".TAB");
+
+  foreach (const QString& filename, filenames)
+  {
+    const QString upperName = filename.toUpper();
+    bool idValid = false;
+    const int id = upperName.mid(5, 3).toInt(&idValid);
+
+    if (idValid && (upperName.startsWith("TLKTC") || upperName.startsWith("TLKTR")))
+    {
+      SpeakerTable table;
+      table.convText = m_convText;
+      table.tableType = upperName.startsWith("TLKTC") ? ConvTableType_Individual : ConvTableType_Race;
+      table.id = id;
+      tables.append(table);
+    }
+  }
+
+  return tables;
+}
+
+/**
+ * Reads every line of dialogue in a single conversation table, and finds the references that
+ * each line makes through its topics and its embedded commands. This runs on a thread from
+ * the global pool, so the line indices in the results are relative to this table alone.
+ */
+DialogueXref::SpeakerXref DialogueXref::readSpeakerTable(const SpeakerTable& table)
+{
+  SpeakerXref speakerXref;
+  QVector<ConvTopicLine> topicLines;
+
+  if (table.convText->getAllTopicLines(table.tableType, table.id, topicLines))
+  {
+    // a line is usually selected by several TLKT records, so each line is only stored once
+    QHash<int,int> lineIndexByTlkx;
+
+    foreach (const ConvTopicLine& topicLine, topicLines)
+    {
+      if (topicLine.tlkxIndex >= 0)
+      {
+        DialogueRef ref;
+        ref.priority = topicLine.priority;
+        ref.command = 0;
+
+        const bool newLine = !lineIndexByTlkx.contains(topicLine.tlkxIndex);
+        if (newLine)
+        {
+          DialogueLine line;
+          line.tableType = table.tableType;
+          line.speakerId = table.id;
+          line.text = topicLine.text;
+          line.plainText = topicLine.plainText;
+          line.commands = topicLine.commands;
+
+          lineIndexByTlkx.insert(topicLine.tlkxIndex, speakerXref.lines.size());
+          speakerXref.lines.append(line);
+        }
+        ref.lineIndex = lineIndexByTlkx.value(topicLine.tlkxIndex);
+
+        for (int topicIdx = 0; topicIdx < topicLine.topics.size(); topicIdx++)
+        {
+          DialogueThingType type;
+          ref.topic = topicLine.topics[topicIdx].first;
+          ref.topicId = topicLine.topics[topicIdx].second;
+
+          // an "ask about" record fills in only the ID fields that it uses, and leaves the others at 0
+          if (getThingForTopic(ref.topic, type) && ((ref.topicId > 0) || (type == DialogueThingType_Race)))
+          {
+            addRef(speakerXref.refs, type, ref.topicId, ref);
+          }
+        }
+
+        // the commands embedded in a line only have to be indexed once, under the first topic that selects it
+        if (newLine && !topicLine.topics.isEmpty())
+        {
+          ref.topic = topicLine.topics.first().first;
+          ref.topicId = topicLine.topics.first().second;
+
+          QPair<GTxtCmd,int> cmdPair;
+          foreach (cmdPair, topicLine.commands)
+          {
+            DialogueThingType type;
+            int thingId = 0;
+            if (getThingForCommand(cmdPair.first, cmdPair.second, type, thingId))
+            {
+              ref.command = cmdPair.first;
+              addRef(speakerXref.refs, type, thingId, ref);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  return speakerXref;
+}
+
+/**
+ * Adds a reference to the provided list, keyed by the entity that it refers to.
+ */
+void DialogueXref::addRef(QVector<QPair<quint32,DialogueRef> >& refs, DialogueThingType type, int thingId,
+                          const DialogueRef& ref)
+{
+  refs.append(QPair<quint32,DialogueRef>(thingKey(type, thingId), ref));
+}
+
+/**
+ * Gets the kind of entity that the conversation topics in a category are about.
+ * @return True if the category is about an entity; false for the greeting categories.
+ */
+bool DialogueXref::getThingForTopic(ConvTopicCategory topic, DialogueThingType& type)
+{
+  bool status = true;
+
+  switch (topic)
+  {
+  case ConvTopicCategory_AskAboutPerson:
+    type = DialogueThingType_Alien;
+    break;
+  case ConvTopicCategory_AskAboutLocation:
+    type = DialogueThingType_Place;
+    break;
+  case ConvTopicCategory_AskAboutRace:
+    type = DialogueThingType_Race;
+    break;
+  case ConvTopicCategory_AskAboutObject:
+  case ConvTopicCategory_DisplayObject:
+  case ConvTopicCategory_GiveObject:
+  case ConvTopicCategory_SeesObject:
+    type = DialogueThingType_Object;
+    break;
+  case ConvTopicCategory_GiveFact:
+    type = DialogueThingType_Fact;
+    break;
+  default:
+    status = false;
+    break;
+  }
+
+  return status;
+}
+
+/**
+ * Gets the entity that an embedded game text command affects, given the command's parameter.
+ * @return True if the command affects an entity; false otherwise.
+ */
+bool DialogueXref::getThingForCommand(GTxtCmd command, int param, DialogueThingType& type, int& thingId)
+{
+  bool status = true;
+  thingId = param;
+
+  switch (command)
+  {
+  case GTxtCmd_AddItem:
+  case GTxtCmd_GrantKnowledgeObject:
+    type = DialogueThingType_Object;
+    break;
+  case GTxtCmd_GrantKnowledgeAlien:
+    type = DialogueThingType_Alien;
+    break;
+  case GTxtCmd_GrantKnowledgeRace:
+    type = DialogueThingType_Race;
+    break;
+  case GTxtCmd_ModifyEncountRelate:
+    // the race is the first of the two parameter bytes
+    type = DialogueThingType_Race;
+    thingId = param & 0xFF;
+    break;
+  case GTxtCmd_GrantKnowledgePlace:
+  case GTxtCmd_StorePlaceIDInSetupTable:
+    type = DialogueThingType_Place;
+    break;
+  case GTxtCmd_GrantKnowledgeFact:
+    type = DialogueThingType_Fact;
+    break;
+  case GTxtCmd_StoreShipIDInSetupTab:
+    type = DialogueThingType_Ship;
+    break;
+  default:
+    status = false;
+    break;
+  }
+
+  return status;
+}
+
+quint32 DialogueXref::thingKey(DialogueThingType type, int thingId)
+{
+  return (static_cast<quint32>(type) << 16) | (static_cast<quint32>(thingId) & 0xFFFF);
+}
+
+/**
+ * Gets every reference to the specified entity, in the order in which the
+ * conversation tables list them.
+ */
+QVector<DialogueRef> DialogueXref::getReferences(DialogueThingType type, int thingId) const
+{
+  return m_refs.value(thingKey(type, thingId));
+}
+
+/**
+ * Gets the references to the specified entity from lines that are spoken when
+ * the entity is the topic of conversation.
+ */
+QVector<DialogueRef> DialogueXref::getTopicReferences(DialogueThingType type, int thingId) const
+{
+  QVector<DialogueRef> topicRefs;
+
+  foreach (const DialogueRef& ref, m_refs.value(thingKey(type, thingId)))
+  {
+    if (ref.command == 0)
+    {
+      topicRefs.append(ref);
+    }
+  }
+
+  return topicRefs;
+}
+
+/**
+ * Gets the references to the specified entity from lines that have the provided
+ * command embedded in them (for example, the lines that grant knowledge of a fact.)
+ */
+QVector<DialogueRef> DialogueXref::getCommandReferences(DialogueThingType type, int thingId, GTxtCmd command) const
+{
+  QVector<DialogueRef> commandRefs;
+
+  foreach (const DialogueRef& ref, m_refs.value(thingKey(type, thingId)))
+  {
+    if (ref.command == command)
+    {
+      commandRefs.append(ref);
+    }
+  }
+
+  return commandRefs;
+}
+
+/**
+ * Gets the line of dialogue with the provided index, which must be taken from a DialogueRef.
+ */
+const DialogueLine& DialogueXref::getLine(int lineIndex) const
+{
+  return m_lines.at(lineIndex);
+}
+
+/**
+ * Returns the number of distinct lines of dialogue in the cross-reference.
+ */
+int DialogueXref::getLineCount() const
+{
+  return m_lines.size();
+}
+
+/**
+ * Loads the cross-reference from the specified file if it was saved from the same game data
+ * that is open now, and otherwise builds it and saves it to that file for next time.
+ * @return True if the cross-reference was loaded or built; false otherwise.
+ */
+bool DialogueXref::loadOrBuild(const QString& cacheFilename)
+{
+  bool status = load(cacheFilename);
+
+  if (!status)
+  {
+    status = build();
+
+    // failing to save only means that the cross-reference will be built again next time
+    if (status && QDir().mkpath(QFileInfo(cacheFilename).absolutePath()))
+    {
+      save(cacheFilename);
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Saves the cross-reference to the specified file, along with the signature of the game data
+ * that it was built from.
+ * @return True if the file was written; false otherwise.
+ */
+bool DialogueXref::save(const QString& filename) const
+{
+  bool status = false;
+  QFile outFile(filename);
+
+  if (outFile.open(QIODevice::WriteOnly))
+  {
+    QDataStream ds(&outFile);
+    ds.setVersion(QDataStream::Qt_5_12);
+
+    ds << quint32(DIALOGUE_XREF_MAGIC) << quint32(DIALOGUE_XREF_VERSION);
+    ds << m_lib->getDataSignature();
+
+    ds << qint32(m_lines.size());
+    foreach (const DialogueLine& line, m_lines)
+    {
+      ds << qint32(line.tableType) << qint32(line.speakerId) << line.text << line.plainText;
+      ds << qint32(line.commands.size());
+      for (int cmdIdx = 0; cmdIdx < line.commands.size(); cmdIdx++)
+      {
+        ds << qint32(line.commands[cmdIdx].first) << qint32(line.commands[cmdIdx].second);
+      }
+    }
+
+    ds << qint32(m_refs.size());
+    foreach (quint32 key, m_refs.keys())
+    {
+      const QVector<DialogueRef>& refs = m_refs[key];
+      ds << key << qint32(refs.size());
+
+      foreach (const DialogueRef& ref, refs)
+      {
+        ds << qint32(ref.lineIndex) << qint32(ref.topic) << qint32(ref.topicId)
+           << qint32(ref.priority) << qint32(ref.command);
+      }
+    }
+
+    status = (ds.status() == QDataStream::Ok);
+    outFile.close();
+  }
+
+  return status;
+}
+
+/**
+ * Loads a cross-reference that was previously saved to the specified file. The file is
+ * rejected if it has a different format version, or if it was built from game data with
+ * a different signature than the data that is open now.
+ * @return True if the cross-reference was loaded; false otherwise.
+ */
+bool DialogueXref::load(const QString& filename)
+{
+  bool status = false;
+  QFile inFile(filename);
+
+  clear();
+
+  if (inFile.open(QIODevice::ReadOnly))
+  {
+    QDataStream ds(&inFile);
+    ds.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray signature;
+    ds >> magic >> version >> signature;
+
+    status = (magic == DIALOGUE_XREF_MAGIC) && (version == DIALOGUE_XREF_VERSION) &&
+             (signature == m_lib->getDataSignature());
+
+    qint32 lineCount = 0;
+    if (status)
+    {
+      ds >> lineCount;
+      status = (lineCount > 0);
+    }
+
+    for (int lineIdx = 0; status && (lineIdx < lineCount); lineIdx++)
+    {
+      DialogueLine line;
+      qint32 tableType = 0;
+      qint32 speakerId = 0;
+      qint32 commandCount = 0;
+      ds >> tableType >> speakerId >> line.text >> line.plainText >> commandCount;
+
+      line.tableType = static_cast<ConvTableType>(tableType);
+      line.speakerId = speakerId;
+
+      for (int cmdIdx = 0; (ds.status() == QDataStream::Ok) && (cmdIdx < commandCount); cmdIdx++)
+      {
+        qint32 command = 0;
+        qint32 param = 0;
+        ds >> command >> param;
+        line.commands.append(QPair<GTxtCmd,int>(static_cast<GTxtCmd>(command), param));
+      }
+
+      m_lines.append(line);
+      status = (ds.status() == QDataStream::Ok);
+    }
+
+    qint32 keyCount = 0;
+    if (status)
+    {
+      ds >> keyCount;
+    }
+
+    for (int keyIdx = 0; status && (keyIdx < keyCount); keyIdx++)
+    {
+      quint32 key = 0;
+      qint32 refCount = 0;
+      ds >> key >> refCount;
+
+      QVector<DialogueRef>& refs = m_refs[key];
+      for (int refIdx = 0; (ds.status() == QDataStream::Ok) && (refIdx < refCount); refIdx++)
+      {
+        DialogueRef ref;
+        qint32 lineIndex = 0;
+        qint32 topic = 0;
+        qint32 topicId = 0;
+        qint32 priority = 0;
+        qint32 command = 0;
+        ds >> lineIndex >> topic >> topicId >> priority >> command;
+
+        ref.lineIndex = lineIndex;
+        ref.topic = static_cast<ConvTopicCategory>(topic);
+        ref.topicId = topicId;
+        ref.priority = priority;
+        ref.command = command;
+
+        // a reference to a line that isn't in the file means that the file is damaged
+        if ((lineIndex < 0) || (lineIndex >= m_lines.size()))
+        {
+          ds.setStatus(QDataStream::ReadCorruptData);
+        }
+        refs.append(ref);
+      }
+
+      status = (ds.status() == QDataStream::Ok);
+    }
+
+    inFile.close();
+  }
+
+  if (!status)
+  {
+    clear();
+  }
+
+  return status;
+}
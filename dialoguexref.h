@@ -0,0 +1,117 @@
+#ifndef DIALOGUEXREF_H
+#define DIALOGUEXREF_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+#include <QDataStream>
+#include "datlibrary.h"
+#include "conversationtext.h"
+#include "gametext.h"
+
+//! Identifies a dialogue cross-reference file ("NXRF")
+#define DIALOGUE_XREF_MAGIC 0x4652584E
+
+//! Version of the dialogue cross-reference file format; bump this whenever the format changes
+#define DIALOGUE_XREF_VERSION 3
+
+//! Kinds of game entities that a line of dialogue can refer to
+enum DialogueThingType
+{
+  DialogueThingType_Alien,
+  DialogueThingType_Race,
+  DialogueThingType_Place,
+  DialogueThingType_Object,
+  DialogueThingType_Fact,
+  DialogueThingType_Ship
+};
+
+/**
+ * A line of dialogue, and the alien (or race) that speaks it
+ */
+struct DialogueLine
+{
+  ConvTableType tableType;
+  int speakerId;
+  QString text;
+  QString plainText;
+  QVector<QPair<GTxtCmd,int> > commands;
+};
+
+/**
+ * A reference to a game entity from a line of dialogue: either the line is spoken in response
+ * to a topic about the entity, or the line has an embedded command that affects the entity.
+ */
+struct DialogueRef
+{
+  int lineIndex;
+  ConvTopicCategory topic;
+  int topicId;
+  int priority;
+  //! The embedded command that refers to the entity, or 0 if the entity is the topic of the line
+  int command;
+};
+
+/**
+ * Cross-reference from every alien, race, place, object, fact, and ship to the lines of dialogue
+ * that refer to it, across the conversation tables of every individual alien and every race.
+ * Building it requires reading all of the conversation files, so it is done in parallel and
+ * the result can be saved to disk and loaded again in later sessions.
+ *
+ * Thread safety: build() and load() may run on a worker thread, as long as nothing queries the
+ * cross-reference until they have finished. The queries are const and may then be made from
+ * any thread.
+ */
+class DialogueXref
+{
+public:
+  DialogueXref(DatLibrary& lib, ConversationText& convText);
+
+  void clear();
+  bool isEmpty() const;
+  bool build();
+  bool load(const QString& filename);
+  bool save(const QString& filename) const;
+  bool loadOrBuild(const QString& cacheFilename);
+
+  QVector<DialogueRef> getReferences(DialogueThingType type, int thingId) const;
+  QVector<DialogueRef> getTopicReferences(DialogueThingType type, int thingId) const;
+  QVector<DialogueRef> getCommandReferences(DialogueThingType type, int thingId, GTxtCmd command) const;
+  const DialogueLine& getLine(int lineIndex) const;
+  int getLineCount() const;
+
+  static bool getThingForTopic(ConvTopicCategory topic, DialogueThingType& type);
+  static bool getThingForCommand(GTxtCmd command, int param, DialogueThingType& type, int& thingId);
+
+private:
+  //! The conversation table of a single alien or race
+  struct SpeakerTable
+  {
+    ConversationText* convText;
+    ConvTableType tableType;
+    int id;
+  };
+
+  //! The lines and references found in a single conversation table
+  struct SpeakerXref
+  {
+    QVector<DialogueLine> lines;
+    QVector<QPair<quint32,DialogueRef> > refs;
+  };
+
+  DatLibrary* m_lib;
+  ConversationText* m_convText;
+
+  QVector<DialogueLine> m_lines;
+  QHash<quint32,QVector<DialogueRef> > m_refs;
+
+  static quint32 thingKey(DialogueThingType type, int thingId);
+  static SpeakerXref readSpeakerTable(const SpeakerTable& table);
+  static void addRef(QVector<QPair<quint32,DialogueRef> >& refs, DialogueThingType type, int thingId,
+                     const DialogueRef& ref);
+  QList<SpeakerTable> getSpeakerTables() const;
+};
+
+#endif // DIALOGUEXREF_H
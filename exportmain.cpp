@@ -0,0 +1,65 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <stdio.h>
+#include "batchexporter.h"
+
+/**
+ * Entry point for the headless batch exporter, which converts all of the images, animations,
+ * sounds, and 3D models in the game data to PNG, GIF, WAV, and OBJ files. Only a QCoreApplication
+ * is created, so no display is required.
+ */
+int main(int argc, char *argv[])
+{
+  QCoreApplication a(argc, argv);
+  a.setApplicationVersion(QString("%1.%2.%3")
+                          .arg(NRE_VER_MAJOR)
+                          .arg(NRE_VER_MINOR)
+                          .arg(NRE_VER_PATCH));
+  a.setApplicationName("nre-export");
+
+  QCommandLineParser parser;
+  QCommandLineOption jobsOption(QStringList() << "j" << "jobs", "Number of worker threads (default: one per core).", "count", "0");
+  parser.setApplicationDescription("Converts the resource files from the 1993 DOS game 'Nomad' to PNG, GIF, WAV, and OBJ files");
+  parser.addHelpOption();
+  parser.addVersionOption();
+  parser.addOption(jobsOption);
+  parser.addPositionalArgument("gamedir", "Directory containing game data files");
+  parser.addPositionalArgument("outputdir", "Directory to which the converted files will be written");
+
+  parser.process(a);
+  const QStringList args = parser.positionalArguments();
+  int status = 0;
+
+  if (args.size() < 2)
+  {
+    parser.showHelp(1);
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  BatchExporter exporter(args[0], args[1]);
+  exporter.setThreadCount(parser.value(jobsOption).toInt());
+
+  if (!exporter.exportAll())
+  {
+    if (exporter.getJobsFailed() == 0)
+    {
+      fprintf(stderr, "Error: could not open the game data files in '%s'.\n", qPrintable(args[0]));
+    }
+
+    foreach (QString filename, exporter.getFailedFiles())
+    {
+      fprintf(stderr, "Error: failed to convert '%s'.\n", qPrintable(filename));
+    }
+    status = 1;
+  }
+
+  printf("Wrote %d files to '%s' in %lld ms; %d source files failed.\n",
+         exporter.getFilesWritten(), qPrintable(args[1]), timer.elapsed(), exporter.getJobsFailed());
+
+  return status;
+}
@@ -16,6 +16,7 @@ Facts::~Facts()
  */
 void Facts::clear()
 {
+  DatTable<FactTableEntry>::clear();
   m_factList.clear();
 }
 
@@ -25,10 +26,7 @@ void Facts::clear()
  */
 QMap<int,Fact> Facts::getList()
 {
-  if (m_factList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   return m_factList;
 }
@@ -42,7 +40,7 @@ Fact Facts::getFact(int id) const
 {
   if (m_factList.contains(id))
   {
-    return m_factList[id];
+    return m_factList.value(id);
   }
 
   Fact f;
@@ -63,7 +61,7 @@ QMap<AlienRace,int> Facts::getReceptivity(int id)
 
   if (m_factList.contains(id))
   {
-    recep = m_factList[id].receptivity;
+    recep = m_factList.value(id).receptivity;
   }
 
   return recep;
@@ -81,7 +79,7 @@ bool Facts::populateList()
   {
     status = true;
     int index = 0;
-    FactTableEntry* currentEntry = getEntry(index);
+    const FactTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -1,10 +1,121 @@
 #include "gametext.h"
 #include <QString>
 #include <QUrl>
+#include <QMutexLocker>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 #define EMBEDDED_CMD_REFERENCE_STR "<font color=\"#da412a\">[%1]</font>"
 #define LINK_STYLE "style=\"color:#eaa92a;\""
 
+//! Number of byte values (0x00 - 0x1F) that are interpreted as embedded commands
+#define GAMETEXT_CMD_BYTE_COUNT 0x20
+
+/**
+ * HTML entity for each 7-bit character that must be escaped (the same ones that are escaped by
+ * QString::toHtmlEscaped()), or nullptr if the character is copied to the output unchanged.
+ */
+static constexpr const char* s_htmlEscape[0x80] =
+{
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, "&quot;", nullptr, nullptr, nullptr, "&amp;", nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, "&lt;", nullptr, "&gt;", nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
+  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr
+};
+
+//! How readString() handles each embedded command byte
+enum GTxtCmdAction
+{
+  GTxtCmdAction_Invalid,
+  GTxtCmdAction_Substitute,
+  GTxtCmdAction_MetaText,
+  GTxtCmdAction_Capture
+};
+
+//! The handling of a single embedded command byte
+struct GTxtCmdInfo
+{
+  GTxtCmdAction action;
+  //! Number of parameter bytes that follow the command byte (see g_gameTextParamCount)
+  int paramCount;
+  //! Text inserted in place of the command, for GTxtCmdAction_Substitute and _Invalid
+  const char* substitution;
+  //! The same text, already HTML-escaped
+  const char* htmlSubstitution;
+};
+
+/**
+ * Flat table of the embedded commands, indexed by command byte. Unused command bytes cause the
+ * game's text engine to insert the string "<HUH?>", and have no parameters.
+ */
+static constexpr GTxtCmdInfo s_gameTextCmdInfo[GAMETEXT_CMD_BYTE_COUNT] =
+{
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },             // 0x00 (terminates the string)
+  { GTxtCmdAction_Substitute, 0, "<Player's name>",    "&lt;Player's name&gt;" },    // GTxtCmd_InsertPlayerName
+  { GTxtCmdAction_Substitute, 0, "<Player's ship>",    "&lt;Player's ship&gt;" },    // GTxtCmd_InsertPlayerShip
+  { GTxtCmdAction_Substitute, 0, "<current location>", "&lt;current location&gt;" }, // GTxtCmd_InsertCurrentLocation
+  { GTxtCmdAction_Substitute, 0, "<GAMESTR>",          "&lt;GAMESTR&gt;" },          // GTxtCmd_GAMESTR
+  { GTxtCmdAction_MetaText,   2, nullptr,              nullptr },                     // GTxtCmd_MetaText
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_AddItem
+  { GTxtCmdAction_Substitute, 0, "<METAMOVE>",         "&lt;METAMOVE&gt;" },         // GTxtCmd_METAMOVE
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_ChangeAlienTemperament
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_GrantKnowledgeFact
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_GrantKnowledgePlace
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_GrantKnowledgeAlien
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_GrantKnowledgeObject
+  { GTxtCmdAction_Capture,    0, nullptr,              nullptr },                     // GTxtCmd_AStateTableModifyB
+  { GTxtCmdAction_Capture,    0, nullptr,              nullptr },                     // GTxtCmd_CopyEncountRelateTable
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_GrantKnowledgeRace
+  { GTxtCmdAction_Capture,    2, nullptr,              nullptr },                     // GTxtCmd_ModifyEncountRelate
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_StoreShipIDInSetupTab
+  { GTxtCmdAction_Capture,    2, nullptr,              nullptr },                     // GTxtCmd_StorePlaceIDInSetupTable
+  { GTxtCmdAction_Capture,    0, nullptr,              nullptr },                     // GTxtCmd_EndConversation
+  { GTxtCmdAction_Capture,    0, nullptr,              nullptr },                     // GTxtCmd_SetAlienAttrMax
+  { GTxtCmdAction_Capture,    0, nullptr,              nullptr },                     // GTxtCmd_SetAlienAttrMin
+  { GTxtCmdAction_Capture,    1, nullptr,              nullptr },                     // GTxtCmd_ModifyMissionTable
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" },
+  { GTxtCmdAction_Invalid,    0, "<HUH?>",             "&lt;HUH?&gt;" }
+};
+
+//! Handling of the bytes 0x80 - 0xFF, which the game doesn't print and doesn't recognize as commands
+static constexpr GTxtCmdInfo s_gameTextInvalidCmdInfo = { GTxtCmdAction_Invalid, 0, "<HUH?>", "&lt;HUH?&gt;" };
+
+/**
+ * Gets the handling of the provided byte when it isn't a printable character.
+ */
+static const GTxtCmdInfo& getCmdInfo(uint8_t byte)
+{
+  return (byte < GAMETEXT_CMD_BYTE_COUNT) ? s_gameTextCmdInfo[byte] : s_gameTextInvalidCmdInfo;
+}
+
+/**
+ * Returns true if the provided byte is a printable character (rather than a command byte.)
+ */
+static inline bool isPrintable(char byte)
+{
+  return (static_cast<uint8_t>(byte) >= GAMETEXT_CMD_BYTE_COUNT) && (static_cast<uint8_t>(byte) < 0x80);
+}
+
 /**
  * Processes the mission and conversation text in the game by removing the special
  * nonprintable command bytes and inserting the proper substitution text.
@@ -16,180 +127,408 @@ GameText::GameText(DatLibrary& lib) :
 }
 
 /**
- * Returns a string that may be substituted for a metatext command. The metatext commands
- * are one of three types:
+ * Discards the metatext table, which must be done whenever the game data is closed
+ * (and only while no other thread is reading game text.)
+ */
+void GameText::clear()
+{
+  QMutexLocker lock(&m_metaTabMutex);
+  m_metaEntries.clear();
+  m_metaEntriesLoaded.storeRelease(0);
+}
+
+/**
+ * Reads META.TAB and METATXT.TAB and expands every metatext entry, so that each later
+ * metatext substitution is only a lookup. The metatext commands are one of three types:
  * - Conversational synonym. Used to add variety to the alien dialog.
  * - Translated phrases. Used to (partially) translate the Shaasa alien language.
  * - Losten gateway code. Used to create (or recall) one of the randomly generated codes
  *   for the Losten planetary gateway.
+ * For the first two types, the options are the alternative strings. The text that replaces
+ * the command is rendered up front: a link showing the first option (with all of the options
+ * in its URL), or the number of a Losten gateway code.
+ *
+ * This is done by the first caller (from any thread) and the table never changes after that.
  */
-QString GameText::getMetaString(int metaTabIndex)
+void GameText::loadMetaEntries()
 {
-  QString metaStr;
-  bool status = true;
-
-  if (m_metaTab.isEmpty())
-  {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, "META.TAB", m_metaTab);
-  }
-
-  if (status && m_metaTextTab.isEmpty())
-  {
-    status = m_lib->getFileByName(DatFileType_CONVERSE, "METATXT.TAB", m_metaTextTab);
-  }
+  QMutexLocker lock(&m_metaTabMutex);
 
-  if (status)
+  if (!m_metaEntriesLoaded.loadAcquire())
   {
-    const uint8_t* metaData = reinterpret_cast<const uint8_t*>(m_metaTab.data());
-    const int metaTabOffset   = metaTabIndex * METATAB_RECORDSIZE_BYTES;
-    const int numberOfOptions = metaData[metaTabOffset + 0];
-    const int type            = metaData[metaTabOffset + 1];
-    const int metaTextIndex   = metaData[metaTabOffset + 2] + (0x100 * metaData[metaTabOffset + 3]);
+    QByteArray metaTab;
+    QByteArray metaTextTab;
 
-    if ((type == METATAB_TYPE_SYNONYM) || (type == METATAB_TYPE_TRANSLATION))
+    if (m_lib->getFileByName(DatFileType_CONVERSE, "META.TAB", metaTab) &&
+        m_lib->getFileByName(DatFileType_CONVERSE, "METATXT.TAB", metaTextTab))
     {
-      QStringList synonyms;
-      const uint8_t* metaTextData = reinterpret_cast<const uint8_t*>(m_metaTextTab.data());
+      const uint8_t* metaData = reinterpret_cast<const uint8_t*>(metaTab.constData());
+      const uint8_t* metaTextData = reinterpret_cast<const uint8_t*>(metaTextTab.constData());
+      const int entryCount = metaTab.size() / METATAB_RECORDSIZE_BYTES;
 
-      // build a string list of all the alternatives/options for this this metatext
-      for (int optionIndex = 0; optionIndex < numberOfOptions; optionIndex++)
+      m_metaEntries.resize(entryCount);
+      for (int metaTabIndex = 0; metaTabIndex < entryCount; metaTabIndex++)
       {
-        const int metaTextOffset = (metaTextIndex + optionIndex) * METATEXT_RECORDSIZE_BYTES;
-        const int gametextOffset = metaTextData[metaTextOffset] + (0x100 * metaTextData[metaTextOffset + 1]);
-        synonyms.append(m_lib->getGameText(gametextOffset));
-      }
+        MetaEntry& entry = m_metaEntries[metaTabIndex];
+        const int metaTabOffset   = metaTabIndex * METATAB_RECORDSIZE_BYTES;
+        const int numberOfOptions = metaData[metaTabOffset + 0];
+        const int metaTextIndex   = metaData[metaTabOffset + 2] + (0x100 * metaData[metaTabOffset + 3]);
+        entry.type = metaData[metaTabOffset + 1];
+        entry.gatewayCode = metaTextIndex + 1;
 
-      if (synonyms.size() > 0)
-      {
-        // build a URL for the anchor that is just a pipe-separated list of the synonyms
-        metaStr = QString("<a %1 href=\"").arg(LINK_STYLE);
-        foreach (QString synonym, synonyms)
+        if ((entry.type == METATAB_TYPE_SYNONYM) || (entry.type == METATAB_TYPE_TRANSLATION))
+        {
+          // build a string list of all the alternatives/options for this this metatext
+          for (int optionIndex = 0; optionIndex < numberOfOptions; optionIndex++)
+          {
+            const int metaTextOffset = (metaTextIndex + optionIndex) * METATEXT_RECORDSIZE_BYTES;
+            if ((metaTextOffset + METATEXT_RECORDSIZE_BYTES) <= metaTextTab.size())
+            {
+              const int gametextOffset = metaTextData[metaTextOffset] + (0x100 * metaTextData[metaTextOffset + 1]);
+              entry.options.append(m_lib->getGameText(gametextOffset));
+            }
+          }
+
+          if (entry.options.size() > 0)
+          {
+            // build a URL for the anchor that is just a pipe-separated list of the synonyms
+            entry.html = QString("<a %1 href=\"").arg(LINK_STYLE);
+            foreach (QString synonym, entry.options)
+            {
+              entry.html += synonym + "|";
+            }
+            entry.html += "\">" + entry.options[0] + "</a>";
+            entry.plainText = entry.options[0];
+          }
+        }
+        else if (entry.type == METATAB_TYPE_LOSTENGATEWAY)
         {
-          metaStr += synonym + "|";
+          entry.plainText = QString("<Losten gateway code #%1>").arg(entry.gatewayCode);
+          entry.html = entry.plainText.toHtmlEscaped();
         }
-        metaStr += "\">" + synonyms[0] + "</a>";
       }
     }
-    else if (type == METATAB_TYPE_LOSTENGATEWAY)
-    {
-      metaStr = QString("<Losten gateway code #%1>").arg(metaTextIndex + 1).toHtmlEscaped();
-    }
+
+    m_metaEntriesLoaded.storeRelease(1);
+  }
+}
+
+/**
+ * Gets an entry in the metatext table, loading the table first if necessary.
+ * @return The entry, or nullptr if there is no entry with the provided index.
+ */
+const GameText::MetaEntry* GameText::getMetaEntry(int metaTabIndex)
+{
+  if (!m_metaEntriesLoaded.loadAcquire())
+  {
+    loadMetaEntries();
   }
 
-  return metaStr;
+  return ((metaTabIndex >= 0) && (metaTabIndex < m_metaEntries.size())) ? &m_metaEntries.at(metaTabIndex) : nullptr;
+}
+
+/**
+ * Returns the HTML that is substituted for a metatext command.
+ */
+QString GameText::getMetaString(int metaTabIndex)
+{
+  const MetaEntry* entry = getMetaEntry(metaTabIndex);
+  return entry ? entry->html : QString();
+}
+
+/**
+ * Returns the plain text that is substituted for a metatext command: the first option, or a
+ * placeholder for a Losten gateway code.
+ */
+QString GameText::getMetaPlainString(int metaTabIndex)
+{
+  const MetaEntry* entry = getMetaEntry(metaTabIndex);
+  return entry ? entry->plainText : QString();
 }
 
 /**
- * Walks through the provided ASCII character string one byte at a time, consuming the special command
- * bytes and their parameters, and producing the text that gets generated in their place (if any).
+ * Produces the HTML for a string with embedded commands (see tokenize() and renderHtml()), and
+ * populates the provided QVector with the list of game state commands embedded in it.
  */
 QString GameText::readString(const char* data, QVector<QPair<GTxtCmd,int> >& commands, bool showEmbeddedCommands, int maxlen)
 {
-  QString clean;
+  GTxtTokenList tokens;
+
+  // the tokens only refer to the string data while it is rendered here, so it isn't copied
+  tokenize(QByteArray::fromRawData(data, maxlen), 0, tokens, maxlen);
+  getCommands(tokens, commands);
+
+  return renderHtml(tokens, showEmbeddedCommands);
+}
+
+/**
+ * Walks through the ASCII character string at the provided offset in the source data in a single
+ * pass, consuming the special command bytes and their parameters, and breaking the string into
+ * tokens: runs of printable characters (which refer back to the source data rather than being
+ * copied), fixed substitutions, metatext references, and game state commands. The token list
+ * keeps a reference to the source data. Command bytes are looked up in a flat table.
+ */
+void GameText::tokenize(const QByteArray& source, int offset, GTxtTokenList& tokens, int maxlen)
+{
+  const char* const data = source.constData() + offset;
   int pos = 0;
-  commands.clear();
 
-  while ((data[pos] != 0) && (pos < maxlen))
+  tokens.source = source;
+  tokens.tokens.clear();
+
+  while ((pos < maxlen) && (data[pos] != 0))
   {
-    // all normally printable characters are passed through to the output directly
-    if (data[pos] >= 0x20)
+    GTxtToken token;
+    const uint8_t byte = static_cast<uint8_t>(data[pos]);
+
+    if (isPrintable(data[pos]))
     {
-      clean += QString(data[pos]).toHtmlEscaped();
-      pos++;
+      // all normally printable characters are passed through to the output directly
+      token.type = GTxtTokenType_Text;
+      token.value = offset + pos;
+      while ((pos < maxlen) && isPrintable(data[pos]))
+      {
+        pos++;
+      }
+      token.param = offset + pos - token.value;
     }
     else
     {
-      const GTxtCmd cmd = static_cast<GTxtCmd>(data[pos]);
+      const GTxtCmd cmd = static_cast<GTxtCmd>(byte);
+      const GTxtCmdInfo& info = getCmdInfo(byte);
       pos++;
 
-      if (cmd == GTxtCmd_InsertPlayerName)
-      {
-        clean.append(QString("<Player's name>").toHtmlEscaped());
-      }
-      else if (cmd == GTxtCmd_InsertPlayerShip)
-      {
-        clean.append(QString("<Player's ship>").toHtmlEscaped());
-      }
-      else if (cmd == GTxtCmd_GAMESTR)
-      {
-        clean.append(QString("<GAMESTR>").toHtmlEscaped());
-      }
-      else if (cmd == GTxtCmd_METAMOVE)
-      {
-        clean.append(QString("<METAMOVE>").toHtmlEscaped());
-      }
-      else if (cmd == GTxtCmd_MetaText)
+      if (info.action == GTxtCmdAction_MetaText)
       {
         uint16_t metaTabIdx = (static_cast<uint8_t>(data[pos]) + (0x100 * static_cast<uint8_t>(data[pos+1]))) - 1;
-        const QString metaStr = getMetaString(metaTabIdx);
-        clean.append(metaStr);
-      }
-      else if (cmd == GTxtCmd_InsertCurrentLocation)
-      {
-        clean.append(QString("<current location>").toHtmlEscaped());
+        token.type = GTxtTokenType_MetaText;
+        token.value = metaTabIdx;
+        token.param = 0;
       }
-      else if ((cmd == GTxtCmd_AddItem) ||
-               ((cmd >= GTxtCmd_ChangeAlienTemperament) && (cmd <= GTxtCmd_ModifyMissionTable)))
+      else if (info.action == GTxtCmdAction_Capture)
       {
         // the command is one of several that modify game state, so let's capture it along
         // with its parameters to pass back to the caller in a list
-
         int param = 0;
-        if (g_gameTextParamCount.contains(cmd))
+
+        // the GrantKnowledgePlace command is special because it can use either one or two
+        // parameter bytes, determined during parsing by the content of the first byte
+        if (cmd == GTxtCmd_GrantKnowledgePlace)
         {
-          // the GrantKnowledgePlace command is special because it can use either one or two
-          // parameter bytes, determined during parsing by the content of the first byte
-          if (cmd == GTxtCmd_GrantKnowledgePlace)
-          {
-            param = data[pos];
+          // (the first byte is deliberately read as a plain char, so that the result matches the
+          // original implementation exactly on platforms where char is signed)
+          param = data[pos];
 
-            // if bit 7 is set in the first parameter byte to GrantKnowledgePlace, we need
-            // to consume one additional byte and combine them to form a 16-bit place ID
-            if (param & 0x80)
+          // if bit 7 is set in the first parameter byte to GrantKnowledgePlace, we need
+          // to consume one additional byte and combine them to form a 16-bit place ID
+          if (param & 0x80)
+          {
+            // advance the input pointer once more since we just determined that an
+            // additional parameter byte is required
+            pos++;
+            if (pos < maxlen)
             {
-              // advance the input pointer once more since we just determined that an
-              // additional parameter byte is required
-              pos++;
-              if (pos < maxlen)
-              {
-                param &= 0x7F;
-                param |= (static_cast<uint16_t>(data[pos]) << 7);
-              }
+              param &= 0x7F;
+              param |= (static_cast<uint16_t>(data[pos]) << 7);
             }
           }
-          else if (g_gameTextParamCount[cmd] == 1)
-          {
-            param = static_cast<uint8_t>(data[pos]);
-          }
-          else if (g_gameTextParamCount[cmd] == 2)
-          {
-            // interpret bytes as little-endian 16-bit word
-            param = (static_cast<uint8_t>(data[pos]) + (0x100 * static_cast<uint8_t>(data[pos+1])));
-
-            // Note: the ModifyEncountRelate command actually takes two single-byte parameters.
-            // Since this is the only command with parameters in this format, we're combining them
-            // into a single 16-bit word for the sake of consistency with the other commands.
-          }
-
-          commands.append(QPair<GTxtCmd,int>(cmd, param));
+        }
+        else if (info.paramCount == 1)
+        {
+          param = static_cast<uint8_t>(data[pos]);
+        }
+        else if (info.paramCount == 2)
+        {
+          // interpret bytes as little-endian 16-bit word
+          param = (static_cast<uint8_t>(data[pos]) + (0x100 * static_cast<uint8_t>(data[pos+1])));
 
-          if (showEmbeddedCommands)
-          {
-            clean += QString(EMBEDDED_CMD_REFERENCE_STR).arg(commands.count());
-          }
+          // Note: the ModifyEncountRelate command actually takes two single-byte parameters.
+          // Since this is the only command with parameters in this format, we're combining them
+          // into a single 16-bit word for the sake of consistency with the other commands.
         }
+
+        token.type = GTxtTokenType_Command;
+        token.value = cmd;
+        token.param = param;
       }
       else
       {
-        // all other command values (bytes < 0x20) are unused, and cause the game's text engine to
-        // insert the string "<HUH?>"
-        clean.append(QString("<HUH?>").toHtmlEscaped());
+        token.type = GTxtTokenType_Substitution;
+        token.value = byte;
+        token.param = 0;
       }
 
       // advance the pointer by the number of parameter bytes used by this command
-      pos += g_gameTextParamCount[cmd];
+      pos += info.paramCount;
+    }
+
+    tokens.tokens.append(token);
+  }
+}
+
+/**
+ * Populates the provided QVector with the game state commands (and their parameters) in a token list.
+ */
+void GameText::getCommands(const GTxtTokenList& tokens, QVector<QPair<GTxtCmd,int> >& commands)
+{
+  commands.clear();
+
+  foreach (const GTxtToken& token, tokens.tokens)
+  {
+    if (token.type == GTxtTokenType_Command)
+    {
+      commands.append(QPair<GTxtCmd,int>(static_cast<GTxtCmd>(token.value), token.param));
+    }
+  }
+}
+
+/**
+ * Renders a token list as rich text for display: special characters are HTML-escaped, metatext is
+ * shown as a link whose URL lists the alternatives, and (optionally) each game state command is
+ * marked with its number in the list of commands.
+ */
+QString GameText::renderHtml(const GTxtTokenList& tokens, bool showEmbeddedCommands)
+{
+  QString html;
+  const char* const source = tokens.source.constData();
+  int commandCount = 0;
+  int textLength = 0;
+
+  // most of the output is the text runs themselves, so reserve enough for all of them (and a
+  // little more for escapes and substitutions) to avoid growing the string as it's built
+  foreach (const GTxtToken& token, tokens.tokens)
+  {
+    if (token.type == GTxtTokenType_Text)
+    {
+      textLength += token.param;
+    }
+  }
+  html.reserve(textLength + (tokens.tokens.size() * 16));
+
+  foreach (const GTxtToken& token, tokens.tokens)
+  {
+    if (token.type == GTxtTokenType_Text)
+    {
+      // copy the run of text at once, interrupted only by the characters that need escaping
+      const int end = token.value + token.param;
+      int runStart = token.value;
+
+      for (int pos = token.value; pos < end; pos++)
+      {
+        const char* const escaped = s_htmlEscape[static_cast<uint8_t>(source[pos])];
+        if (escaped)
+        {
+          html.append(QLatin1String(source + runStart, pos - runStart));
+          html.append(QLatin1String(escaped));
+          runStart = pos + 1;
+        }
+      }
+      html.append(QLatin1String(source + runStart, end - runStart));
+    }
+    else if (token.type == GTxtTokenType_Substitution)
+    {
+      html.append(QLatin1String(getCmdInfo(static_cast<uint8_t>(token.value)).htmlSubstitution));
     }
+    else if (token.type == GTxtTokenType_MetaText)
+    {
+      html.append(getMetaString(token.value));
+    }
+    else if (token.type == GTxtTokenType_Command)
+    {
+      commandCount++;
+      if (showEmbeddedCommands)
+      {
+        html += QString(EMBEDDED_CMD_REFERENCE_STR).arg(commandCount);
+      }
+    }
+  }
+
+  return html;
+}
+
+/**
+ * Renders a token list as plain text, for uses that have no need for markup (such as
+ * searching.) Metatext is replaced with its first alternative, and commands that modify
+ * game state are left out.
+ */
+QString GameText::renderPlainText(const GTxtTokenList& tokens)
+{
+  QString text;
+  const char* const source = tokens.source.constData();
+
+  foreach (const GTxtToken& token, tokens.tokens)
+  {
+    if (token.type == GTxtTokenType_Text)
+    {
+      text.append(QLatin1String(source + token.value, token.param));
+    }
+    else if (token.type == GTxtTokenType_Substitution)
+    {
+      text.append(QLatin1String(getCmdInfo(static_cast<uint8_t>(token.value)).substitution));
+    }
+    else if (token.type == GTxtTokenType_MetaText)
+    {
+      text.append(getMetaPlainString(token.value));
+    }
+  }
+
+  return text;
+}
+
+/**
+ * Renders a token list as a JSON array with one object per token, for export to other tools.
+ * Text and substitutions become "text" and "substitution" objects; metatext becomes a "metatext"
+ * object with all of its alternatives (or its gateway code); and commands become "command" objects
+ * with the command's byte value, name, and parameter.
+ */
+QByteArray GameText::renderJson(const GTxtTokenList& tokens)
+{
+  QJsonArray tokenArray;
+  const char* const source = tokens.source.constData();
+
+  foreach (const GTxtToken& token, tokens.tokens)
+  {
+    QJsonObject tokenObj;
+
+    if (token.type == GTxtTokenType_Text)
+    {
+      tokenObj.insert("type", "text");
+      tokenObj.insert("text", QString(QLatin1String(source + token.value, token.param)));
+    }
+    else if (token.type == GTxtTokenType_Substitution)
+    {
+      tokenObj.insert("type", "substitution");
+      tokenObj.insert("text", QString(getCmdInfo(static_cast<uint8_t>(token.value)).substitution));
+    }
+    else if (token.type == GTxtTokenType_MetaText)
+    {
+      const MetaEntry* entry = getMetaEntry(token.value);
+
+      tokenObj.insert("type", "metatext");
+      tokenObj.insert("index", token.value);
+      if (entry)
+      {
+        if (entry->type == METATAB_TYPE_LOSTENGATEWAY)
+        {
+          tokenObj.insert("gatewayCode", entry->gatewayCode);
+        }
+        else
+        {
+          tokenObj.insert("options", QJsonArray::fromStringList(entry->options));
+        }
+      }
+    }
+    else if (token.type == GTxtTokenType_Command)
+    {
+      const GTxtCmd cmd = static_cast<GTxtCmd>(token.value);
+      tokenObj.insert("type", "command");
+      tokenObj.insert("command", token.value);
+      tokenObj.insert("name", g_gameTextCommandName.value(cmd));
+      tokenObj.insert("param", token.param);
+    }
+
+    tokenArray.append(tokenObj);
   }
 
-  return clean;
+  return QJsonDocument(tokenArray).toJson(QJsonDocument::Compact);
 }
@@ -4,6 +4,11 @@
 #include <QString>
 #include <QMap>
 #include <QByteArray>
+#include <QVector>
+#include <QPair>
+#include <QStringList>
+#include <QMutex>
+#include <QAtomicInt>
 #include "datlibrary.h"
 
 #define METATAB_RECORDSIZE_BYTES   4
@@ -107,6 +112,40 @@ static const QMap<GTxtCmd,QString> g_gameTextCommandName =
   { GTxtCmd_ModifyMissionTable,       "Mark mission complete" }
 };
 
+//! Kinds of token that a string with embedded commands is broken into (see GameText::tokenize())
+enum GTxtTokenType
+{
+  GTxtTokenType_Text,
+  GTxtTokenType_Substitution,
+  GTxtTokenType_MetaText,
+  GTxtTokenType_Command
+};
+
+/**
+ * A single token from a string with embedded commands. The meaning of the two values
+ * depends on the token type:
+ * - Text: the offset and length of a run of printable characters in the source data
+ * - Substitution: the command byte that is replaced with fixed text (e.g. the player's name)
+ * - MetaText: the index of the entry in META.TAB
+ * - Command: the GTxtCmd that modifies game state, and its parameter
+ */
+struct GTxtToken
+{
+  GTxtTokenType type;
+  int value;
+  int param;
+};
+
+/**
+ * The tokens from a string with embedded commands, along with (a shallow copy of) the source
+ * data that the text tokens refer to.
+ */
+struct GTxtTokenList
+{
+  QByteArray source;
+  QVector<GTxtToken> tokens;
+};
+
 /**
  * Reads mission, conversation, and object text from a data file. This text
  * may have embedded command sequences that control the game environment, and
@@ -122,12 +161,33 @@ public:
   QString readString(const char* data, QVector<QPair<GTxtCmd,int> >& commands,
                      bool showEmbeddedCommands = false, int maxlen = 0x1000);
 
+  static void tokenize(const QByteArray& source, int offset, GTxtTokenList& tokens, int maxlen = 0x1000);
+  static void getCommands(const GTxtTokenList& tokens, QVector<QPair<GTxtCmd,int> >& commands);
+  QString renderHtml(const GTxtTokenList& tokens, bool showEmbeddedCommands = false);
+  QString renderPlainText(const GTxtTokenList& tokens);
+  QByteArray renderJson(const GTxtTokenList& tokens);
+
 private:
   DatLibrary* m_lib;
-  QByteArray m_metaTab;
-  QByteArray m_metaTextTab;
 
+  //! A META.TAB entry, with its alternatives and the text that replaces it already rendered
+  struct MetaEntry
+  {
+    int type;
+    int gatewayCode;
+    QStringList options;
+    QString html;
+    QString plainText;
+  };
+
+  QVector<MetaEntry> m_metaEntries;
+  QMutex m_metaTabMutex;
+  QAtomicInt m_metaEntriesLoaded;
+
+  void loadMetaEntries();
+  const MetaEntry* getMetaEntry(int metaTabIndex);
   QString getMetaString(int metaTabIndex);
+  QString getMetaPlainString(int metaTabIndex);
 };
 
 #endif // GAMETEXT_H
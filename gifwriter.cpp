@@ -0,0 +1,310 @@
+#include <string.h>
+#include <QDataStream>
+#include <QFile>
+#include <QtConcurrent/QtConcurrentMap>
+#include "gifwriter.h"
+
+GifWriter::GifWriter() :
+  m_frameDelay(GIF_DEFAULT_FRAME_DELAY_CS)
+{
+}
+
+/**
+ * Sets the time that each frame is shown, in hundredths of a second.
+ */
+void GifWriter::setFrameDelay(int centiseconds)
+{
+  m_frameDelay = qBound(1, centiseconds, 0xFFFF);
+}
+
+/**
+ * Encodes the provided frames as an animated GIF, and writes it to the specified file.
+ * @return True if the frames were encoded and the file was written; false otherwise.
+ */
+bool GifWriter::write(QString filename, const QVector<QImage>& frames) const
+{
+  bool status = false;
+  QByteArray gifData;
+
+  if (encode(frames, gifData))
+  {
+    QFile outFile(filename);
+    if (outFile.open(QIODevice::WriteOnly))
+    {
+      status = (outFile.write(gifData) == gifData.size());
+      outFile.close();
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Encodes the provided frames as a looping animated GIF. Every frame must be an 8-bit indexed
+ * image with the same dimensions; the color table of the first frame is used for all of them.
+ * @return True if the frames could be encoded; false if there were none, or if any of them
+ * were not 8-bit indexed images of the same size.
+ */
+bool GifWriter::encode(const QVector<QImage>& frames, QByteArray& gifData) const
+{
+  bool status = !frames.isEmpty() &&
+                (frames.first().width() > 0) && (frames.first().width() <= 0xFFFF) &&
+                (frames.first().height() > 0) && (frames.first().height() <= 0xFFFF);
+
+  QVector<GifFrame> gifFrames;
+  for (int frameIdx = 0; status && (frameIdx < frames.size()); frameIdx++)
+  {
+    if ((frames[frameIdx].format() == QImage::Format_Indexed8) &&
+        (frames[frameIdx].size() == frames.first().size()))
+    {
+      GifFrame frame;
+      frame.image = &frames[frameIdx];
+      frame.previous = (frameIdx > 0) ? &frames[frameIdx - 1] : nullptr;
+      gifFrames.append(frame);
+    }
+    else
+    {
+      status = false;
+    }
+  }
+
+  if (status)
+  {
+    // the frames are compressed independently (each one is only compared against the
+    // previous source frame), so they can all be done at once
+    QtConcurrent::blockingMap(gifFrames, &GifWriter::compressFrame);
+
+    gifData.clear();
+    QDataStream ds(&gifData, QIODevice::WriteOnly);
+    ds.setByteOrder(QDataStream::LittleEndian);
+
+    // header and logical screen descriptor, with a 256-entry global color table
+    ds.writeRawData("GIF89a", 6);
+    ds << quint16(frames.first().width());
+    ds << quint16(frames.first().height());
+    ds << quint8(0xF7); // global color table present, 8 bits of color resolution, 256 entries
+    ds << quint8(0);    // background color index
+    ds << quint8(0);    // pixel aspect ratio (unspecified)
+
+    const QVector<QRgb> colorTable = frames.first().colorTable();
+    for (int colorIdx = 0; colorIdx < 256; colorIdx++)
+    {
+      const QRgb color = (colorIdx < colorTable.size()) ? colorTable[colorIdx] : qRgb(0, 0, 0);
+      ds << quint8(qRed(color)) << quint8(qGreen(color)) << quint8(qBlue(color));
+    }
+
+    // application extension that makes the animation loop forever
+    ds << quint8(0x21) << quint8(0xFF) << quint8(11);
+    ds.writeRawData("NETSCAPE2.0", 11);
+    ds << quint8(3) << quint8(1) << quint16(0) << quint8(0);
+
+    for (int frameIdx = 0; frameIdx < gifFrames.size(); frameIdx++)
+    {
+      const GifFrame& frame = gifFrames[frameIdx];
+
+      if (!frame.rect.isEmpty())
+      {
+        // frames that don't change anything are left out, and the time
+        // they would have been shown is added to this frame instead
+        int delay = m_frameDelay;
+        for (int nextIdx = frameIdx + 1; (nextIdx < gifFrames.size()) && gifFrames[nextIdx].rect.isEmpty(); nextIdx++)
+        {
+          delay += m_frameDelay;
+        }
+
+        // graphic control extension; the frame is left in place when the next one is
+        // drawn, so that the next one only needs to cover the pixels that changed
+        ds << quint8(0x21) << quint8(0xF9) << quint8(4);
+        ds << quint8(0x04);
+        ds << quint16(qMin(delay, 0xFFFF));
+        ds << quint8(0) << quint8(0);
+
+        // image descriptor (with no local color table) followed by the compressed data
+        ds << quint8(0x2C);
+        ds << quint16(frame.rect.x()) << quint16(frame.rect.y());
+        ds << quint16(frame.rect.width()) << quint16(frame.rect.height());
+        ds << quint8(0);
+        ds.writeRawData(frame.lzwData.constData(), frame.lzwData.size());
+      }
+    }
+
+    ds << quint8(0x3B);
+  }
+
+  return status;
+}
+
+/**
+ * Finds the area of a frame that differs from the previous frame (or the whole frame, if
+ * it is the first one), and compresses the palette indices in that area. This runs on a
+ * thread from the global pool.
+ */
+void GifWriter::compressFrame(GifFrame& frame)
+{
+  frame.rect = frame.previous ? changedRect(*frame.image, *frame.previous) : frame.image->rect();
+
+  if (!frame.rect.isEmpty())
+  {
+    QByteArray indices;
+    indices.reserve(frame.rect.width() * frame.rect.height());
+
+    for (int y = frame.rect.top(); y <= frame.rect.bottom(); y++)
+    {
+      indices.append(reinterpret_cast<const char*>(frame.image->constScanLine(y)) + frame.rect.left(), frame.rect.width());
+    }
+
+    compressLzw(indices, frame.lzwData);
+  }
+}
+
+/**
+ * Returns the smallest rectangle that contains every pixel that differs between two images
+ * of the same size, or an empty rectangle if the images are identical.
+ */
+QRect GifWriter::changedRect(const QImage& image, const QImage& previous)
+{
+  const int width = image.width();
+  int top = 0;
+  int bottom = image.height() - 1;
+
+  while ((top <= bottom) && !memcmp(image.constScanLine(top), previous.constScanLine(top), width))
+  {
+    top++;
+  }
+  while ((bottom > top) && !memcmp(image.constScanLine(bottom), previous.constScanLine(bottom), width))
+  {
+    bottom--;
+  }
+
+  int left = width;
+  int right = -1;
+  for (int y = top; y <= bottom; y++)
+  {
+    const uchar* const line = image.constScanLine(y);
+    const uchar* const previousLine = previous.constScanLine(y);
+
+    for (int x = 0; x < left; x++)
+    {
+      if (line[x] != previousLine[x])
+      {
+        left = x;
+      }
+    }
+    for (int x = width - 1; x > right; x--)
+    {
+      if (line[x] != previousLine[x])
+      {
+        right = x;
+      }
+    }
+  }
+
+  return (right >= left) ? QRect(left, top, right - left + 1, bottom - top + 1) : QRect();
+}
+
+/**
+ * Compresses a buffer of 8-bit palette indices with the variable-length LZW coding used by
+ * the GIF format, and appends the result (the minimum code size byte, the data sub-blocks,
+ * and the block terminator) to the output buffer.
+ */
+void GifWriter::compressLzw(const QByteArray& indices, QByteArray& output)
+{
+  const int clearCode = 1 << GIF_LZW_MIN_CODE_SIZE;
+  const int endCode = clearCode + 1;
+  const int maxCode = (1 << GIF_LZW_MAX_CODE_SIZE) - 1;
+  const uint8_t* const input = reinterpret_cast<const uint8_t*>(indices.constData());
+
+  // open-addressed table mapping a string (as the code of its prefix string, followed by
+  // the palette index appended to it) to the code assigned to that string
+  QVector<int> hashKeys(GIF_LZW_HASH_SIZE, -1);
+  QVector<int> hashCodes(GIF_LZW_HASH_SIZE, 0);
+
+  QByteArray packed;
+  quint32 bitBuffer = 0;
+  int bitCount = 0;
+  int codeSize = GIF_LZW_MIN_CODE_SIZE + 1;
+  int nextCode = endCode + 1;
+
+  writeCode(clearCode, codeSize, bitBuffer, bitCount, packed);
+
+  if (!indices.isEmpty())
+  {
+    int prefix = input[0];
+
+    for (int pos = 1; pos < indices.size(); pos++)
+    {
+      const int key = (prefix << 8) | input[pos];
+      int slot = key % GIF_LZW_HASH_SIZE;
+      while ((hashKeys[slot] >= 0) && (hashKeys[slot] != key))
+      {
+        slot = (slot + 1) % GIF_LZW_HASH_SIZE;
+      }
+
+      if (hashKeys[slot] == key)
+      {
+        prefix = hashCodes[slot];
+      }
+      else
+      {
+        writeCode(prefix, codeSize, bitBuffer, bitCount, packed);
+
+        // the decoder switches to longer codes one code later than the point at which
+        // the table grows past the current code size, so the check comes first
+        if ((nextCode >= (1 << codeSize)) && (codeSize < GIF_LZW_MAX_CODE_SIZE))
+        {
+          codeSize++;
+        }
+
+        if (nextCode < maxCode)
+        {
+          hashKeys[slot] = key;
+          hashCodes[slot] = nextCode;
+          nextCode++;
+        }
+        else
+        {
+          // the table is full, so start over with a new one
+          writeCode(clearCode, codeSize, bitBuffer, bitCount, packed);
+          hashKeys.fill(-1);
+          codeSize = GIF_LZW_MIN_CODE_SIZE + 1;
+          nextCode = endCode + 1;
+        }
+
+        prefix = input[pos];
+      }
+    }
+
+    writeCode(prefix, codeSize, bitBuffer, bitCount, packed);
+  }
+
+  writeCode(endCode, codeSize, bitBuffer, bitCount, packed);
+  if (bitCount > 0)
+  {
+    packed.append(static_cast<char>(bitBuffer & 0xFF));
+  }
+
+  output.append(static_cast<char>(GIF_LZW_MIN_CODE_SIZE));
+  for (int pos = 0; pos < packed.size(); pos += GIF_MAX_SUBBLOCK_LEN)
+  {
+    const int blockLen = qMin(GIF_MAX_SUBBLOCK_LEN, packed.size() - pos);
+    output.append(static_cast<char>(blockLen));
+    output.append(packed.constData() + pos, blockLen);
+  }
+  output.append('\0');
+}
+
+/**
+ * Appends a single LZW code to the packed output, least significant bit first.
+ */
+void GifWriter::writeCode(int code, int codeSize, quint32& bitBuffer, int& bitCount, QByteArray& output)
+{
+  bitBuffer |= static_cast<quint32>(code) << bitCount;
+  bitCount += codeSize;
+
+  while (bitCount >= 8)
+  {
+    output.append(static_cast<char>(bitBuffer & 0xFF));
+    bitBuffer >>= 8;
+    bitCount -= 8;
+  }
+}
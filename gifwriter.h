@@ -0,0 +1,59 @@
+#ifndef GIFWRITER_H
+#define GIFWRITER_H
+
+#include <QByteArray>
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QVector>
+
+//! Default time that each animation frame is shown, in hundredths of a second
+#define GIF_DEFAULT_FRAME_DELAY_CS 10
+
+//! LZW minimum code size for 8-bit palette indices
+#define GIF_LZW_MIN_CODE_SIZE 8
+
+//! Largest LZW code size (in bits) allowed by the GIF format
+#define GIF_LZW_MAX_CODE_SIZE 12
+
+//! Number of slots in the hash table used to look up LZW strings (a prime larger than 4096)
+#define GIF_LZW_HASH_SIZE 5003
+
+//! Largest number of bytes in a single GIF data sub-block
+#define GIF_MAX_SUBBLOCK_LEN 255
+
+/**
+ * Writes a sequence of 8-bit indexed images as a looping animated GIF, with the palette of
+ * the first image used as the global color table (so the original palette indices are kept
+ * exactly.) After the first frame, each frame only stores the smallest rectangle enclosing
+ * the pixels that changed since the previous frame, and frames that don't change anything
+ * are merged into the previous one. The frames are compressed in parallel.
+ */
+class GifWriter
+{
+public:
+  GifWriter();
+
+  void setFrameDelay(int centiseconds);
+  bool encode(const QVector<QImage>& frames, QByteArray& gifData) const;
+  bool write(QString filename, const QVector<QImage>& frames) const;
+
+private:
+  //! A single frame, along with the results of compressing it
+  struct GifFrame
+  {
+    const QImage* image;
+    const QImage* previous;
+    QRect rect;
+    QByteArray lzwData;
+  };
+
+  int m_frameDelay;
+
+  static void compressFrame(GifFrame& frame);
+  static QRect changedRect(const QImage& image, const QImage& previous);
+  static void compressLzw(const QByteArray& indices, QByteArray& output);
+  static void writeCode(int code, int codeSize, quint32& bitBuffer, int& bitCount, QByteArray& output);
+};
+
+#endif // GIFWRITER_H
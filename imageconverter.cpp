@@ -1,25 +1,197 @@
 #include "imageconverter.h"
 #include <stdint.h>
+#include <string.h>
 #include <QtEndian>
 #include <QImage>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 //! Table of relative pixel-to-pixel delta values used in DEL image encoding
 const int8_t ImageConverter::s_deltas[] = {0,1,2,3,4,5,6,7,-8,-7,-6,-5,-4,-3,-2,-1};
 
 /**
- * Uses a zero-based pixel index and an image width to determine the x,y position
- * of the pixel in question.
+ * Prepares to write pixels into the provided 8-bit indexed image, starting at the top-left pixel.
+ */
+ImageConverter::ScanlineWriter::ScanlineWriter(QImage& image) :
+  m_bits(image.bits()),
+  m_bytesPerLine(image.bytesPerLine()),
+  m_width(image.width()),
+  m_row(m_bits),
+  m_x(0),
+  m_y(0),
+  m_pixelCount(m_bits ? (image.width() * image.height()) : 0),
+  m_remaining(m_pixelCount)
+{
+}
+
+/**
+ * Returns the number of pixels between the cursor and the end of the image.
+ */
+int ImageConverter::ScanlineWriter::remaining() const
+{
+  return m_remaining;
+}
+
+/**
+ * Writes the same palette index to the next 'count' pixels (or to as many as remain
+ * in the image, if that is fewer).
+ */
+void ImageConverter::ScanlineWriter::fill(uint8_t palIndex, int count)
+{
+  count = qMin(count, m_remaining);
+
+  if ((m_bytesPerLine == m_width) && (count > 0))
+  {
+    // without any padding at the ends of the scanlines, a run that crosses
+    // a row boundary is still contiguous in memory
+    memset(m_row + m_x, palIndex, static_cast<size_t>(count));
+    advance(count);
+  }
+  else
+  {
+    while (count > 0)
+    {
+      const int span = qMin(count, m_width - m_x);
+      memset(m_row + m_x, palIndex, static_cast<size_t>(span));
+      advance(span);
+      count -= span;
+    }
+  }
+}
+
+/**
+ * Copies 'count' palette indices from the source buffer to the next pixels (or to as many
+ * as remain in the image, if that is fewer).
+ */
+void ImageConverter::ScanlineWriter::copy(const uint8_t* src, int count)
+{
+  count = qMin(count, m_remaining);
+
+  if ((m_bytesPerLine == m_width) && (count > 0))
+  {
+    memcpy(m_row + m_x, src, static_cast<size_t>(count));
+    advance(count);
+  }
+  else
+  {
+    while (count > 0)
+    {
+      const int span = qMin(count, m_width - m_x);
+      memcpy(m_row + m_x, src, static_cast<size_t>(span));
+      advance(span);
+      src += span;
+      count -= span;
+    }
+  }
+}
+
+/**
+ * Advances the cursor past the next 'count' pixels without changing them.
+ */
+void ImageConverter::ScanlineWriter::skip(int count)
+{
+  advance(qBound(0, count, m_remaining));
+}
+
+/**
+ * Moves the cursor to the specified pixel (counting in raster order from the top-left).
+ * Positions past the end of the image move the cursor to the end.
  */
-QPoint ImageConverter::getPixelLocation(int imgWidth, int pixelNum)
+void ImageConverter::ScanlineWriter::seek(int position)
 {
-  QPoint pt (pixelNum % imgWidth, pixelNum / imgWidth);
-  return pt;
+  position = qBound(0, position, m_pixelCount);
+  m_remaining = m_pixelCount - position;
+
+  if (m_width > 0)
+  {
+    m_y = position / m_width;
+    m_x = position % m_width;
+    m_row = m_bits + (m_y * m_bytesPerLine);
+  }
+}
+
+/**
+ * Moves the cursor ahead by the specified number of pixels (which must not be more than the
+ * number remaining), wrapping to the following scanline(s) as necessary.
+ */
+void ImageConverter::ScanlineWriter::advance(int count)
+{
+  m_remaining -= count;
+  m_x += count;
+
+  // once the end of the image is reached, the cursor is left where it is
+  if ((m_x >= m_width) && (m_remaining > 0))
+  {
+    m_y += m_x / m_width;
+    m_x = m_x % m_width;
+    m_row = m_bits + (m_y * m_bytesPerLine);
+  }
+}
+
+/**
+ * Expands a run of 4-bit deltas from a DEL delta sequence (packed two per byte, high nibble
+ * first) into palette indices. Each output byte is the previous one (starting with 'start')
+ * plus the next delta, so the run is a prefix sum of the deltas; with SSE2, sixteen deltas
+ * are expanded and summed at once. The output buffer must have room for deltaCount rounded
+ * up to a multiple of 16, and deltaCount may not be more than DEL_MAX_DELTA_COUNT.
+ */
+void ImageConverter::expandDeltas(uint8_t start, const uint8_t* nibbles, int deltaCount, uint8_t* output)
+{
+#if defined(__SSE2__)
+  // copy the packed nibbles to a zero-padded buffer so that the 8-byte loads below
+  // never read past the end of the input; the padding expands to deltas of zero,
+  // which only land in the slack at the end of the output buffer
+  uint8_t padded[DEL_MAX_DELTA_COUNT / 2 + 8];
+  memset(padded, 0, sizeof(padded));
+  memcpy(padded, nibbles, static_cast<size_t>((deltaCount + 1) / 2));
+
+  const __m128i lowNibbleMask = _mm_set1_epi8(0x0F);
+  const __m128i signBit = _mm_set1_epi8(0x08);
+  __m128i running = _mm_set1_epi8(static_cast<char>(start));
+
+  for (int pos = 0; pos < deltaCount; pos += 16)
+  {
+    const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(padded + (pos / 2)));
+    const __m128i highNibbles = _mm_and_si128(_mm_srli_epi16(packed, 4), lowNibbleMask);
+    const __m128i lowNibbles = _mm_and_si128(packed, lowNibbleMask);
+
+    // interleave to put the nibbles in stream order, and then sign-extend each
+    // from four bits (which gives the same values as the s_deltas table)
+    __m128i sum = _mm_unpacklo_epi8(highNibbles, lowNibbles);
+    sum = _mm_sub_epi8(_mm_xor_si128(sum, signBit), signBit);
+
+    // in-register prefix sum (modulo 256) across the sixteen lanes
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+    sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+    sum = _mm_add_epi8(sum, running);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + pos), sum);
+
+    // broadcast the last lane to carry the running value into the next group
+    running = _mm_unpackhi_epi8(sum, sum);
+    running = _mm_unpackhi_epi16(running, running);
+    running = _mm_shuffle_epi32(running, 0xFF);
+  }
+#else
+  uint8_t databyte = start;
+
+  for (int pos = 0; pos < deltaCount; pos++)
+  {
+    const uint8_t nibbleByte = nibbles[pos / 2];
+    const uint8_t nibble = (pos & 1) ? (nibbleByte & 0x0F) : (nibbleByte >> 4);
+    databyte += s_deltas[nibble];
+    output[pos] = databyte;
+  }
+#endif
 }
 
 /**
  * Converts 8-bit raw image data (with a 4-byte header containing the image
  * width and height, respectively, in two 16-bit little-endian words) to
- * a QPixmap, using the provided palette.
+ * a QImage, using the provided palette.
  */
 bool ImageConverter::lbmToImage(const QByteArray& lbmData, QVector<QRgb> palette, QImage& img)
 {
@@ -28,24 +200,17 @@ bool ImageConverter::lbmToImage(const QByteArray& lbmData, QVector<QRgb> palette
   if (lbmData.size() >= 5) // 5 bytes is the minimum theoretical size of a raw image of this format
   {
     status = true;
-    const uint16_t width = qFromLittleEndian<quint16>(lbmData.data() + 0);
-    const uint16_t height = qFromLittleEndian<quint16>(lbmData.data() + 2);
+    const uint16_t width = qFromLittleEndian<quint16>(lbmData.constData() + 0);
+    const uint16_t height = qFromLittleEndian<quint16>(lbmData.constData() + 2);
 
     img = QImage(width, height, QImage::Format_Indexed8);
     img.setColorTable(palette);
 
-    int inputpos = 4; // pixel data starts at byte offset 4
-    int outputpos = 0;
-
-    const uint8_t* const lbmDataUnsigned = reinterpret_cast<const uint8_t* const>(lbmData.data());
-
-    while (inputpos < lbmData.size())
-    {
-      const unsigned int palIndex = static_cast<unsigned int>(lbmDataUnsigned[inputpos]);
-      inputpos++;
-      img.setPixel(getPixelLocation(width, outputpos), palIndex);
-      outputpos++;
-    }
+    // pixel data starts at byte offset 4, and any data beyond the
+    // last pixel in the image is ignored
+    const uint8_t* const lbmDataUnsigned = reinterpret_cast<const uint8_t*>(lbmData.constData());
+    ScanlineWriter out(img);
+    out.copy(lbmDataUnsigned + 4, lbmData.size() - 4);
   }
 
   return status;
@@ -60,22 +225,20 @@ bool ImageConverter::plnToPixmap(const QByteArray& plnData, QVector<QRgb> palett
 
   if (plnData.size() >= 3) // 3 bytes is the minimum theoretical size of a .pln image
   {
-    status = true;
-    const uint16_t width = qFromLittleEndian<quint16>(plnData.data() + 0);
-    const uint16_t height = static_cast<uint16_t>((plnData.size() - 2) / width);
+    const uint16_t width = qFromLittleEndian<quint16>(plnData.constData() + 0);
 
-    image = QImage(width, height, QImage::Format_Indexed8);
-    image.setColorTable(palette);
+    if (width > 0)
+    {
+      status = true;
+      const uint16_t height = static_cast<uint16_t>((plnData.size() - 2) / width);
 
-    int inputpos = 2;
-    int outputpos = 0;
+      image = QImage(width, height, QImage::Format_Indexed8);
+      image.setColorTable(palette);
 
-    while (inputpos < plnData.size())
-    {
-      const uint8_t palIndex = static_cast<uint8_t>(plnData.at(inputpos));
-      inputpos++;
-      image.setPixel(getPixelLocation(width, outputpos), palIndex);
-      outputpos++;
+      // pixel data starts at byte offset 2
+      const uint8_t* const plnDataUnsigned = reinterpret_cast<const uint8_t*>(plnData.constData());
+      ScanlineWriter out(image);
+      out.copy(plnDataUnsigned + 2, plnData.size() - 2);
     }
   }
 
@@ -87,51 +250,43 @@ bool ImageConverter::plnToPixmap(const QByteArray& plnData, QVector<QRgb> palett
  */
 bool ImageConverter::stpToImage(const QByteArray& stpData, QVector<QRgb> palette, QImage& image)
 {
+  if (stpData.size() < 4)
+  {
+    return false;
+  }
+
   bool status = true;
-  const uint16_t width = qFromLittleEndian<quint16>(stpData.data() + 0);
-  const uint16_t height = qFromLittleEndian<quint16>(stpData.data() + 2);
+  const uint16_t width = qFromLittleEndian<quint16>(stpData.constData() + 0);
+  const uint16_t height = qFromLittleEndian<quint16>(stpData.constData() + 2);
 
   image = QImage(width, height, QImage::Format_Indexed8);
   image.setColorTable(palette);
 
-  const uint8_t* const stpDataUnsigned = reinterpret_cast<const uint8_t*>(stpData.data());
+  const uint8_t* const stpDataUnsigned = reinterpret_cast<const uint8_t*>(stpData.constData());
+  const int inputSize = stpData.size();
 
-  const int pixelcount = width * height;
+  ScanlineWriter out(image);
   int inputpos = 8; // STP image data begins at byte index 8
-  int outputpos = 0;
-  int endptr = 0;
 
-  while ((inputpos < stpData.size()) && (outputpos < pixelcount))
+  while ((inputpos < inputSize) && (out.remaining() > 0))
   {
-    uint8_t rlebyte = static_cast<uint8_t>(stpData.at(inputpos));
+    const uint8_t rlebyte = stpDataUnsigned[inputpos];
     inputpos++;
 
     if (rlebyte & 0x80)
     {
       // bit 7 is set, so this is moving the output pointer ahread,
       // leaving the default value in the skipped locations
-      endptr = outputpos + (rlebyte & 0x7F);
-      while ((outputpos < endptr) && (outputpos < pixelcount))
-      {
-        image.setPixel(getPixelLocation(width, outputpos), 0x00);
-        outputpos++;
-      }
+      out.fill(0x00, rlebyte & 0x7F);
     }
     else if (rlebyte & 0x40)
     {
       // Bit 7 is clear and bit 6 is set, so this is a repeating sequence of a single byte.
       // We only need to read one input byte for this RLE sequence, so verify that the input
       // pointer is still within the buffer range.
-      if (inputpos < stpData.size())
+      if (inputpos < inputSize)
       {
-        endptr = outputpos + (rlebyte & 0x3F);
-
-        unsigned int palindex = stpDataUnsigned[inputpos];
-        while ((outputpos < endptr) && (outputpos < pixelcount))
-        {
-          image.setPixel(getPixelLocation(width, outputpos), palindex);
-          outputpos++;
-        }
+        out.fill(stpDataUnsigned[inputpos], rlebyte & 0x3F);
       }
 
       // advance the input once more so that we read the next RLE byte at the top of the loop
@@ -139,20 +294,16 @@ bool ImageConverter::stpToImage(const QByteArray& stpData, QVector<QRgb> palette
     }
     else
     {
-      // bits 6 and 7 are clear, so this is a byte sequence copy from the input
-      endptr = outputpos + rlebyte;
-      while ((outputpos < endptr) && (outputpos < pixelcount) && (inputpos < stpData.size()))
-      {
-        unsigned int palindex = stpDataUnsigned[inputpos];
-        image.setPixel(getPixelLocation(width, outputpos), palindex);
-        inputpos++;
-        outputpos++;
-      }
+      // bits 6 and 7 are clear, so this is a byte sequence copy from the input,
+      // limited by both the end of the input and the end of the image
+      const int count = qMin(static_cast<int>(rlebyte), qMin(inputSize - inputpos, out.remaining()));
+      out.copy(stpDataUnsigned + inputpos, count);
+      inputpos += count;
     }
   }
 
   // check if the input runs dry before all of the pixels are accounted for in the output
-  if ((inputpos >= stpData.size()) && (outputpos < pixelcount))
+  if ((inputpos >= inputSize) && (out.remaining() > 0))
   {
     status = false;
   }
@@ -167,52 +318,146 @@ bool ImageConverter::stpToImage(const QByteArray& stpData, QVector<QRgb> palette
  */
 bool ImageConverter::delToImage(const QByteArray& delData, QVector<QRgb> palette, QImage& image)
 {
-  const uint16_t width = qFromLittleEndian<quint16>(delData.data() + 0);
-  const uint16_t height = qFromLittleEndian<quint16>(delData.data() + 2);
-  int inputpos = 4;
-  int outputpos = 0;
+  if (delData.size() < 4)
+  {
+    return false;
+  }
+
+  const uint16_t width = qFromLittleEndian<quint16>(delData.constData() + 0);
+  const uint16_t height = qFromLittleEndian<quint16>(delData.constData() + 2);
+
+  if (!prepareOverlayTarget(width, height, palette, image))
+  {
+    return false;
+  }
+
+  ScanlineWriter out(image);
+  decodeDel(reinterpret_cast<const uint8_t*>(delData.constData()), delData.size(), out);
+
+  return true;
+}
+
+/**
+ * Decodes delta-encoded image data (.DEL) into a sparse list of runs, without drawing it.
+ * The overlay can then be drawn any number of times (on any number of images) with
+ * applyOverlay(), which is much cheaper than decoding the .DEL data again each time.
+ * @return True if the data was long enough to contain the DEL header; false otherwise.
+ */
+bool ImageConverter::delToOverlay(const QByteArray& delData, DelOverlay& overlay)
+{
+  if (delData.size() < 4)
+  {
+    return false;
+  }
+
+  overlay.width = qFromLittleEndian<quint16>(delData.constData() + 0);
+  overlay.height = qFromLittleEndian<quint16>(delData.constData() + 2);
+  overlay.runs.clear();
+  overlay.pixels.clear();
+
+  OverlayWriter out(overlay);
+  decodeDel(reinterpret_cast<const uint8_t*>(delData.constData()), delData.size(), out);
+  overlay.runs.squeeze();
+  overlay.pixels.squeeze();
+
+  return true;
+}
+
+/**
+ * Draws a decoded DEL overlay onto the provided image, following the same rules as
+ * delToImage(): if the image is null, a new one is created (with the pixels that the overlay
+ * does not cover set to palette index 0); otherwise, its dimensions must match the overlay's.
+ * @return True if the overlay was drawn; false if the image dimensions did not match.
+ */
+bool ImageConverter::applyOverlay(const DelOverlay& overlay, QVector<QRgb> palette, QImage& image)
+{
+  bool status = prepareOverlayTarget(overlay.width, overlay.height, palette, image);
+
+  if (status)
+  {
+    ScanlineWriter out(image);
+    const uint8_t* const pixels = reinterpret_cast<const uint8_t*>(overlay.pixels.constData());
+
+    foreach (const DelOverlayRun& run, overlay.runs)
+    {
+      out.seek(run.offset);
+      out.copy(pixels + run.dataOffset, run.length);
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Returns the approximate amount of memory (in bytes) used by a decoded DEL overlay.
+ */
+int ImageConverter::overlaySize(const DelOverlay& overlay)
+{
+  return static_cast<int>(sizeof(DelOverlay)) + overlay.pixels.size() +
+         (overlay.runs.size() * static_cast<int>(sizeof(DelOverlayRun)));
+}
+
+/**
+ * Sets up the image that a DEL overlay will be drawn onto. If we were provided a null image,
+ * the caller doesn't expect the overlay to be drawn on an existing image, so a new one is
+ * created (with the pixels that are skipped over by the encoding left at palette index 0).
+ * @return False if a non-null image was provided and its dimensions don't match the overlay's.
+ */
+bool ImageConverter::prepareOverlayTarget(int width, int height, QVector<QRgb> palette, QImage& image)
+{
+  bool status = true;
 
-  // if we were provided a null image as a param, the caller doesn't expect this image to
-  // be drawn as an overlay on an existing image, so we need to create a new one
   if (image.isNull())
   {
     image = QImage(width, height, QImage::Format_Indexed8);
     image.setColorTable(palette);
+    image.fill(0);
   }
   else if ((width != image.width()) || (height != image.height()))
   {
     // if we were provided a non-null existing image, then the dimensions of the image
     // we're decoding now must match the dimensions of the existing image
-    return false;
+    status = false;
   }
 
-  while (inputpos < delData.size())
+  return status;
+}
+
+/**
+ * Parses the command stream of delta-encoded image data (.DEL), starting just past the
+ * 4-byte width/height header, and passes each run of pixels (or of skipped pixels) to the
+ * provided writer, which is either a ScanlineWriter or an OverlayWriter.
+ */
+template <typename Writer>
+void ImageConverter::decodeDel(const uint8_t* delDataUnsigned, int inputSize, Writer& out)
+{
+  int inputpos = 4;
+
+  while (inputpos < inputSize)
   {
-    uint8_t cmdbyte = static_cast<uint8_t>(delData.at(inputpos));
-    uint8_t databyte = 0;
+    const uint8_t cmdbyte = delDataUnsigned[inputpos];
     inputpos++;
 
     if (cmdbyte & 0x01)
     {
       // we'll be writing the byte from the input stream to the output at least once,
       // so grab the input byte now
-      databyte = static_cast<uint8_t>(delData.at(inputpos));
+      if (inputpos >= inputSize)
+      {
+        break;
+      }
+      const uint8_t databyte = delDataUnsigned[inputpos];
       inputpos++;
 
       if (cmdbyte & 0x02)
       {
         // single byte copy from input (low two bits of command are 11)
-        image.setPixel(getPixelLocation(width, outputpos), databyte);
-        outputpos++;
+        out.fill(databyte, 1);
       }
       else
       {
         // repeat byte from input (low two bits of command are 01)
-        for (int repeatidx = 0; repeatidx < (cmdbyte >> 2); repeatidx++)
-        {
-          image.setPixel(getPixelLocation(width, outputpos), databyte);
-          outputpos++;
-        }
+        out.fill(databyte, cmdbyte >> 2);
       }
     }
     else
@@ -225,16 +470,13 @@ bool ImageConverter::delToImage(const QByteArray& delData, QVector<QRgb> palette
 
         // the next byte from the input is used as the repeat count if and only if
         // the top six bits of the command byte are zeroed
-        if (repeatcount == 0)
+        if ((repeatcount == 0) && (inputpos < inputSize))
         {
-          repeatcount = static_cast<uint8_t>(delData.at(inputpos));
+          repeatcount = delDataUnsigned[inputpos];
           inputpos++;
         }
 
-        for (int repeatidx = 0; repeatidx < repeatcount; repeatidx++)
-        {
-          outputpos++;
-        }
+        out.skip(repeatcount);
       }
       else
       {
@@ -243,48 +485,107 @@ bool ImageConverter::delToImage(const QByteArray& delData, QVector<QRgb> palette
         // length of the sequence, including the first literal byte
         const int length = (cmdbyte >> 2);
 
-        if (length > 0)
+        if ((length > 0) && (inputpos < inputSize))
         {
-          // position in the input stream of the byte containing the last nibble for this sequence
-          //const int sequenceEnd = inputpos + (length / 2);
-
-          // first byte written to the output will be the next byte in the input stream
-          databyte = static_cast<uint8_t>(delData.at(inputpos));
+          // first byte written to the output will be the next byte in the input stream,
+          // and each following byte is the previous one plus a delta from a 4-bit nibble
+          // (high nibble first); a trailing unused nibble is simply wasted
+          uint8_t sequence[DEL_SEQUENCE_BUFFER_SIZE];
+          sequence[0] = delDataUnsigned[inputpos];
           inputpos++;
 
-          image.setPixel(getPixelLocation(width, outputpos), databyte);
-          outputpos++;
+          // the sequence is clamped to the available input, but the input is consumed
+          // regardless of how much of the sequence lands inside the image
+          const int nibbleBytes = qMin(length / 2, inputSize - inputpos);
+          const int decodeLength = qMin(length, 1 + (nibbleBytes * 2));
 
-          int sequenceCount = 1;
+          expandDeltas(sequence[0], delDataUnsigned + inputpos, decodeLength - 1, sequence + 1);
+          out.copy(sequence, decodeLength);
+          inputpos += nibbleBytes;
+        }
+      }
+    }
+  }
 
-          while (sequenceCount < length)
-          {
-            uint8_t nibble = static_cast<uint8_t>(delData.at(inputpos)) >> 4;
+}
 
-            databyte += s_deltas[nibble];
-            image.setPixel(getPixelLocation(width, outputpos), databyte);
-            outputpos++;
-            sequenceCount++;
+/**
+ * Prepares to record the runs of a DEL overlay, whose dimensions must already be set.
+ */
+ImageConverter::OverlayWriter::OverlayWriter(DelOverlay& overlay) :
+  m_overlay(&overlay),
+  m_position(0),
+  m_remaining(overlay.width * overlay.height)
+{
+}
 
-            // only process the second nibble if we haven't yet completed the sequence;
-            // if the sequence does not require this nibble then it's simply wasted
-            if (sequenceCount < length)
-            {
-              nibble = static_cast<uint8_t>(delData.at(inputpos)) & 0x0F;
+/**
+ * Returns the number of pixels between the cursor and the end of the overlay.
+ */
+int ImageConverter::OverlayWriter::remaining() const
+{
+  return m_remaining;
+}
 
-              databyte += s_deltas[nibble];
-              image.setPixel(getPixelLocation(width, outputpos), databyte);
-              outputpos++;
+/**
+ * Records a run of pixels with the same palette index.
+ */
+void ImageConverter::OverlayWriter::fill(uint8_t palIndex, int count)
+{
+  count = qMin(count, m_remaining);
 
-              sequenceCount++;
-            }
+  if (count > 0)
+  {
+    startRun(count);
+    m_overlay->pixels.append(count, static_cast<char>(palIndex));
+  }
+}
 
-            inputpos++;
-          }
-        }
-      }
-    }
+/**
+ * Records a run of pixels copied from the source buffer.
+ */
+void ImageConverter::OverlayWriter::copy(const uint8_t* src, int count)
+{
+  count = qMin(count, m_remaining);
+
+  if (count > 0)
+  {
+    startRun(count);
+    m_overlay->pixels.append(reinterpret_cast<const char*>(src), count);
   }
+}
 
-  return true;
+/**
+ * Advances the cursor past pixels that the overlay leaves unchanged.
+ */
+void ImageConverter::OverlayWriter::skip(int count)
+{
+  count = qBound(0, count, m_remaining);
+  m_position += count;
+  m_remaining -= count;
+}
+
+/**
+ * Adds a run of the specified length at the cursor position (or extends the previous run,
+ * if it ends right at the cursor) and advances the cursor past it. The caller appends the
+ * run's pixels.
+ */
+void ImageConverter::OverlayWriter::startRun(int count)
+{
+  if (!m_overlay->runs.isEmpty() &&
+      ((m_overlay->runs.last().offset + m_overlay->runs.last().length) == m_position))
+  {
+    m_overlay->runs.last().length += count;
+  }
+  else
+  {
+    DelOverlayRun run;
+    run.offset = m_position;
+    run.length = count;
+    run.dataOffset = m_overlay->pixels.size();
+    m_overlay->runs.append(run);
+  }
+
+  m_position += count;
+  m_remaining -= count;
 }
@@ -6,9 +6,34 @@
 #include <QByteArray>
 #include <QVector>
 #include <QRgb>
-#include <QPoint>
 #include <stdint.h>
 
+//! Maximum number of deltas in a DEL delta sequence (whose 6-bit length includes the initial literal)
+#define DEL_MAX_DELTA_COUNT 62
+
+//! Size of the buffer for a decoded DEL delta sequence, including slack for 16-byte vector stores
+#define DEL_SEQUENCE_BUFFER_SIZE (1 + DEL_MAX_DELTA_COUNT + 16)
+
+//! A run of pixels drawn by a DEL overlay
+struct DelOverlayRun
+{
+  int offset;     //!< Index of the first pixel in the run, in raster order
+  int length;     //!< Number of pixels in the run
+  int dataOffset; //!< Position of the run's palette indices in DelOverlay::pixels
+};
+
+/**
+ * A delta-encoded overlay (.DEL) that has been decoded into a sparse list of the pixel runs
+ * that it draws, so that it can be composited repeatedly without being decoded again.
+ */
+struct DelOverlay
+{
+  int width;
+  int height;
+  QVector<DelOverlayRun> runs;
+  QByteArray pixels;
+};
+
 class ImageConverter
 {
 public:
@@ -17,10 +42,71 @@ public:
   static bool lbmToImage(const QByteArray& rawData, QVector<QRgb> palette, QImage& image);
   static bool plnToPixmap(const QByteArray& plnData, QVector<QRgb> palette, QImage& image);
 
+  static bool delToOverlay(const QByteArray& delData, DelOverlay& overlay);
+  static bool applyOverlay(const DelOverlay& overlay, QVector<QRgb> palette, QImage& image);
+  static int overlaySize(const DelOverlay& overlay);
+
 private:
   ImageConverter();
-  static QPoint getPixelLocation(int imgWidth, int pixelnum);
   static const int8_t s_deltas[];
+
+  static void expandDeltas(uint8_t start, const uint8_t* nibbles, int deltaCount, uint8_t* output);
+  static bool prepareOverlayTarget(int width, int height, QVector<QRgb> palette, QImage& image);
+
+  template <typename Writer>
+  static void decodeDel(const uint8_t* delDataUnsigned, int inputSize, Writer& out);
+
+  /**
+   * Sequential output cursor over the pixels of an 8-bit indexed image. Pixels are written
+   * in raster order straight into the image's scanlines (skipping the padding at the end
+   * of each line), and every run is clamped to the end of the image as a whole, so that
+   * the individual pixel writes don't need to be checked.
+   */
+  class ScanlineWriter
+  {
+  public:
+    ScanlineWriter(QImage& image);
+
+    int remaining() const;
+    void fill(uint8_t palIndex, int count);
+    void copy(const uint8_t* src, int count);
+    void skip(int count);
+    void seek(int position);
+
+  private:
+    uchar* m_bits;
+    int m_bytesPerLine;
+    int m_width;
+    uchar* m_row;
+    int m_x;
+    int m_y;
+    int m_pixelCount;
+    int m_remaining;
+
+    void advance(int count);
+  };
+
+  /**
+   * Output cursor with the same interface as ScanlineWriter, but which records the runs
+   * of pixels in a DelOverlay rather than drawing them.
+   */
+  class OverlayWriter
+  {
+  public:
+    OverlayWriter(DelOverlay& overlay);
+
+    int remaining() const;
+    void fill(uint8_t palIndex, int count);
+    void copy(const uint8_t* src, int count);
+    void skip(int count);
+
+  private:
+    DelOverlay* m_overlay;
+    int m_position;
+    int m_remaining;
+
+    void startRun(int count);
+  };
 };
 
 #endif // IMAGECONVERTER_H
@@ -21,6 +21,7 @@ InvObject::~InvObject()
  */
 void InvObject::clear()
 {
+  DatTable<ObjectTableEntry>::clear();
   m_objList.clear();
 }
 
@@ -37,7 +38,7 @@ bool InvObject::populateList()
   {
     status = true;
     int index = 0;
-    ObjectTableEntry* currentEntry = getEntry(index);
+    const ObjectTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -75,10 +76,7 @@ bool InvObject::populateList()
  */
 QMap<int,InventoryObj> InvObject::getList()
 {
-  if (m_objList.isEmpty())
-  {
-    populateList();
-  }
+  load();
   return m_objList;
 }
 
@@ -89,17 +87,54 @@ QMap<int,InventoryObj> InvObject::getList()
  */
 QString InvObject::getObjectText(int id)
 {
+  GTxtTokenList tokens;
+  QString txt;
+
+  if (getObjectTextTokens(id, tokens))
+  {
+    txt = m_gtext->renderHtml(tokens);
+  }
+
+  return txt;
+}
+
+/**
+ * Gets the informational text associated with a particular object ID as plain
+ * text, without any markup (for searching.)
+ * @return Text string associated with the object ID, or an empty string if
+ * no object with the specified ID could be found.
+ */
+QString InvObject::getObjectPlainText(int id)
+{
+  GTxtTokenList tokens;
+  QString txt;
+
+  if (getObjectTextTokens(id, tokens))
+  {
+    txt = m_gtext->renderPlainText(tokens);
+  }
+
+  return txt;
+}
+
+/**
+ * Reads the informational text associated with a particular object ID from
+ * OBJTEXT.TXT and breaks it into tokens.
+ * @return True if the object has informational text; false otherwise.
+ */
+bool InvObject::getObjectTextTokens(int id, GTxtTokenList& tokens)
+{
+  bool status = false;
   QByteArray objTextIdxData;
   QByteArray objTextStrData;
-  QString txt;
 
-  if (m_objList.contains(id) && (m_objList[id].type == InventoryObjType_NormalWithText))
+  if (m_objList.contains(id) && (m_objList.value(id).type == InventoryObjType_NormalWithText))
   {
 
     if (m_lib->getFileByName(DatFileType_CONVERSE, "OBJTEXT.IDX", objTextIdxData) &&
         m_lib->getFileByName(DatFileType_CONVERSE, "OBJTEXT.TXT", objTextStrData))
     {
-      const int idxOffset = m_objList[id].subtype * 4;
+      const int idxOffset = m_objList.value(id).subtype * 4;
       int32_t txtOffset = 0;
 
       memcpy(&txtOffset, objTextIdxData.data() + idxOffset, 4);
@@ -107,14 +142,14 @@ QString InvObject::getObjectText(int id)
 
       if (txtOffset < objTextStrData.size())
       {
-        QVector<QPair<GTxtCmd,int> > commands;
-        const char* rawdata = objTextStrData.data();
-        txt = m_gtext->readString(rawdata + txtOffset, commands);
+        const int maxlen = qMin(0x1000, objTextStrData.size() - txtOffset);
+        GameText::tokenize(objTextStrData, txtOffset, tokens, maxlen);
+        status = true;
       }
     }
   }
 
-  return txt;
+  return status;
 }
 
 /**
@@ -149,14 +184,11 @@ InventoryObjType InvObject::getObjectType(int id)
 {
   InventoryObjType type = InventoryObjType_Invalid;
 
-  if (m_objList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_objList.contains(id))
   {
-    type = m_objList[id].type;
+    type = m_objList.value(id).type;
   }
 
   return type;
@@ -171,14 +203,11 @@ QString InvObject::getName(int id)
 {
   QString name("");
 
-  if (m_objList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_objList.contains(id))
   {
-    name = m_objList[id].name;
+    name = m_objList.value(id).name;
   }
 
   return name;
@@ -193,7 +222,7 @@ bool InvObject::isUnique(const int id)
 {
   if (m_objList.contains(id))
   {
-    return m_objList[id].unique;
+    return m_objList.value(id).unique;
   }
 
   return false;
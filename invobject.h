@@ -98,6 +98,7 @@ public:
   QMap<int,InventoryObj> getList();
   InventoryObjType getObjectType(int id);
   QString getObjectText(int id);
+  QString getObjectPlainText(int id);
   QString getName(int id);
   bool isUnique(const int id);
   void clear();
@@ -109,6 +110,8 @@ private:
   Palette* m_pal;
   GameText* m_gtext;
   QMap<int,InventoryObj> m_objList;
+
+  bool getObjectTextTokens(int id, GTxtTokenList& tokens);
 };
 
 #endif // INVENTORY_H
@@ -6,9 +6,90 @@
 #include <QColor>
 #include <QStyleFactory>
 #include <QSurfaceFormat>
+#include <QCoreApplication>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <stdio.h>
+#include "datextractor.h"
+
+/**
+ * Checks whether the bulk extraction mode was requested. This must be done before any
+ * application object is created, since extraction must not require a display.
+ */
+static bool extractModeRequested(int argc, char *argv[])
+{
+    bool requested = false;
+
+    for (int argIdx = 1; argIdx < argc; argIdx++)
+    {
+        if ((qstrcmp(argv[argIdx], "--extract") == 0) || (qstrncmp(argv[argIdx], "--extract=", 10) == 0))
+        {
+            requested = true;
+        }
+    }
+
+    return requested;
+}
+
+/**
+ * Extracts and decompresses every file in the game's DAT containers to the directory
+ * provided with the --extract option, without creating any GUI objects.
+ */
+static int runExtraction(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    a.setApplicationVersion(QString("%1.%2.%3")
+                            .arg(NRE_VER_MAJOR)
+                            .arg(NRE_VER_MINOR)
+                            .arg(NRE_VER_PATCH));
+    a.setApplicationName("Nomad Resource Explorer");
+
+    QCommandLineParser parser;
+    QCommandLineOption extractOption("extract", "Extract all files from the DAT containers into <outputdir>, then exit.", "outputdir");
+    parser.setApplicationDescription("Graphical browser for the resource files from the 1993 DOS game 'Nomad'");
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addOption(extractOption);
+    parser.addPositionalArgument("gamedir", "Directory containing game data files");
+
+    parser.process(a);
+    const QStringList args = parser.positionalArguments();
+    const QString gameDir = (args.size() > 0) ? args[0] : QString(".");
+    const QString outputDir = parser.value(extractOption);
+
+    if (outputDir.isEmpty())
+    {
+        fprintf(stderr, "Error: --extract requires an output directory.\n");
+        return 1;
+    }
+
+    DatLibrary lib;
+    if (!lib.openData(gameDir))
+    {
+        fprintf(stderr, "Error: not all DAT containers could be opened from '%s'.\n", qPrintable(gameDir));
+        return 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    DatExtractor extractor(lib);
+    const bool status = extractor.extractAll(outputDir);
+
+    printf("Extracted %d files (%lld bytes) to '%s' in %lld ms; %d failed.\n",
+           extractor.getFilesWritten(), extractor.getBytesWritten(), qPrintable(outputDir),
+           timer.elapsed(), extractor.getFilesFailed());
+
+    return status ? 0 : 1;
+}
 
 int main(int argc, char *argv[])
 {
+    if (extractModeRequested(argc, argv))
+    {
+        return runExtraction(argc, argv);
+    }
+
     QApplication a(argc, argv);
 
     a.setStyle(QStyleFactory::create("Fusion"));
@@ -42,6 +123,7 @@ int main(int argc, char *argv[])
     parser.setApplicationDescription("Graphical browser for the resource files from the 1993 DOS game 'Nomad'");
     parser.addHelpOption();
     parser.addVersionOption();
+    parser.addOption(QCommandLineOption("extract", "Extract all files from the DAT containers into <outputdir>, then exit.", "outputdir"));
     parser.addPositionalArgument("gamedir", "Directory containing game data files");
 
     parser.process(a);
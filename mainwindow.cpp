@@ -19,11 +19,35 @@
 #include <QBrush>
 #include <QMessageBox>
 #include <QDir>
+#include <QLoggingCategory>
+#include <QtConcurrent/QtConcurrentRun>
+#include <QStandardPaths>
 #include "enums.h"
 #include "tablenumberitem.h"
+#include "shipmodeldata.h"
+#include "gifwriter.h"
 
 #define ICON_PATH ":/icon/icon/nre-48x48.png"
 
+//! Number of rows on either side of the selected alien whose animations are prefetched
+#define ALIEN_PREFETCH_ROWS 2
+
+//! Name of the file (in the user's cache directory) that the dialogue cross-reference is saved to
+#define DIALOGUE_XREF_CACHE_FILENAME "dialogue-xref.dat"
+
+//! Name of the file (in the user's cache directory) that the text search index is saved to
+#define TEXT_SEARCH_INDEX_CACHE_FILENAME "text-search-index.dat"
+
+//! Name of the directory (in the user's cache directory) that decompressed DAT entries are kept in
+#define ASSET_CACHE_DIRNAME "assets"
+
+//! Maximum number of text search hits that are listed
+#define TEXT_SEARCH_MAX_HITS 200
+
+// timing of each stage of opening a game directory and populating the tabs; these messages
+// can be hidden with QT_LOGGING_RULES="nre.startup=false"
+Q_LOGGING_CATEGORY(lcStartup, "nre.startup", QtInfoMsg)
+
 MainWindow::MainWindow(QString gameDir, QWidget *parent) :
   QMainWindow(parent),
   ui(new Ui::MainWindow),
@@ -42,7 +66,11 @@ MainWindow::MainWindow(QString gameDir, QWidget *parent) :
   m_fullscreenImages(m_lib, m_palette),
   m_stamps(m_lib, m_palette),
   m_convText(m_lib, m_aliens, m_gametext),
+  m_dialogueXref(m_lib, m_convText),
+  m_searchIndex(m_lib),
   m_missions(m_lib, m_gametext),
+  m_pendingAlienFrameId(-1),
+  m_dataOpen(false),
   m_currentNNVSoundCount(0),
   m_currentNNVSoundId(-1),
   m_currentNNVFilename(""),
@@ -64,6 +92,25 @@ MainWindow::MainWindow(QString gameDir, QWidget *parent) :
   setupTimer();
   clearAllResourceLabels();
   connectGLViewerSliders();
+  connect(&m_alienFrameWatcher, SIGNAL(finished()), this, SLOT(onAlienFramesLoaded()));
+  connect(&m_dialogueXrefWatcher, SIGNAL(finished()), this, SLOT(onDialogueXrefLoaded()));
+  connect(&m_searchIndexWatcher, SIGNAL(finished()), this, SLOT(onSearchIndexLoaded()));
+
+  m_tableLoader.addTable(&m_places);
+  m_tableLoader.addTable(&m_invObject);
+  m_tableLoader.addTable(&m_aliens);
+  m_tableLoader.addTable(&m_ships);
+  m_tableLoader.addTable(&m_shipClasses);
+  m_tableLoader.addTable(&m_facts);
+  m_tableLoader.addTable(&m_missions);
+
+  // the larger DAT entries are only decompressed once, and then read back from
+  // the cache in later sessions (until the DAT files change)
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (!cacheDir.isEmpty())
+  {
+    m_lib.setDiskCacheDirectory(cacheDir + "/" + ASSET_CACHE_DIRNAME);
+  }
 
   if (!gameDir.isEmpty())
   {
@@ -73,6 +120,10 @@ MainWindow::MainWindow(QString gameDir, QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+  // the background loads use this window's members and the DAT containers, and their
+  // watchers don't wait for them when they're destroyed, so they have to finish first
+  clearData();
+
   delete m_audioOutput;
   delete m_aboutBox;
   delete ui;
@@ -157,7 +208,20 @@ void MainWindow::clearPlaceLabels()
  */
 void MainWindow::clearData()
 {
-  m_lib.closeData();
+  // the background loads read from the DAT containers, so they have to finish before
+  // the containers are closed (and their results are no longer wanted)
+  foreach (QFutureWatcher<FileTreeContents>* watcher, m_fileTreeLoads.keys())
+  {
+    watcher->waitForFinished();
+    delete watcher;
+  }
+  m_fileTreeLoads.clear();
+  m_tableLoader.waitForFinished();
+  m_dialogueXrefWatcher.waitForFinished();
+  m_searchIndexWatcher.waitForFinished();
+  m_populatedTabs.clear();
+  m_dataOpen = false;
+
   m_invObject.clear();
   m_places.clear();
   m_palette.clear();
@@ -168,8 +232,25 @@ void MainWindow::clearData()
   m_inventory.clear();
   m_facts.clear();
   m_missions.clear();
+  m_convText.clear();
+  m_dialogueXref.clear();
+  m_gametext.clear();
+  ui->m_convXrefTypeCombo->setEnabled(false);
+  ui->m_convXrefThingCombo->setEnabled(false);
+  ui->m_convXrefThingCombo->clear();
+  ui->m_convXrefTable->setEnabled(false);
+  ui->m_convXrefTable->setRowCount(0);
+  m_searchIndex.clear();
+  ui->m_textSearchEdit->setEnabled(false);
+  ui->m_textSearchTable->setRowCount(0);
+  ui->m_textSearchStatusLabel->clear();
+
+  // the tables above may hold views into the DAT containers, so the containers
+  // are only closed once the tables have let go of them
+  m_lib.closeData();
 
   m_alienFrames.clear();
+  m_pendingAlienFrameId = -1;
   m_stampImages.clear();
 
   m_fullscreenScene.clear();
@@ -181,25 +262,167 @@ void MainWindow::clearData()
 
 /**
  * Opens a new game data directory and sets up the form widgets the display the new data.
+ * Only the tab that is currently visible is populated right away; each of the others is
+ * populated the first time it is shown.
  */
 void MainWindow::openNewData(const QString gameDir)
 {
+  m_openTimer.start();
   clearData();
   ui->statusBar->showMessage(QString("Using directory: %1").arg(gameDir));
 
   m_lib.openData(gameDir);
-  populatePlaceWidgets();
-  populateObjectWidgets();
-  populateAlienWidgets();
-  populateShipWidgets();
-  populateAudioWidgets();
-  populateFactWidgets();
-  populateFullscreenLbmWidgets();
-  populateStampWidgets();
-  populateConversationWidgets();
-  populateMissionWidgets();
-  populate3dModelWidgets();
-  populatePaletteWidgets();
+  m_dataOpen = true;
+  qCInfo(lcStartup, "Opened data files in '%s': %lld ms", qPrintable(gameDir), m_openTimer.elapsed());
+
+  // all of the data tables are parsed in the background, and the tabs
+  // that show them only wait for the tables that they need
+  m_tableLoader.start();
+
+  // the text search index is built from the dialogue cross-reference, so it's
+  // started once the cross-reference is ready
+  startDialogueXrefLoad();
+
+  populateTab(ui->m_tabs->currentWidget());
+
+  // the event loop only gets back to this timer once the window has been repainted
+  QTimer::singleShot(0, this, SLOT(onFirstPaintAfterOpen()));
+}
+
+/**
+ * Logs the time taken from the start of opening a game directory until the window was
+ * repainted with the first populated tab.
+ */
+void MainWindow::onFirstPaintAfterOpen()
+{
+  qCInfo(lcStartup, "Window ready after opening data: %lld ms", m_openTimer.elapsed());
+}
+
+/**
+ * Responds to a different tab being selected by populating it, if it hasn't been yet.
+ */
+void MainWindow::on_m_tabs_currentChanged(int index)
+{
+  populateTab(ui->m_tabs->widget(index));
+}
+
+/**
+ * Populates the widgets on the specified tab with the contents of the game data, unless
+ * that has already been done since the data was opened.
+ */
+void MainWindow::populateTab(QWidget* tab)
+{
+  if (m_dataOpen && tab && !m_populatedTabs.contains(tab))
+  {
+    QElapsedTimer stageTimer;
+    stageTimer.start();
+    m_populatedTabs.insert(tab);
+
+    if (tab == ui->m_tabShips)
+    {
+      populateShipWidgets();
+    }
+    else if (tab == ui->m_tabPlaces)
+    {
+      populatePlaceWidgets();
+    }
+    else if (tab == ui->m_tabAliens)
+    {
+      populateAlienWidgets();
+    }
+    else if (tab == ui->m_tabObjects)
+    {
+      populateObjectWidgets();
+    }
+    else if (tab == ui->m_tabFacts)
+    {
+      populateFactWidgets();
+    }
+    else if (tab == ui->m_tabSounds)
+    {
+      populateAudioWidgets();
+    }
+    else if (tab == ui->m_tabFullscreen)
+    {
+      populateFullscreenLbmWidgets();
+    }
+    else if (tab == ui->m_tabStamps)
+    {
+      populateStampWidgets();
+    }
+    else if (tab == ui->m_convTab)
+    {
+      populateConversationWidgets();
+    }
+    else if (tab == ui->m_tabMissions)
+    {
+      populateMissionWidgets();
+    }
+    else if (tab == ui->m_tab3dModels)
+    {
+      populate3dModelWidgets();
+    }
+    else if (tab == ui->m_tabPalettes)
+    {
+      populatePaletteWidgets();
+    }
+
+    qCInfo(lcStartup, "Populated tab '%s': %lld ms",
+           qPrintable(ui->m_tabs->tabText(ui->m_tabs->indexOf(tab))), stageTimer.elapsed());
+  }
+}
+
+/**
+ * Clears the provided tree widget and starts listing the files that it will show, using the
+ * provided function, on a background thread. The tree is disabled until the list is ready.
+ * (The listing functions only read from the DAT library, which is safe to do from any thread.)
+ */
+void MainWindow::loadFileTree(QTreeWidget* tree, FileTreeContents (MainWindow::*listFunction)())
+{
+  tree->clear();
+  tree->setEnabled(false);
+
+  QFutureWatcher<FileTreeContents>* watcher = new QFutureWatcher<FileTreeContents>(this);
+  connect(watcher, SIGNAL(finished()), this, SLOT(onFileTreeLoaded()));
+  m_fileTreeLoads.insert(watcher, tree);
+  watcher->setFuture(QtConcurrent::run(this, listFunction));
+}
+
+/**
+ * Responds to one of the background file listings being completed by filling in its tree.
+ */
+void MainWindow::onFileTreeLoaded()
+{
+  QFutureWatcher<FileTreeContents>* watcher = static_cast<QFutureWatcher<FileTreeContents>*>(sender());
+
+  if (m_fileTreeLoads.contains(watcher))
+  {
+    QTreeWidget* tree = m_fileTreeLoads.take(watcher);
+    const FileTreeContents contents = watcher->result();
+
+    foreach (DatFileType dat, contents.keys())
+    {
+      if (contents[dat].size() > 0)
+      {
+        QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(tree);
+        datTreeParent->setText(0, m_lib.s_datFileNames[dat]);
+
+        foreach (const QStringList& columns, contents[dat])
+        {
+          QTreeWidgetItem* child = new QTreeWidgetItem(columns);
+          datTreeParent->addChild(child);
+        }
+      }
+    }
+
+    tree->expandAll();
+    tree->resizeColumnToContents(0);
+    tree->setEnabled(true);
+
+    qCInfo(lcStartup, "Loaded file list for '%s' after opening data: %lld ms",
+           qPrintable(tree->objectName()), m_openTimer.elapsed());
+    watcher->deleteLater();
+  }
 }
 
 /**
@@ -293,7 +516,7 @@ void MainWindow::on_actionOpen_game_data_dir_triggered()
  */
 void MainWindow::onExit()
 {
-  m_lib.closeData();
+  clearData();
   this->close();
 }
 
@@ -420,30 +643,28 @@ void MainWindow::populateFactWidgets()
  */
 void MainWindow::populateAudioWidgets()
 {
-  ui->m_soundTree->clear();
+  loadFileTree(ui->m_soundTree, &MainWindow::listSoundFiles);
+}
+
+/**
+ * Lists the NNV files in each DAT container, along with the number of sounds in each one.
+ * Since this reads every NNV file, it is done on a background thread.
+ */
+MainWindow::FileTreeContents MainWindow::listSoundFiles()
+{
+  FileTreeContents contents;
 
   const QMap<DatFileType,QStringList> nnvList = m_audio.getAllSoundList();
   foreach (DatFileType dat, nnvList.keys())
   {
-    if (nnvList[dat].size() > 0)
+    foreach (QString nnvFilename, nnvList[dat])
     {
-      const QString datFilename = m_lib.s_datFileNames[dat];
-      QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(ui->m_soundTree);
-      datTreeParent->setText(0, datFilename);
-
-      foreach (QString nnvFilename, nnvList[dat])
-      {
-        QTreeWidgetItem* nnvChild = new QTreeWidgetItem();
-        const int numSounds = m_audio.getNumberOfSoundsInNNV(dat, nnvFilename);
-        nnvChild->setText(0, nnvFilename);
-        nnvChild->setText(1, QString("%1").arg(numSounds));
-        datTreeParent->addChild(nnvChild);
-      }
+      const int numSounds = m_audio.getNumberOfSoundsInNNV(dat, nnvFilename);
+      contents[dat].append(QStringList() << nnvFilename << QString("%1").arg(numSounds));
     }
   }
 
-  ui->m_soundTree->expandAll();
-  ui->m_soundTree->resizeColumnToContents(0);
+  return contents;
 }
 
 /**
@@ -451,27 +672,15 @@ void MainWindow::populateAudioWidgets()
  */
 void MainWindow::populateFullscreenLbmWidgets()
 {
-  ui->m_fullscreenTree->clear();
-  const QMap<DatFileType,QStringList> lbmList = m_fullscreenImages.getAllLbmList();
-  foreach (DatFileType dat, lbmList.keys())
-  {
-    if (lbmList[dat].size() > 0)
-    {
-      const QString datFilename = m_lib.s_datFileNames[dat];
-      QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(ui->m_fullscreenTree);
-      datTreeParent->setText(0, datFilename);
-
-      foreach (QString lbmFilename, lbmList[dat])
-      {
-        QTreeWidgetItem* lbmChild = new QTreeWidgetItem();
-        lbmChild->setText(0, lbmFilename);
-        datTreeParent->addChild(lbmChild);
-      }
-    }
-  }
+  loadFileTree(ui->m_fullscreenTree, &MainWindow::listLbmFiles);
+}
 
-  ui->m_fullscreenTree->expandAll();
-  ui->m_fullscreenTree->resizeColumnToContents(0);
+/**
+ * Lists the fullscreen image (LBM) files in each DAT container.
+ */
+MainWindow::FileTreeContents MainWindow::listLbmFiles()
+{
+  return fileTreeContents(m_fullscreenImages.getAllLbmList());
 }
 
 /**
@@ -479,28 +688,34 @@ void MainWindow::populateFullscreenLbmWidgets()
  */
 void MainWindow::populateStampWidgets()
 {
-  ui->m_stampTree->clear();
-  const QMap<DatFileType,QStringList> stampList = m_stamps.getAllStampsList();
+  loadFileTree(ui->m_stampTree, &MainWindow::listStampFiles);
+}
+
+/**
+ * Lists the stamp (STP and ROL) image files in each DAT container.
+ */
+MainWindow::FileTreeContents MainWindow::listStampFiles()
+{
+  return fileTreeContents(m_stamps.getAllStampsList());
+}
 
-  foreach (DatFileType dat, stampList.keys())
+/**
+ * Converts a list of filenames in each DAT container to the contents of a file tree,
+ * with the filename as the only column.
+ */
+MainWindow::FileTreeContents MainWindow::fileTreeContents(const QMap<DatFileType,QStringList>& fileList)
+{
+  FileTreeContents contents;
+
+  foreach (DatFileType dat, fileList.keys())
   {
-    if (stampList[dat].size() > 0)
+    foreach (QString filename, fileList[dat])
     {
-      const QString datFilename = m_lib.s_datFileNames[dat];
-      QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(ui->m_stampTree);
-      datTreeParent->setText(0, datFilename);
-
-      foreach (QString stampFilename, stampList[dat])
-      {
-        QTreeWidgetItem* stampChild = new QTreeWidgetItem();
-        stampChild->setText(0, stampFilename);
-        datTreeParent->addChild(stampChild);
-      }
+      contents[dat].append(QStringList(filename));
     }
   }
 
-  ui->m_stampTree->expandAll();
-  ui->m_stampTree->resizeColumnToContents(0);
+  return contents;
 }
 
 /**
@@ -526,6 +741,238 @@ void MainWindow::populateConversationWidgets()
   ui->m_convAlienTable->resizeRowsToContents();
 }
 
+/**
+ * Starts loading the dialogue cross-reference on a background thread. It is loaded from the
+ * cache file if that was saved from the same game data, and is otherwise built from all of the
+ * conversation files (and then saved.) The reverse lookup panel is enabled once it's ready.
+ */
+void MainWindow::startDialogueXrefLoad()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+  if (cacheDir.isEmpty())
+  {
+    m_dialogueXrefWatcher.setFuture(QtConcurrent::run(&m_dialogueXref, &DialogueXref::build));
+  }
+  else
+  {
+    const QString cacheFilename = cacheDir + "/" + DIALOGUE_XREF_CACHE_FILENAME;
+    m_dialogueXrefWatcher.setFuture(QtConcurrent::run(&m_dialogueXref, &DialogueXref::loadOrBuild, cacheFilename));
+  }
+}
+
+/**
+ * Responds to the dialogue cross-reference being loaded by enabling the reverse lookup panel,
+ * and starting to load the text search index (which is still built if the cross-reference
+ * couldn't be, only without any dialogue.)
+ */
+void MainWindow::onDialogueXrefLoaded()
+{
+  if (m_dataOpen)
+  {
+    if (m_dialogueXrefWatcher.result())
+    {
+      qCInfo(lcStartup, "Dialogue cross-reference ready: %lld ms", m_openTimer.elapsed());
+
+      ui->m_convXrefTypeCombo->setEnabled(true);
+      ui->m_convXrefThingCombo->setEnabled(true);
+      ui->m_convXrefTable->setEnabled(true);
+      populateXrefThingCombo();
+    }
+
+    startSearchIndexLoad();
+  }
+}
+
+/**
+ * Starts loading the text search index on a background thread. It is loaded from the cache
+ * file if that was saved from the same game data, and is otherwise built from the text of
+ * every fact, mission, object, and line of dialogue (and then saved.) The search box is
+ * enabled once it's ready. The documents are collected here, on the UI thread, since the
+ * data tables' getters are also called from the UI thread and may not be called from a
+ * worker at the same time.
+ */
+void MainWindow::startSearchIndexLoad()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  const QString cacheFilename = cacheDir.isEmpty() ? QString() : (cacheDir + "/" + TEXT_SEARCH_INDEX_CACHE_FILENAME);
+
+  m_searchIndexWatcher.setFuture(QtConcurrent::run(this, &MainWindow::loadSearchIndex, cacheFilename, getSearchDocuments()));
+}
+
+/**
+ * Loads the text search index from the provided cache file, or builds it from the provided
+ * documents and saves it to that file if it can't be loaded. An empty filename skips the
+ * cache. This runs on a worker thread, and only uses the search index itself.
+ * @return True if the index was loaded or built; false otherwise.
+ */
+bool MainWindow::loadSearchIndex(const QString cacheFilename, const QVector<TextSearchDoc> docs)
+{
+  bool status = !cacheFilename.isEmpty() && m_searchIndex.load(cacheFilename);
+
+  if (!status)
+  {
+    status = m_searchIndex.build(docs);
+
+    // failing to save only means that the index will be built again next time
+    if (status && !cacheFilename.isEmpty() && QDir().mkpath(QFileInfo(cacheFilename).absolutePath()))
+    {
+      m_searchIndex.save(cacheFilename);
+    }
+  }
+
+  return status;
+}
+
+/**
+ * Collects the plain text of every fact, mission, object, and line of dialogue, along with the
+ * names of the aliens, places, and ships, as documents for the text search index.
+ */
+QVector<TextSearchDoc> MainWindow::getSearchDocuments()
+{
+  QVector<TextSearchDoc> docs;
+
+  foreach (const Fact& f, m_facts.getList().values())
+  {
+    addSearchDocument(docs, TextSourceType_Fact, f.id, 0, f.text);
+  }
+
+  const QMap<int,Mission> missions = m_missions.getList();
+  foreach (int missionId, missions.keys())
+  {
+    addSearchDocument(docs, TextSourceType_Mission, missionId, 0,
+                      m_missions.getMissionPlainText(missions[missionId].startTextOffset));
+    addSearchDocument(docs, TextSourceType_Mission, missionId, 1,
+                      m_missions.getMissionPlainText(missions[missionId].completeTextOffset));
+  }
+
+  foreach (const InventoryObj& obj, m_invObject.getList().values())
+  {
+    addSearchDocument(docs, TextSourceType_ObjectName, obj.id, 0, obj.name);
+    addSearchDocument(docs, TextSourceType_ObjectText, obj.id, 0, m_invObject.getObjectPlainText(obj.id));
+  }
+
+  foreach (const Alien& a, m_aliens.getList().values())
+  {
+    addSearchDocument(docs, TextSourceType_AlienName, a.id, 0, a.name);
+  }
+
+  foreach (const Place& p, m_places.getPlaceList().values())
+  {
+    addSearchDocument(docs, TextSourceType_PlaceName, p.id, 0, p.name);
+  }
+
+  foreach (const Ship& ship, m_ships.getList().values())
+  {
+    addSearchDocument(docs, TextSourceType_ShipName, ship.id, 0, ship.name);
+  }
+
+  for (int lineIdx = 0; lineIdx < m_dialogueXref.getLineCount(); lineIdx++)
+  {
+    const DialogueLine& line = m_dialogueXref.getLine(lineIdx);
+    addSearchDocument(docs, TextSourceType_AlienLine, line.speakerId, line.tableType, line.plainText);
+  }
+
+  return docs;
+}
+
+/**
+ * Appends a document to the provided list, unless its text is empty.
+ */
+void MainWindow::addSearchDocument(QVector<TextSearchDoc>& docs, TextSourceType source, int id, int subId, const QString& text)
+{
+  if (!text.isEmpty())
+  {
+    TextSearchDoc doc;
+    doc.source = source;
+    doc.id = id;
+    doc.subId = subId;
+    doc.text = text;
+    docs.append(doc);
+  }
+}
+
+/**
+ * Responds to the text search index being loaded by enabling the search box, and
+ * running the search that has already been typed into it (if any.)
+ */
+void MainWindow::onSearchIndexLoaded()
+{
+  if (m_dataOpen && m_searchIndexWatcher.result())
+  {
+    qCInfo(lcStartup, "Text search index ready: %lld ms", m_openTimer.elapsed());
+
+    ui->m_textSearchEdit->setEnabled(true);
+    on_m_textSearchEdit_textChanged(ui->m_textSearchEdit->text());
+  }
+}
+
+/**
+ * Lists the text search hits for the words in the search box, in descending order of relevance.
+ */
+void MainWindow::on_m_textSearchEdit_textChanged(const QString& arg1)
+{
+  ui->m_textSearchTable->setRowCount(0);
+  ui->m_textSearchStatusLabel->clear();
+
+  if (!m_searchIndex.isEmpty() && !arg1.trimmed().isEmpty())
+  {
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+    const QVector<TextSearchHit> hits = m_searchIndex.search(arg1, TEXT_SEARCH_MAX_HITS);
+    const qint64 searchTime = searchTimer.elapsed();
+
+    ui->m_textSearchTable->setRowCount(hits.size());
+    for (int hitIdx = 0; hitIdx < hits.size(); hitIdx++)
+    {
+      const TextSearchDoc& doc = m_searchIndex.getDocument(hits[hitIdx].docIndex);
+      ui->m_textSearchTable->setItem(hitIdx, 0, new QTableWidgetItem(getTextSourceDescription(doc)));
+      ui->m_textSearchTable->setItem(hitIdx, 1, new QTableWidgetItem(doc.text));
+    }
+
+    ui->m_textSearchStatusLabel->setText((hits.size() < TEXT_SEARCH_MAX_HITS) ?
+                                         QString("%1 hits (%2 ms)").arg(hits.size()).arg(searchTime) :
+                                         QString("First %1 hits (%2 ms)").arg(hits.size()).arg(searchTime));
+  }
+
+  ui->m_textSearchTable->resizeColumnToContents(0);
+  ui->m_textSearchTable->resizeRowsToContents();
+}
+
+/**
+ * Returns a description of where a piece of text comes from, for the text search results.
+ */
+QString MainWindow::getTextSourceDescription(const TextSearchDoc& doc)
+{
+  QString desc;
+
+  if (doc.source == TextSourceType_Fact)
+  {
+    desc = QString("Fact %1").arg(doc.id);
+  }
+  else if (doc.source == TextSourceType_Mission)
+  {
+    desc = QString("Mission %1 (%2)").arg(doc.id).arg((doc.subId == 0) ? "start" : "completion");
+  }
+  else if (doc.source == TextSourceType_AlienLine)
+  {
+    const AlienRace race = static_cast<AlienRace>(doc.id);
+    desc = QString("Dialogue: %1").arg((doc.subId == ConvTableType_Individual) ?
+                                       m_aliens.getName(doc.id) :
+                                       QString("(any %1)").arg(s_raceNames.contains(race) ? s_raceNames[race] : "(invalid)"));
+  }
+  else if ((doc.source == TextSourceType_ObjectName) || (doc.source == TextSourceType_ObjectText))
+  {
+    desc = QString("%1: %2").arg(g_textSourceTypeName[doc.source]).arg(m_invObject.getName(doc.id));
+  }
+  else
+  {
+    desc = QString("%1 %2").arg(g_textSourceTypeName[doc.source]).arg(doc.id);
+  }
+
+  return desc;
+}
+
 /**
  * Populates the mission description widgets.
  */
@@ -549,39 +996,25 @@ void MainWindow::populateMissionWidgets()
  */
 void MainWindow::populate3dModelWidgets()
 {
-  ui->m_3dModelTree->clear();
+  loadFileTree(ui->m_3dModelTree, &MainWindow::list3dModelFiles);
+}
 
-  QMap<DatFileType,QStringList> binList;
-  binList[DatFileType_TEST] = m_lib.getFilenamesByExtension(DatFileType_TEST, ".bin");
+/**
+ * Lists the 3D model (BIN) files, all of which are in TEST.DAT.
+ */
+MainWindow::FileTreeContents MainWindow::list3dModelFiles()
+{
+  FileTreeContents contents;
 
-  foreach (DatFileType dat, binList.keys())
+  foreach (QString binFilename, m_lib.getFilenamesByExtension(DatFileType_TEST, ".bin"))
   {
-    if (binList[dat].size() > 0)
+    if (ShipModelData::isModelFile(binFilename))
     {
-      const QString datFilename = m_lib.s_datFileNames[dat];
-      QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(ui->m_3dModelTree);
-      datTreeParent->setText(0, datFilename);
-
-      foreach (QString binFilename, binList[dat])
-      {
-        // there are a handful of .BIN files that aren't actually
-        // 3D models, so we manually check for those to exclude them
-        const QString binFilenameUcase = binFilename.toUpper();
-        if ((binFilenameUcase != "COMPUTER.BIN") &&
-            (binFilenameUcase != "SMFONT.BIN") &&
-            (binFilenameUcase != "LGFONT.BIN") &&
-            (binFilenameUcase != "SC200240.BIN"))
-        {
-          QTreeWidgetItem* binChild = new QTreeWidgetItem();
-          binChild->setText(0, binFilename);
-          datTreeParent->addChild(binChild);
-        }
-      }
+      contents[DatFileType_TEST].append(QStringList(binFilename));
     }
   }
 
-  ui->m_3dModelTree->expandAll();
-  ui->m_3dModelTree->resizeColumnToContents(0);
+  return contents;
 }
 
 /**
@@ -589,28 +1022,15 @@ void MainWindow::populate3dModelWidgets()
  */
 void MainWindow::populatePaletteWidgets()
 {
-  ui->m_paletteTree->clear();
-
-  const QMap<DatFileType,QStringList> palList = m_palette.getAllPaletteList();
-  foreach (DatFileType dat, palList.keys())
-  {
-    if (palList[dat].size() > 0)
-    {
-      const QString datFilename = m_lib.s_datFileNames[dat];
-      QTreeWidgetItem* datTreeParent = new QTreeWidgetItem(ui->m_paletteTree);
-      datTreeParent->setText(0, datFilename);
-
-      foreach (QString palFilename, palList[dat])
-      {
-        QTreeWidgetItem* palChild = new QTreeWidgetItem();
-        palChild->setText(0, palFilename);
-        datTreeParent->addChild(palChild);
-      }
-    }
-  }
+  loadFileTree(ui->m_paletteTree, &MainWindow::listPaletteFiles);
+}
 
-  ui->m_paletteTree->expandAll();
-  ui->m_paletteTree->resizeColumnToContents(0);
+/**
+ * Lists the palette (PAL) files in each DAT container.
+ */
+MainWindow::FileTreeContents MainWindow::listPaletteFiles()
+{
+  return fileTreeContents(m_palette.getAllPaletteList());
 }
 
 /**
@@ -793,7 +1213,7 @@ void MainWindow::on_m_alienTable_currentCellChanged(int currentRow, int currentC
   Q_UNUSED(previousColumn)
 
   m_alienFrames.clear();
-  m_aliens.clear();
+  m_pendingAlienFrameId = -1;
   const QTableWidgetItem* const selectedItem = ui->m_alienTable->item(currentRow, 0);
 
   if (selectedItem)
@@ -803,21 +1223,84 @@ void MainWindow::on_m_alienTable_currentCellChanged(int currentRow, int currentC
     Alien a;
     if (m_aliens.getAlien(id, a))
     {
-      if (m_aliens.getAnimationFrames(id, m_alienFrames) && (m_alienFrames.count() > 0))
+      // the frames are decoded in the background (unless they're already cached),
+      // so that moving through the table never waits on the decoding
+      const QFuture<void> frameLoad = m_aliens.requestAnimationFrames(id);
+
+      if (frameLoad.isFinished())
       {
-        ui->m_alienFrameSlider->setEnabled(true);
-        ui->m_alienFrameSlider->setMaximum(m_alienFrames.count() - 1);
-        ui->m_alienFrameSlider->setSliderPosition(0);
-        loadAlienFrame(0);
+        showAlienFrames(id);
       }
       else
       {
-        ui->m_alienFrameSlider->setMaximum(63);
-        ui->m_alienFrameSlider->setEnabled(false);
-        m_alienScene.clear();
-        ui->m_alienView->setScene(&m_alienScene);
+        m_pendingAlienFrameId = id;
+        showAlienFrames(-1);
+        m_alienFrameWatcher.setFuture(frameLoad);
       }
     }
+
+    prefetchAlienFrames(currentRow);
+  }
+}
+
+/**
+ * Responds to the background decoding of an alien's animation frames being completed by
+ * displaying them, if that alien is still the one selected.
+ */
+void MainWindow::onAlienFramesLoaded()
+{
+  if (m_pendingAlienFrameId >= 0)
+  {
+    showAlienFrames(m_pendingAlienFrameId);
+    m_pendingAlienFrameId = -1;
+  }
+}
+
+/**
+ * Displays the first frame of the specified alien's animation (which must already have been
+ * decoded) and sets up the frame slider. If the frames aren't available, the view is cleared.
+ */
+void MainWindow::showAlienFrames(int alienId)
+{
+  m_alienFrames.clear();
+
+  if (m_aliens.getCachedAnimationFrames(alienId, m_alienFrames) && (m_alienFrames.count() > 0))
+  {
+    ui->m_alienFrameSlider->setEnabled(true);
+    ui->m_alienMakeGif->setEnabled(true);
+    ui->m_alienFrameSlider->setMaximum(m_alienFrames.count() - 1);
+    ui->m_alienFrameSlider->setSliderPosition(0);
+    loadAlienFrame(0);
+  }
+  else
+  {
+    ui->m_alienFrameSlider->setMaximum(63);
+    ui->m_alienFrameSlider->setEnabled(false);
+    ui->m_alienMakeGif->setEnabled(false);
+    m_alienScene.clear();
+    ui->m_alienView->setScene(&m_alienScene);
+  }
+}
+
+/**
+ * Starts decoding the animations for the aliens in the rows near the selected one, so that
+ * they are likely to be ready by the time they are selected.
+ */
+void MainWindow::prefetchAlienFrames(int currentRow)
+{
+  for (int offset = 1; offset <= ALIEN_PREFETCH_ROWS; offset++)
+  {
+    const QTableWidgetItem* const nextItem = ui->m_alienTable->item(currentRow + offset, 0);
+    const QTableWidgetItem* const prevItem = ui->m_alienTable->item(currentRow - offset, 0);
+
+    if (nextItem)
+    {
+      m_aliens.requestAnimationFrames(nextItem->text().toInt());
+    }
+    if (prevItem)
+    {
+      m_aliens.requestAnimationFrames(prevItem->text().toInt());
+    }
   }
 }
 
@@ -829,6 +1312,38 @@ void MainWindow::on_m_alienFrameSlider_valueChanged(int value)
   loadAlienFrame(value);
 }
 
+/**
+ * Prompts for a target filename and saves the selected alien's animation as a .GIF file.
+ */
+void MainWindow::on_m_alienMakeGif_clicked()
+{
+  const QTableWidgetItem* const selectedItem = ui->m_alienTable->item(ui->m_alienTable->currentRow(), 0);
+
+  if (selectedItem && !m_alienFrames.isEmpty())
+  {
+    const QString anmFilename = Aliens::getAnmFilename(selectedItem->text().toInt());
+    const QString defaultGifName = QString("%1/%2.gif").arg(QDir::currentPath())
+                                                       .arg(QFileInfo(anmFilename).completeBaseName())
+                                                       .toLower();
+
+    QString saveName = QFileDialog::getSaveFileName(this, "Select output .GIF file name", defaultGifName, "GIF images (*.gif)");
+    if (!saveName.isEmpty())
+    {
+      QDir::setCurrent(QFileInfo(saveName).absolutePath());
+      if (!saveName.contains('.'))
+      {
+        saveName += ".gif";
+      }
+
+      GifWriter gif;
+      if (!gif.write(saveName, m_alienFrames.values().toVector()))
+      {
+        QMessageBox::warning(this, "Error", "Failed to write the animation to the output file.");
+      }
+    }
+  }
+}
+
 /**
  * Loads and displays a single alien animation frame.
  */
@@ -1245,6 +1760,9 @@ void MainWindow::populateTopicTableForCategory(ConvTopicCategory category, QMap<
   // (b) the user has deselected the checkbox that filters the list down to the interesting topics
   const bool alwaysAddAllTopics = ((alienId == 0) || (ui->m_convFilterTopicsCheckbox->checkState() == Qt::Unchecked));
 
+  // the table would otherwise re-sort itself after every cell is added
+  ui->m_convTopicTable->setSortingEnabled(false);
+
   foreach (int topicId, topicList.keys())
   {
     if (alwaysAddAllTopics || m_convText.doesInterestingDialogExist(alienId, category, topicId))
@@ -1256,6 +1774,7 @@ void MainWindow::populateTopicTableForCategory(ConvTopicCategory category, QMap<
       ui->m_convTopicTable->setItem(rowcount, 1, new QTableWidgetItem(topicList[topicId]));
     }
   }
+  ui->m_convTopicTable->setSortingEnabled(true);
   ui->m_convTopicTable->resizeColumnToContents(0);
   ui->m_convTopicTable->resizeRowsToContents();
 
@@ -1467,6 +1986,151 @@ void MainWindow::on_m_convDialogueLine_anchorClicked(const QUrl& arg1)
   showAnchorTooltip(arg1);
 }
 
+/**
+ * Responds to a different kind of entity being chosen in the reverse lookup panel.
+ */
+void MainWindow::on_m_convXrefTypeCombo_currentIndexChanged(int index)
+{
+  Q_UNUSED(index)
+
+  if (!m_dialogueXref.isEmpty())
+  {
+    populateXrefThingCombo();
+  }
+}
+
+/**
+ * Responds to a different entity being chosen in the reverse lookup panel.
+ */
+void MainWindow::on_m_convXrefThingCombo_currentIndexChanged(int index)
+{
+  Q_UNUSED(index)
+  populateXrefTable();
+}
+
+/**
+ * Shows the line of dialogue (and the commands embedded in it) for the
+ * selected row of the reverse lookup table.
+ */
+void MainWindow::on_m_convXrefTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn)
+{
+  Q_UNUSED(currentColumn)
+  Q_UNUSED(previousRow)
+  Q_UNUSED(previousColumn)
+
+  const QTableWidgetItem* const speakerItem = ui->m_convXrefTable->item(currentRow, 0);
+  if (speakerItem && !m_dialogueXref.isEmpty())
+  {
+    const DialogueLine& line = m_dialogueXref.getLine(speakerItem->data(Qt::UserRole).toInt());
+    QVector<QPair<GTxtCmd,int> > embeddedCommands = line.commands;
+
+    clearDialogLineAndCommandList();
+    ui->m_convDialogueLine->setHtml(line.text);
+    populateGameTextCommandList(ui->m_convCommandList, embeddedCommands);
+  }
+}
+
+/**
+ * Fills the second combo box of the reverse lookup panel with every entity of the
+ * kind chosen in the first one.
+ */
+void MainWindow::populateXrefThingCombo()
+{
+  const DialogueThingType type = static_cast<DialogueThingType>(ui->m_convXrefTypeCombo->currentIndex());
+  QMap<int,QString> names;
+
+  if (type == DialogueThingType_Alien)
+  {
+    foreach (Alien a, m_aliens.getList().values())
+    {
+      names.insert(a.id, a.name);
+    }
+  }
+  else if (type == DialogueThingType_Race)
+  {
+    for (int raceId = 0; raceId < AlienRace_NumRaces; raceId++)
+    {
+      names.insert(raceId, s_raceNames[static_cast<AlienRace>(raceId)]);
+    }
+  }
+  else if (type == DialogueThingType_Place)
+  {
+    foreach (Place p, m_places.getPlaceList().values())
+    {
+      names.insert(p.id, p.name);
+    }
+  }
+  else if (type == DialogueThingType_Object)
+  {
+    foreach (InventoryObj obj, m_invObject.getList().values())
+    {
+      names.insert(obj.id, obj.name);
+    }
+  }
+  else if (type == DialogueThingType_Fact)
+  {
+    foreach (Fact f, m_facts.getList().values())
+    {
+      names.insert(f.id, f.text);
+    }
+  }
+  else if (type == DialogueThingType_Ship)
+  {
+    foreach (Ship ship, m_ships.getList().values())
+    {
+      names.insert(ship.id, ship.name);
+    }
+  }
+
+  ui->m_convXrefThingCombo->clear();
+  foreach (int id, names.keys())
+  {
+    ui->m_convXrefThingCombo->addItem(QString("%1: %2").arg(id).arg(names[id]), id);
+  }
+}
+
+/**
+ * Fills the reverse lookup table with every line of dialogue that refers to the entity
+ * chosen in the reverse lookup panel, either as the topic of the line or through one of
+ * the commands embedded in it.
+ */
+void MainWindow::populateXrefTable()
+{
+  ui->m_convXrefTable->setRowCount(0);
+
+  if (!m_dialogueXref.isEmpty() && (ui->m_convXrefThingCombo->currentIndex() >= 0))
+  {
+    const DialogueThingType type = static_cast<DialogueThingType>(ui->m_convXrefTypeCombo->currentIndex());
+    const int thingId = ui->m_convXrefThingCombo->currentData().toInt();
+
+    foreach (const DialogueRef& ref, m_dialogueXref.getReferences(type, thingId))
+    {
+      const DialogueLine& line = m_dialogueXref.getLine(ref.lineIndex);
+      const AlienRace race = static_cast<AlienRace>(line.speakerId);
+
+      const QString speaker = (line.tableType == ConvTableType_Individual) ?
+                              m_aliens.getName(line.speakerId) :
+                              QString("(any %1)").arg(s_raceNames.contains(race) ? s_raceNames[race] : "(invalid)");
+      const QString reference = (ref.command == 0) ?
+                                g_convTopicCategoryName[ref.topic] :
+                                g_gameTextCommandName[static_cast<GTxtCmd>(ref.command)];
+
+      QTableWidgetItem* speakerItem = new QTableWidgetItem(speaker);
+      speakerItem->setData(Qt::UserRole, ref.lineIndex);
+
+      const int rowcount = ui->m_convXrefTable->rowCount();
+      ui->m_convXrefTable->insertRow(rowcount);
+      ui->m_convXrefTable->setItem(rowcount, 0, speakerItem);
+      ui->m_convXrefTable->setItem(rowcount, 1, new QTableWidgetItem(reference));
+      ui->m_convXrefTable->setItem(rowcount, 2, new QTableWidgetItem(line.plainText));
+    }
+  }
+
+  ui->m_convXrefTable->resizeColumnToContents(0);
+  ui->m_convXrefTable->resizeColumnToContents(1);
+  ui->m_convXrefTable->resizeRowsToContents();
+}
+
 /**
  * Responds to the stamp roll slider being moved by displaying the stamp at the selected index.
  */
@@ -1514,10 +2178,13 @@ void MainWindow::showInfoForMission(int id)
   QMap<int,Mission> missions = m_missions.getList();
   if (missions.contains(id))
   {
-    ui->m_missionStartText->setHtml(missions[id].startText);
-    ui->m_missionEndText->setHtml(missions[id].completeText);
-    populateGameTextCommandList(ui->m_missionStartCommandList, missions[id].startTextCommands);
-    populateGameTextCommandList(ui->m_missionEndCommandList,   missions[id].completeTextCommands);
+    QVector<QPair<GTxtCmd,int> > startTextCommands;
+    QVector<QPair<GTxtCmd,int> > completeTextCommands;
+
+    ui->m_missionStartText->setHtml(m_missions.getMissionText(missions[id].startTextOffset, startTextCommands));
+    ui->m_missionEndText->setHtml(m_missions.getMissionText(missions[id].completeTextOffset, completeTextCommands));
+    populateGameTextCommandList(ui->m_missionStartCommandList, startTextCommands);
+    populateGameTextCommandList(ui->m_missionEndCommandList,   completeTextCommands);
 
     if (missions[id].action == MissionActionType_None)
     {
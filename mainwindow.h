@@ -14,6 +14,10 @@
 #include <QLabel>
 #include <QTableWidget>
 #include <QTimer>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
+#include <QSet>
+#include <QStringList>
 #include "aboutbox.h"
 #include "datlibrary.h"
 #include "gametext.h"
@@ -30,7 +34,10 @@
 #include "fullscreenimages.h"
 #include "stampimages.h"
 #include "conversationtext.h"
+#include "dialoguexref.h"
+#include "textsearchindex.h"
 #include "missions.h"
+#include "tableloader.h"
 
 namespace Ui {
 class MainWindow;
@@ -52,10 +59,15 @@ private slots:
   void onExit();
   void onCloseDataFiles();
   void onTimer();
+  void onAlienFramesLoaded();
+  void onFileTreeLoaded();
+  void onFirstPaintAfterOpen();
+  void on_m_tabs_currentChanged(int index);
   void on_m_objTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
   void on_m_placeTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
   void on_m_alienTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
   void on_m_alienFrameSlider_valueChanged(int value);
+  void on_m_alienMakeGif_clicked();
   void on_m_soundTree_currentItemChanged(QTreeWidgetItem* current, QTreeWidgetItem* previous);
   void on_m_soundPrevButton_clicked();
   void on_m_soundPlayButton_clicked();
@@ -82,6 +94,12 @@ private slots:
   void on_actionAbout_triggered();
   void on_m_convFilterTopicsCheckbox_stateChanged(int arg1);
   void on_m_convDialogueLine_anchorClicked(const QUrl &arg1);
+  void on_m_convXrefTypeCombo_currentIndexChanged(int index);
+  void on_m_convXrefThingCombo_currentIndexChanged(int index);
+  void on_m_convXrefTable_currentCellChanged(int currentRow, int currentColumn, int previousRow, int previousColumn);
+  void onDialogueXrefLoaded();
+  void on_m_textSearchEdit_textChanged(const QString& arg1);
+  void onSearchIndexLoaded();
   void on_m_missionIdSpinBox_valueChanged(int arg1);
   void on_m_missionStartText_anchorClicked(const QUrl &arg1);
   void on_m_missionEndText_anchorClicked(const QUrl &arg1);
@@ -95,6 +113,9 @@ private slots:
   void on_m_paletteTree_currentItemChanged(QTreeWidgetItem *current, QTreeWidgetItem *previous);
 
 private:
+  //! Rows of a tree of files, grouped by DAT container; each row is a list of column texts
+  typedef QMap<DatFileType,QList<QStringList> > FileTreeContents;
+
   Ui::MainWindow *ui;
   AboutBox* m_aboutBox;
 
@@ -115,11 +136,25 @@ private:
   FullscreenImages m_fullscreenImages;
   StampImages m_stamps;
   ConversationText m_convText;
+  DialogueXref m_dialogueXref;
+  QFutureWatcher<bool> m_dialogueXrefWatcher;
+  TextSearchIndex m_searchIndex;
+  QFutureWatcher<bool> m_searchIndexWatcher;
   Missions m_missions;
+  TableLoader m_tableLoader;
 
   QMap<int,QImage> m_alienFrames;
+  QFutureWatcher<void> m_alienFrameWatcher;
+  int m_pendingAlienFrameId;
   QList<QImage> m_stampImages;
 
+  // whether a game directory has been opened, the tabs that have been populated since
+  // then, and the file trees that are being listed in the background
+  bool m_dataOpen;
+  QSet<QWidget*> m_populatedTabs;
+  QMap<QFutureWatcher<FileTreeContents>*,QTreeWidget*> m_fileTreeLoads;
+  QElapsedTimer m_openTimer;
+
   QGraphicsScene m_objScene;
   QGraphicsScene m_planetSurfaceScene;
   QGraphicsScene m_alienScene;
@@ -158,12 +193,30 @@ private:
   void populateMissionWidgets();
   void populate3dModelWidgets();
   void populatePaletteWidgets();
+  void populateTab(QWidget* tab);
+  void loadFileTree(QTreeWidget* tree, FileTreeContents (MainWindow::*listFunction)());
+  FileTreeContents listSoundFiles();
+  FileTreeContents listLbmFiles();
+  FileTreeContents listStampFiles();
+  FileTreeContents list3dModelFiles();
+  FileTreeContents listPaletteFiles();
+  static FileTreeContents fileTreeContents(const QMap<DatFileType,QStringList>& fileList);
   void loadAlienFrame(int frameId);
+  void showAlienFrames(int alienId);
+  void prefetchAlienFrames(int currentRow);
   void populateConversationTopicTable(int lastSelectedTopicId = -1);
   void populateTopicTableForCategory(ConvTopicCategory category, QMap<int,QString> topicList, int lastSelectedTopicId);
   void getConversationLinesForCurrentTopic();
   QString getNameForGameTextCommandParameter(GTxtCmd cmd, int param);
   void clearDialogLineAndCommandList();
+  void startDialogueXrefLoad();
+  void populateXrefThingCombo();
+  void populateXrefTable();
+  void startSearchIndexLoad();
+  bool loadSearchIndex(const QString cacheFilename, const QVector<TextSearchDoc> docs);
+  QVector<TextSearchDoc> getSearchDocuments();
+  static void addSearchDocument(QVector<TextSearchDoc>& docs, TextSourceType source, int id, int subId, const QString& text);
+  QString getTextSourceDescription(const TextSearchDoc& doc);
   void putResourceLabelsInArray();
   void clearAllResourceLabels();
   void clearPlaceLabels();
@@ -8,31 +8,49 @@ Missions::Missions(DatLibrary& lib, GameText& gametext) :
 
 }
 
+/**
+ * Clears locally cached data.
+ */
+void Missions::clear()
+{
+  DatTable<MissionTableEntry>::clear();
+  m_missions.clear();
+  m_misTextData.clear();
+}
+
 /**
  * Gets the list of missions read from the data file, populating it first if necessary.
  */
 QMap<int,Mission> Missions::getList()
 {
-  if (m_missions.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   return m_missions;
 }
 
 /**
  * Parses the MISSION.TAB data file to read information about Alliance mission postings.
+ * The mission text files are read once here, but the text itself is only decoded when
+ * it is requested with getMissionText().
  */
 bool Missions::populateList()
 {
   bool status = false;
+  QByteArray misTextIdxData;
+
+  if (!m_lib->getFileByName(DatFileType_CONVERSE, "MISTEXT.IDX", misTextIdxData) ||
+      !m_lib->getFileByName(DatFileType_CONVERSE, "MISTEXT.TXT", m_misTextData))
+  {
+    // the missions can still be listed without their text
+    misTextIdxData.clear();
+    m_misTextData.clear();
+  }
 
   if (openFile(DatFileType_CONVERSE, "MISSION.TAB"))
   {
     status = true;
     int index = 0;
-    MissionTableEntry* currentEntry = getEntry(index);
+    const MissionTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -58,8 +76,8 @@ bool Missions::populateList()
           m.action = MissionActionType_Unknown;
         }
         m.missionActionRawVal = currentEntry->actionRequired;
-        m.startText    = getMissionText(qFromLittleEndian<quint16>(currentEntry->startTextIndex), m.startTextCommands);
-        m.completeText = getMissionText(qFromLittleEndian<quint16>(currentEntry->completeTextIndex), m.completeTextCommands);
+        m.startTextOffset    = getMissionTextOffset(qFromLittleEndian<quint16>(currentEntry->startTextIndex), misTextIdxData, m_misTextData);
+        m.completeTextOffset = getMissionTextOffset(qFromLittleEndian<quint16>(currentEntry->completeTextIndex), misTextIdxData, m_misTextData);
         m.objectiveId  = currentEntry->objectiveId;
         m.objectiveLocation = currentEntry->placeId;
 
@@ -74,29 +92,60 @@ bool Missions::populateList()
 }
 
 /**
- * Returns the text associated with a missions at the provided index in the MISTEXT.IDX index file.
+ * Looks up the offset in MISTEXT.TXT of the mission text at the provided index in the MISTEXT.IDX
+ * index file. Returns -1 if the index or the offset that it points to is out of range.
+ */
+int Missions::getMissionTextOffset(uint16_t idxFileIndex, const QByteArray& misTextIdxData, const QByteArray& misTextData)
+{
+  int txtOffset = -1;
+  const int idxOffset = (idxFileIndex + 1) * 4;
+
+  if ((idxOffset + 4) <= misTextIdxData.size())
+  {
+    const qint32 offset = qFromLittleEndian<qint32>(misTextIdxData.constData() + idxOffset);
+    if ((offset >= 0) && (offset < misTextData.size()))
+    {
+      txtOffset = offset;
+    }
+  }
+
+  return txtOffset;
+}
+
+/**
+ * Returns the mission text at the provided offset in MISTEXT.TXT (as stored in the Mission struct.)
  * Populates the provided QVector with the list of game commands embedded in that text.
  */
-QString Missions::getMissionText(uint16_t idxFileIndex, QVector<QPair<GTxtCmd,int> >& commands)
+QString Missions::getMissionText(int textOffset, QVector<QPair<GTxtCmd,int> >& commands)
 {
-  QByteArray misTextIdxData;
-  QByteArray misTextStrData;
   QString txt;
+  commands.clear();
 
-  if (m_lib->getFileByName(DatFileType_CONVERSE, "MISTEXT.IDX", misTextIdxData) &&
-      m_lib->getFileByName(DatFileType_CONVERSE, "MISTEXT.TXT", misTextStrData))
+  load();
+  if ((textOffset >= 0) && (textOffset < m_misTextData.size()))
   {
-    const int idxOffset = (idxFileIndex + 1) * 4;
-    int32_t txtOffset = 0;
+    const int maxlen = qMin(0x1000, m_misTextData.size() - textOffset);
+    txt = m_gtext->readString(m_misTextData.constData() + textOffset, commands, false, maxlen);
+  }
 
-    memcpy(&txtOffset, misTextIdxData.data() + idxOffset, 4);
-    txtOffset = qFromLittleEndian<qint32>(txtOffset);
+  return txt;
+}
 
-    if (txtOffset < misTextStrData.size())
-    {
-      const char* rawdata = misTextStrData.data();
-      txt = m_gtext->readString(rawdata + txtOffset, commands);
-    }
+/**
+ * Returns the mission text at the provided offset in MISTEXT.TXT as plain text, without any
+ * markup (for searching.)
+ */
+QString Missions::getMissionPlainText(int textOffset)
+{
+  QString txt;
+
+  load();
+  if ((textOffset >= 0) && (textOffset < m_misTextData.size()))
+  {
+    GTxtTokenList tokens;
+    const int maxlen = qMin(0x1000, m_misTextData.size() - textOffset);
+    GameText::tokenize(m_misTextData, textOffset, tokens, maxlen);
+    txt = m_gtext->renderPlainText(tokens);
   }
 
   return txt;
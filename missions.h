@@ -23,10 +23,9 @@ struct Mission
   int missionActionRawVal;
   int objectiveId;
   int objectiveLocation;
-  QString startText;
-  QString completeText;
-  QVector<QPair<GTxtCmd,int> > startTextCommands;
-  QVector<QPair<GTxtCmd,int> > completeTextCommands;
+  //! Offsets of the mission text strings in MISTEXT.TXT (see Missions::getMissionText()), or -1 if invalid
+  int startTextOffset;
+  int completeTextOffset;
 };
 
 typedef struct __attribute__((packed)) MissionTableEntry
@@ -47,6 +46,9 @@ class Missions : public DatTable<MissionTableEntry>
 public:
   Missions(DatLibrary& lib, GameText& gametext);
   QMap<int,Mission> getList();
+  QString getMissionText(int textOffset, QVector<QPair<GTxtCmd,int> >& commands);
+  QString getMissionPlainText(int textOffset);
+  void clear();
 
 protected:
   bool populateList();
@@ -54,8 +56,9 @@ protected:
 private:
   GameText* m_gtext;
   QMap<int,Mission> m_missions;
+  QByteArray m_misTextData;
 
-  QString getMissionText(uint16_t idxFileIndex, QVector<QPair<GTxtCmd,int> >& commands);
+  static int getMissionTextOffset(uint16_t idxFileIndex, const QByteArray& misTextIdxData, const QByteArray& misTextData);
 };
 
 #endif // MISSIONS_H
@@ -82,6 +82,7 @@ Places::~Places()
  */
 void Places::clear()
 {
+  DatTable<PlaceTableEntry>::clear();
   m_placeList.clear();
 }
 
@@ -91,14 +92,11 @@ void Places::clear()
  */
 QString Places::getName(int id)
 {
-  if (m_placeList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_placeList.contains(id))
   {
-    return  m_placeList[id].name;
+    return  m_placeList.value(id).name;
   }
 
   return QString();
@@ -112,7 +110,7 @@ bool Places::populateList()
   {
     status = true;
     int index = 0;
-    PlaceTableEntry* currentEntry = getEntry(index);
+    const PlaceTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -151,10 +149,7 @@ bool Places::populateList()
  */
 QMap<int,Place> Places::getPlaceList()
 {
-  if (m_placeList.isEmpty())
-  {
-    populateList();
-  }
+  load();
   return m_placeList;
 }
 
@@ -167,15 +162,12 @@ bool Places::getPlace(int id, Place& place)
 {
   bool status = false;
 
-  if (m_placeList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_placeList.contains(id))
   {
     status = true;
-    place = m_placeList[id];
+    place = m_placeList.value(id);
   }
 
   return status;
@@ -12,15 +12,21 @@ ShipClasses::~ShipClasses()
 
 }
 
+/**
+ * Clears locally cached data.
+ */
+void ShipClasses::clear()
+{
+  DatTable<ShipClassTableEntry>::clear();
+  m_shipClasses.clear();
+}
+
 /**
  * Gets a map of all ship classes, keyed by class ID.
  */
 QMap<int,ShipClass> ShipClasses::getList()
 {
-  if (m_shipClasses.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   return m_shipClasses;
 }
@@ -38,7 +44,7 @@ bool ShipClasses::populateList()
     status = true;
     int index = 0;
 
-    ShipClassTableEntry* currentEntry = getEntry(index);
+    const ShipClassTableEntry* currentEntry = getEntry(index);
     while (currentEntry != nullptr)
     {
       if (currentEntry->nameOffset != 0xFFFF)
@@ -67,14 +73,11 @@ QString ShipClasses::getName(int id)
 {
   QString name;
 
-  if (m_shipClasses.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_shipClasses.contains(id))
   {
-    name = m_shipClasses[id].name;
+    name = m_shipClasses.value(id).name;
   }
 
   return name;
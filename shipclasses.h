@@ -33,6 +33,7 @@ public:
   virtual ~ShipClasses();
   QMap<int,ShipClass> getList();
   QString getName(int id);
+  void clear();
 
 protected:
   bool populateList();
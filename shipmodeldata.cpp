@@ -2,6 +2,8 @@
 #include <QMap>
 #include <QVector>
 #include <QtEndian>
+#include <QFile>
+#include <QFileInfo>
 
 /**
  * Number of bytes that the smallest possible polygon record will occupy
@@ -22,10 +24,30 @@ QMap<int,QColor> ShipModelData::s_modelColors =
   {7, QColor(170, 170, 170)}
 };
 
+/**
+ * List of .BIN files in the game data that aren't actually 3D models.
+ */
+const QStringList ShipModelData::s_nonModelBinFiles =
+{
+  "COMPUTER.BIN",
+  "SMFONT.BIN",
+  "LGFONT.BIN",
+  "SC200240.BIN"
+};
+
 ShipModelData::ShipModelData()
 {
 }
 
+/**
+ * Returns true if the provided .BIN filename is that of a 3D model. There are a handful of
+ * .BIN files that aren't actually 3D models, so those are checked for explicitly.
+ */
+bool ShipModelData::isModelFile(const QString& binFilename)
+{
+  return !s_nonModelBinFiles.contains(binFilename.toUpper());
+}
+
 /**
  * Parses the data read from a .BIN 3D model file and uses its data to populate
  * the internal OpenGL buffers required for rendering.
@@ -168,6 +190,48 @@ bool ShipModelData::loadData(const QByteArray& bin, QString& modelInfo)
   return status;
 }
 
+/**
+ * Writes the loaded model as a Wavefront OBJ file. Each triangle in the vertex buffer becomes
+ * one face with per-vertex normals, and the vertex colors are written as the (widely supported)
+ * RGB extension to the "v" statement.
+ * @return True if the file was written successfully; false otherwise.
+ */
+bool ShipModelData::writeObjFile(const QString filename) const
+{
+  bool status = false;
+  QFile outFile(filename);
+
+  if (outFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+  {
+    const int numVertices = vertexCount();
+    QByteArray outBuf;
+    outBuf.reserve((numVertices * 96) + 64);
+
+    outBuf.append("# ");
+    outBuf.append(QFileInfo(filename).fileName().toLatin1());
+    outBuf.append("\n");
+
+    for (int vertIdx = 0; vertIdx < numVertices; vertIdx++)
+    {
+      const GLfloat* v = m_data.constData() + (vertIdx * FLOATS_PER_VERTEX);
+      outBuf.append(QString::asprintf("v %.6f %.6f %.6f %.4f %.4f %.4f\n", v[0], v[1], v[2], v[6], v[7], v[8]).toLatin1());
+      outBuf.append(QString::asprintf("vn %.6f %.6f %.6f\n", v[3], v[4], v[5]).toLatin1());
+    }
+
+    // OBJ indices are 1-based
+    for (int faceVert = 1; (faceVert + 2) <= numVertices; faceVert += 3)
+    {
+      outBuf.append(QString::asprintf("f %d//%d %d//%d %d//%d\n",
+                                      faceVert, faceVert, faceVert + 1, faceVert + 1, faceVert + 2, faceVert + 2).toLatin1());
+    }
+
+    status = (outFile.write(outBuf) == outBuf.size());
+    outFile.close();
+  }
+
+  return status;
+}
+
 /**
  * Clears out the 3D model data to leave an empty scene.
  */
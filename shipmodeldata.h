@@ -7,6 +7,7 @@
 #include <QVector3D>
 #include <QColor>
 #include <QString>
+#include <QStringList>
 
 #define FLOATS_PER_VERTEX 9
 
@@ -31,8 +32,11 @@ public:
   }
 
   bool loadData(const QByteArray& bin, QString& modelInfo);
+  bool writeObjFile(const QString filename) const;
   void clear();
 
+  static bool isModelFile(const QString& binFilename);
+
 private:
   static int getTotalVertexCount(const QMap<int,QVector<int> >& polygons);
 
@@ -43,6 +47,7 @@ private:
   QVector<GLfloat> m_data;
   int m_count = 0;
   static QMap<int,QColor> s_modelColors;
+  static const QStringList s_nonModelBinFiles;
 };
 
 #endif // SHIPMODELDATA_H
@@ -13,16 +13,22 @@ Ships::~Ships()
 
 }
 
+/**
+ * Clears locally cached data.
+ */
+void Ships::clear()
+{
+  DatTable<ShipTableEntry>::clear();
+  m_shipList.clear();
+}
+
 /**
  * Gets a map of ship IDs to ship data structs, representing
  * all ships in the game.
  */
 QMap<int,Ship> Ships::getList()
 {
-  if (m_shipList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   return m_shipList;
 }
@@ -31,14 +37,11 @@ QString Ships::getName(int id)
 {
   QString name;
 
-  if (m_shipList.isEmpty())
-  {
-    populateList();
-  }
+  load();
 
   if (m_shipList.contains(id))
   {
-    name = m_shipList[id].name;
+    name = m_shipList.value(id).name;
   }
 
   return name;
@@ -55,7 +58,7 @@ bool Ships::populateList()
   {
     status = true;
     int index = 0;
-    ShipTableEntry* currentEntry = getEntry(index);
+    const ShipTableEntry* currentEntry = getEntry(index);
 
     while (currentEntry != nullptr)
     {
@@ -60,6 +60,7 @@ public:
   virtual ~Ships();
   QMap<int,Ship> getList();
   QString getName(int id);
+  void clear();
 
 protected:
   bool populateList();
@@ -2,11 +2,12 @@
  * Extracts files from the .DAT containers used by the 1993 space exploration
  * game "Nomad" (Gametek / Intense! / Papyrus).
  *
- * TODO:
  * Some files (fullscreen LBM images) are stored with the first four bytes
- * uncompressed, but the remainder of the file compressed. The graphical
- * Nomad Resource Explorer utility has the ability to unpack these, but
- * that capability was never rolled back into this standalone utility.
+ * uncompressed, but the remainder of the file compressed; these are detected
+ * by their index flags and the header bytes are copied through as-is.
+ *
+ * Note that the Nomad Resource Explorer can also extract every file from all
+ * of the containers in parallel, with "nomad-resource-explorer --extract <outputdir> <gamedir>".
  */
 
 #include <stdio.h>
@@ -34,7 +35,7 @@ typedef struct
 } dat_index_entry;
 
 bool decode_dat(const char* filename);
-int  lz_inflate(uint8_t* inputbuf,  uint16_t inputbuf_len,
+int  lz_inflate(uint8_t* inputbuf,  uint32_t inputbuf_len,
                 uint8_t* outputbuf, uint32_t outputbuf_len,
                 int skip_uncompressed_bytes);
 
@@ -67,9 +68,9 @@ bool decode_dat(const char* datfilename)
   uint32_t decompressed_size = 0;
   dat_index_entry* index = 0;
   FILE* fd_target;
-  FILE* fd = fopen(datfilename, "r");
+  FILE* fd = fopen(datfilename, "rb");
 
-  if (fd > 0)
+  if (fd != NULL)
   {
     status = true;
   }
@@ -212,8 +213,8 @@ bool decode_dat(const char* datfilename)
       if (status && !skipfile)
       {
         // open a separate file to which the contained file's data will be written
-        fd_target = fopen(filename, "w");
-        if (fd_target < 0)
+        fd_target = fopen(filename, "wb");
+        if (fd_target == NULL)
         {
           status = false;
           fprintf(stderr, "Error: failed to open '%s' for writing.\n", filename);
@@ -255,7 +256,7 @@ bool decode_dat(const char* datfilename)
     free(index);
   }
 
-  if (fd > 0)
+  if (fd != NULL)
   {
     fclose(fd);
   }
@@ -266,13 +267,13 @@ bool decode_dat(const char* datfilename)
 /**
  * Inflates data from an 8-bit LZ-compressed buffer.
  */
-int lz_inflate(uint8_t* input,  uint16_t inputbuf_len,
+int lz_inflate(uint8_t* input,  uint32_t inputbuf_len,
                uint8_t* output, uint32_t outputbuf_len,
                int skip_uncompressed_bytes)
 {
   uint8_t buffer[LZ_RINGBUF_SIZE];
   uint16_t bufpos = 0xFEE;
-  uint16_t inputpos = 0;
+  uint32_t inputpos = 0;
   uint32_t outputpos = 0;
   uint8_t codeword[2];
   uint8_t flagbyte = 0;
@@ -311,6 +312,13 @@ int lz_inflate(uint8_t* input,  uint16_t inputbuf_len,
           bufpos = 0;
         }
       }
+      else if ((inputpos + 1) >= inputbuf_len)
+      {
+        // a codeword can't be truncated by the end of the input; stop here rather
+        // than reading past the end of the buffer
+        fprintf(stderr, "Error: input ends with a truncated codeword (at input offset %08X)\n", inputpos);
+        inputpos = inputbuf_len;
+      }
       else
       {
         // two-byte reference to a sequence in the circular buffer
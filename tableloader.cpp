@@ -0,0 +1,46 @@
+#include "tableloader.h"
+
+TableLoader::TableLoader()
+{
+}
+
+TableLoader::~TableLoader()
+{
+  waitForFinished();
+}
+
+/**
+ * Adds a table to the set that is populated by start(). The table must outlive the loader.
+ */
+void TableLoader::addTable(DatTableBase* table)
+{
+  m_tables.append(table);
+}
+
+/**
+ * Starts populating all of the tables in the background. The DAT containers must already
+ * be open, and the tables must have been cleared of any earlier data.
+ */
+void TableLoader::start()
+{
+  waitForFinished();
+
+  m_pool.setMaxThreadCount(qMax(1, m_tables.size()));
+  foreach (DatTableBase* table, m_tables)
+  {
+    m_loads.append(table->startLoad(&m_pool));
+  }
+}
+
+/**
+ * Waits until all of the tables have been populated. This must be done before the tables
+ * are cleared, or the DAT containers are closed.
+ */
+void TableLoader::waitForFinished()
+{
+  foreach (QFuture<bool> load, m_loads)
+  {
+    load.waitForFinished();
+  }
+  m_loads.clear();
+}
@@ -0,0 +1,32 @@
+#ifndef TABLELOADER_H
+#define TABLELOADER_H
+
+#include <QList>
+#include <QFuture>
+#include <QThreadPool>
+#include "dattable.h"
+
+/**
+ * Populates a set of data tables (places, aliens, ships, etc.) concurrently, each on its own
+ * thread. The tables don't depend on one another, and the only state they share is in the
+ * DatLibrary and GameText instances, whose read paths are thread-safe. Nothing has to wait
+ * for the load as a whole: each table's getters wait for that table's own load, so the UI
+ * only blocks when it asks for data that isn't ready yet.
+ */
+class TableLoader
+{
+public:
+  TableLoader();
+  ~TableLoader();
+
+  void addTable(DatTableBase* table);
+  void start();
+  void waitForFinished();
+
+private:
+  QThreadPool m_pool;
+  QList<DatTableBase*> m_tables;
+  QList<QFuture<bool> > m_loads;
+};
+
+#endif // TABLELOADER_H
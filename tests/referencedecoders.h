@@ -0,0 +1,33 @@
+#ifndef REFERENCEDECODERS_H
+#define REFERENCEDECODERS_H
+
+#include <QByteArray>
+#include <QVector>
+#include <QImage>
+#include <QPoint>
+#include <QRgb>
+#include <stdint.h>
+#include "datlibrary.h"
+
+/**
+ * Copies of the original, straightforward implementations of decoders that have since been
+ * optimized. They're kept unchanged (apart from their names) so that the tests can check that
+ * the optimized decoders still produce exactly the same output for the same input.
+ */
+class ReferenceDecoders
+{
+public:
+  static bool stpToImage(const QByteArray& stpData, QVector<QRgb> palette, QImage& image);
+  static bool delToImage(const QByteArray& delData, QVector<QRgb> palette, QImage& image);
+  static bool lbmToImage(const QByteArray& lbmData, QVector<QRgb> palette, QImage& img);
+  static bool plnToPixmap(const QByteArray& plnData, QVector<QRgb> palette, QImage& image);
+  static bool lzDecompress(QByteArray compressedfile, QByteArray& decompressedFile, int skipUncompressedBytes);
+
+private:
+  ReferenceDecoders();
+  static const int8_t s_deltas[];
+
+  static QPoint getPixelLocation(int imgWidth, int pixelNum);
+};
+
+#endif // REFERENCEDECODERS_H
@@ -0,0 +1,204 @@
+#include <QFile>
+#include <QHash>
+#include <QtEndian>
+#include <string.h>
+#include "testdatbuilder.h"
+
+//! Longest sequence that a single LZ codeword can copy
+#define LZ_MAX_MATCH_LEN 18
+
+//! Shortest sequence that is worth encoding as a codeword rather than as literals
+#define LZ_MIN_MATCH_LEN 3
+
+TestDatBuilder::TestDatBuilder()
+{
+}
+
+/**
+ * Adds a file to the specified container. A compressed file may also be given the 4-byte
+ * uncompressed header that some of the game's files have, in which case its first four
+ * bytes are stored as-is.
+ */
+void TestDatBuilder::addFile(DatFileType dat, const QString& filename, const QByteArray& data, bool compress, bool uncompressedHeader)
+{
+  Entry entry;
+  entry.filename = filename;
+  entry.data = data;
+  entry.compress = compress;
+  entry.uncompressedHeader = compress && uncompressedHeader && (data.size() >= 4);
+  entry.precompressed = false;
+  entry.uncompressedSize = data.size();
+  m_entries[dat].append(entry);
+}
+
+/**
+ * Adds a file to the specified container that is stored exactly as provided, as LZ-compressed
+ * data that decompresses to the provided number of bytes. This allows codeword streams that
+ * lzCompress() would never produce to be put in a container.
+ */
+void TestDatBuilder::addCompressedFile(DatFileType dat, const QString& filename, const QByteArray& stored, int uncompressedSize)
+{
+  Entry entry;
+  entry.filename = filename;
+  entry.data = stored;
+  entry.compress = true;
+  entry.uncompressedHeader = false;
+  entry.precompressed = true;
+  entry.uncompressedSize = uncompressedSize;
+  m_entries[dat].append(entry);
+}
+
+/**
+ * Writes all five containers to the specified directory, each one with an index entry for
+ * every file that was added to it (an empty container is still written, since DatLibrary
+ * requires all of them to be present.)
+ * @return True if every container was written; false otherwise.
+ */
+bool TestDatBuilder::write(const QString& dir) const
+{
+  bool status = true;
+
+  foreach (DatFileType dat, DatLibrary::s_datFileNames.keys())
+  {
+    const QVector<Entry>& entries = m_entries[dat];
+    const int headerSize = 2 + (entries.size() * static_cast<int>(sizeof(DatFileIndex)));
+    QByteArray header(2, 0);
+    QByteArray contents;
+
+    qToLittleEndian<quint16>(static_cast<quint16>(entries.size()), header.data());
+
+    foreach (const Entry& entry, entries)
+    {
+      DatFileIndex indexEntry;
+      memset(&indexEntry, 0, sizeof(indexEntry));
+      QByteArray stored;
+
+      if (entry.precompressed)
+      {
+        stored = entry.data;
+        indexEntry.flags_a = 0x04;
+        indexEntry.flags_b = 0x01;
+        indexEntry.uncompressed_size = qToLittleEndian<qint32>(entry.uncompressedSize);
+        indexEntry.compressed_size = qToLittleEndian<qint32>(stored.size());
+      }
+      else if (entry.uncompressedHeader)
+      {
+        // the listed sizes don't include the four bytes of the uncompressed header
+        stored = entry.data.left(4) + lzCompress(entry.data.mid(4));
+        indexEntry.flags_b = 0x01;
+        indexEntry.uncompressed_size = qToLittleEndian<qint32>(entry.data.size() - 4);
+        indexEntry.compressed_size = qToLittleEndian<qint32>(stored.size() - 4);
+      }
+      else if (entry.compress)
+      {
+        stored = lzCompress(entry.data);
+        indexEntry.flags_a = 0x04;
+        indexEntry.flags_b = 0x01;
+        indexEntry.uncompressed_size = qToLittleEndian<qint32>(entry.data.size());
+        indexEntry.compressed_size = qToLittleEndian<qint32>(stored.size());
+      }
+      else
+      {
+        stored = entry.data;
+        indexEntry.uncompressed_size = qToLittleEndian<qint32>(entry.data.size());
+        indexEntry.compressed_size = qToLittleEndian<qint32>(entry.data.size());
+      }
+
+      qstrncpy(indexEntry.filename, entry.filename.toLatin1().constData(), INDEX_FILENAME_LEN);
+      indexEntry.offset = qToLittleEndian<quint32>(static_cast<quint32>(headerSize + contents.size()));
+
+      header.append(reinterpret_cast<const char*>(&indexEntry), sizeof(indexEntry));
+      contents.append(stored);
+    }
+
+    QFile outFile(dir + "/" + DatLibrary::s_datFileNames[dat]);
+    if (outFile.open(QIODevice::WriteOnly))
+    {
+      status = (outFile.write(header) == header.size()) && (outFile.write(contents) == contents.size()) && status;
+      outFile.close();
+    }
+    else
+    {
+      status = false;
+    }
+  }
+
+  return status;
+}
+
+/**
+ * LZ-compresses the provided data into the format that DatLibrary decompresses. Each flag
+ * byte is followed by eight items, which are either a literal byte (flag bit set) or a
+ * two-byte codeword that copies 3 to 18 bytes from the decoder's 4 KB ring buffer. Input
+ * byte n is written to ring buffer position (0xFEE + n) modulo the buffer size, so an
+ * earlier match can be referred to by its position as long as it hasn't been overwritten
+ * yet. Matches are found greedily, using the most recent occurrence of each 3-byte prefix;
+ * this is enough to produce realistic codewords (including ones that overlap the bytes
+ * they produce, and ones that wrap around the end of the buffer), though not to compress
+ * as well as the game's own tool.
+ */
+QByteArray TestDatBuilder::lzCompress(const QByteArray& data)
+{
+  const uchar* const input = reinterpret_cast<const uchar*>(data.constData());
+  const int inputLen = data.size();
+  QHash<quint32,int> lastPrefixPos;
+  QByteArray output;
+  int inputPos = 0;
+
+  while (inputPos < inputLen)
+  {
+    const int flagPos = output.size();
+    uchar flagByte = 0;
+    output.append('\0');
+
+    for (int chunkIndex = 0; (chunkIndex < 8) && (inputPos < inputLen); chunkIndex++)
+    {
+      int matchLen = 0;
+      int matchPos = 0;
+
+      if ((inputPos + LZ_MIN_MATCH_LEN) <= inputLen)
+      {
+        const quint32 prefix = input[inputPos] | (input[inputPos + 1] << 8) | (input[inputPos + 2] << 16);
+        const QHash<quint32,int>::const_iterator candidate = lastPrefixPos.constFind(prefix);
+
+        // the match must still be in the ring buffer once all of the bytes it produces have been written
+        if ((candidate != lastPrefixPos.constEnd()) &&
+            ((inputPos - candidate.value()) <= (LZ_RINGBUF_SIZE - LZ_MAX_MATCH_LEN)))
+        {
+          const int maxLen = qMin(LZ_MAX_MATCH_LEN, inputLen - inputPos);
+          matchPos = candidate.value();
+          while ((matchLen < maxLen) && (input[matchPos + matchLen] == input[inputPos + matchLen]))
+          {
+            matchLen++;
+          }
+        }
+      }
+
+      int consumed = 1;
+      if (matchLen >= LZ_MIN_MATCH_LEN)
+      {
+        const int source = (0xFEE + matchPos) & (LZ_RINGBUF_SIZE - 1);
+        output.append(static_cast<char>(source & 0xFF));
+        output.append(static_cast<char>(((matchLen - LZ_MIN_MATCH_LEN) << 4) | (source >> 8)));
+        consumed = matchLen;
+      }
+      else
+      {
+        flagByte |= (1 << chunkIndex);
+        output.append(static_cast<char>(input[inputPos]));
+      }
+
+      for (int byteIdx = 0; byteIdx < consumed; byteIdx++, inputPos++)
+      {
+        if ((inputPos + LZ_MIN_MATCH_LEN) <= inputLen)
+        {
+          lastPrefixPos[input[inputPos] | (input[inputPos + 1] << 8) | (input[inputPos + 2] << 16)] = inputPos;
+        }
+      }
+    }
+
+    output[flagPos] = static_cast<char>(flagByte);
+  }
+
+  return output;
+}
@@ -0,0 +1,42 @@
+#ifndef TESTDATBUILDER_H
+#define TESTDATBUILDER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include "datlibrary.h"
+
+/**
+ * Writes a synthetic set of the game's DAT containers for the tests, so that they can run
+ * without a copy of the game. Each file is stored either as-is or LZ-compressed in the same
+ * format as the originals (optionally with the 4-byte uncompressed header), so that the
+ * containers exercise all of the paths that DatLibrary uses to read them.
+ */
+class TestDatBuilder
+{
+public:
+  TestDatBuilder();
+
+  void addFile(DatFileType dat, const QString& filename, const QByteArray& data, bool compress, bool uncompressedHeader = false);
+  void addCompressedFile(DatFileType dat, const QString& filename, const QByteArray& stored, int uncompressedSize);
+  bool write(const QString& dir) const;
+
+  static QByteArray lzCompress(const QByteArray& data);
+
+private:
+  //! A file to be stored in one of the containers
+  struct Entry
+  {
+    QString filename;
+    QByteArray data;
+    bool compress;
+    bool uncompressedHeader;
+    //! True if the data is already compressed, in which case uncompressedSize is what the index lists
+    bool precompressed;
+    int uncompressedSize;
+  };
+
+  QVector<Entry> m_entries[DatFileType_NUM_DAT_FILES];
+};
+
+#endif // TESTDATBUILDER_H
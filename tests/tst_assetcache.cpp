@@ -0,0 +1,202 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QDateTime>
+#include "assetcache.h"
+
+//! Size of the data stored in each entry by the tests
+#define TEST_ENTRY_DATA_BYTES 1000
+
+//! Size of the buffer that the published XXH64 test vectors are computed over
+#define XXH_SANITY_BUFFER_BYTES 222
+
+//! Seed (and first byte generator value) used by the published XXH64 test vectors
+#define XXH_SANITY_PRIME32 2654435761U
+
+//! Multiplier that generates the bytes of the published XXH64 test vectors' buffer
+#define XXH_SANITY_PRIME64 11400714785074694797ULL
+
+/**
+ * Tests for the disk cache's handling of its directory: entries that fail to load are deleted,
+ * and setting the directory deletes the least recently used entries beyond the size budget.
+ * The hash that keys the entries is checked against xxHash's own published XXH64 values.
+ */
+class TestAssetCache : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void hash_data();
+  void hash();
+  void storeAndLoad();
+  void damagedEntryIsDeleted();
+  void pruneKeepsNewestEntries();
+  void loadMarksEntryAsUsed();
+
+private:
+  static QByteArray makeSanityBuffer();
+  static QByteArray makeData(quint64 key);
+  static QString entryFilename(const QTemporaryDir& dir, quint64 key);
+  static void storeEntries(const QTemporaryDir& dir, int count);
+  static bool setModificationTime(const QString& filename, const QDateTime& time);
+};
+
+/**
+ * Generates the buffer that xxHash's sanity check computes its XXH64 test vectors over.
+ */
+QByteArray TestAssetCache::makeSanityBuffer()
+{
+  QByteArray buffer;
+  quint64 byteGen = XXH_SANITY_PRIME32;
+
+  for (int byteIdx = 0; byteIdx < XXH_SANITY_BUFFER_BYTES; byteIdx++)
+  {
+    buffer.append(static_cast<char>(byteGen >> 56));
+    byteGen *= XXH_SANITY_PRIME64;
+  }
+
+  return buffer;
+}
+
+QByteArray TestAssetCache::makeData(quint64 key)
+{
+  return QByteArray(TEST_ENTRY_DATA_BYTES, static_cast<char>('A' + key));
+}
+
+QString TestAssetCache::entryFilename(const QTemporaryDir& dir, quint64 key)
+{
+  return dir.filePath(QString("%1" ASSET_CACHE_ENTRY_SUFFIX).arg(key, 16, 16, QChar('0')));
+}
+
+/**
+ * Stores entries with the keys 1 through count, each modified a minute after the one before.
+ */
+void TestAssetCache::storeEntries(const QTemporaryDir& dir, int count)
+{
+  AssetCache cache;
+  cache.setDirectory(dir.path());
+  const QDateTime start = QDateTime::currentDateTimeUtc().addDays(-1);
+
+  for (quint64 key = 1; key <= static_cast<quint64>(count); key++)
+  {
+    QVERIFY(cache.store(key, makeData(key)));
+    QVERIFY(setModificationTime(entryFilename(dir, key), start.addSecs(static_cast<int>(key) * 60)));
+  }
+}
+
+bool TestAssetCache::setModificationTime(const QString& filename, const QDateTime& time)
+{
+  QFile file(filename);
+  return file.open(QIODevice::ReadWrite) && file.setFileTime(time, QFileDevice::FileModificationTime);
+}
+
+void TestAssetCache::hash_data()
+{
+  QTest::addColumn<int>("len");
+  QTest::addColumn<quint64>("seed");
+  QTest::addColumn<quint64>("expected");
+
+  // one length for each way the tail of the data is consumed, and one that uses the 32-byte stripes
+  QTest::newRow("empty") << 0 << Q_UINT64_C(0) << Q_UINT64_C(0xEF46DB3751D8E999);
+  QTest::newRow("empty, seeded") << 0 << quint64(XXH_SANITY_PRIME32) << Q_UINT64_C(0xAC75FDA2929B17EF);
+  QTest::newRow("1 byte") << 1 << Q_UINT64_C(0) << Q_UINT64_C(0xE934A84ADB052768);
+  QTest::newRow("1 byte, seeded") << 1 << quint64(XXH_SANITY_PRIME32) << Q_UINT64_C(0x5014607643A9B4C3);
+  QTest::newRow("4 bytes") << 4 << Q_UINT64_C(0) << Q_UINT64_C(0x9136A0DCA57457EE);
+  QTest::newRow("4 bytes, seeded") << 4 << quint64(XXH_SANITY_PRIME32) << Q_UINT64_C(0xCAAB286BD8E9FDB5);
+  QTest::newRow("14 bytes") << 14 << Q_UINT64_C(0) << Q_UINT64_C(0x8282DCC4994E35C8);
+  QTest::newRow("14 bytes, seeded") << 14 << quint64(XXH_SANITY_PRIME32) << Q_UINT64_C(0xC3BD6BF63DEB6DF0);
+  QTest::newRow("222 bytes") << 222 << Q_UINT64_C(0) << Q_UINT64_C(0xB641AE8CB691C174);
+  QTest::newRow("222 bytes, seeded") << 222 << quint64(XXH_SANITY_PRIME32) << Q_UINT64_C(0x20CB8AB7AE10C14A);
+}
+
+void TestAssetCache::hash()
+{
+  QFETCH(int, len);
+  QFETCH(quint64, seed);
+  QFETCH(quint64, expected);
+
+  const QByteArray buffer = makeSanityBuffer();
+  QCOMPARE(AssetCache::hash(buffer.constData(), len, seed), expected);
+}
+
+void TestAssetCache::storeAndLoad()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  AssetCache cache;
+  cache.setDirectory(dir.path());
+  QVERIFY(cache.store(1, makeData(1)));
+
+  QByteArray data;
+  QVERIFY(cache.load(1, data));
+  QCOMPARE(data, makeData(1));
+  QVERIFY(!cache.load(2, data));
+  QVERIFY(data.isEmpty());
+}
+
+void TestAssetCache::damagedEntryIsDeleted()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  AssetCache cache;
+  cache.setDirectory(dir.path());
+  QVERIFY(cache.store(1, makeData(1)));
+
+  QFile entryFile(entryFilename(dir, 1));
+  QVERIFY(entryFile.resize(entryFile.size() - 1));
+
+  QByteArray data;
+  QVERIFY(!cache.load(1, data));
+  QVERIFY(!entryFile.exists());
+}
+
+void TestAssetCache::pruneKeepsNewestEntries()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  storeEntries(dir, 4);
+  if (QTest::currentTestFailed())
+  {
+    return;
+  }
+
+  // a budget of exactly two entries keeps the two that were modified last
+  AssetCache cache;
+  cache.setDirectory(dir.path(), 2 * QFileInfo(entryFilename(dir, 1)).size());
+
+  QVERIFY(!QFile::exists(entryFilename(dir, 1)));
+  QVERIFY(!QFile::exists(entryFilename(dir, 2)));
+  QVERIFY(QFile::exists(entryFilename(dir, 3)));
+  QVERIFY(QFile::exists(entryFilename(dir, 4)));
+}
+
+void TestAssetCache::loadMarksEntryAsUsed()
+{
+#ifdef Q_OS_WIN
+  QSKIP("The modification time of a file that is only open for reading can't be set on Windows.");
+#endif
+
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+  storeEntries(dir, 3);
+  if (QTest::currentTestFailed())
+  {
+    return;
+  }
+
+  AssetCache cache;
+  cache.setDirectory(dir.path());
+  QByteArray data;
+  QVERIFY(cache.load(1, data));
+
+  cache.setDirectory(dir.path(), QFileInfo(entryFilename(dir, 1)).size());
+
+  QVERIFY(QFile::exists(entryFilename(dir, 1)));
+  QVERIFY(!QFile::exists(entryFilename(dir, 2)));
+  QVERIFY(!QFile::exists(entryFilename(dir, 3)));
+}
+
+QTEST_GUILESS_MAIN(TestAssetCache)
+
+#include "tst_assetcache.moc"
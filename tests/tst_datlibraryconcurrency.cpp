@@ -0,0 +1,250 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QThreadPool>
+#include <QRandomGenerator>
+#include <QtConcurrent/QtConcurrentRun>
+#include "datlibrary.h"
+#include "testdatbuilder.h"
+
+//! Number of files put in each synthetic container
+#define STRESS_FILES_PER_DAT 24
+
+//! Number of lookups that each thread makes
+#define STRESS_ITERATIONS 1500
+
+//! Cache budget that is small enough to keep entries being evicted while other threads use them
+#define STRESS_SMALL_CACHE_BUDGET (96 * 1024)
+
+//! A file in the synthetic containers, and the data that reading it must produce
+struct ExpectedFile
+{
+  DatFileType dat;
+  QString filename;
+  QByteArray data;
+};
+
+//! A string in the synthetic GAMETEXT.TXT (or the tail of one), and its offset
+struct ExpectedText
+{
+  int offset;
+  QString text;
+};
+
+//! State shared by all of the threads in one run of the stress test
+struct StressRun
+{
+  const DatLibrary* lib;
+  const QVector<ExpectedFile>* files;
+  const QVector<ExpectedText>* texts;
+  int threadCount;
+  QAtomicInt started;
+  QAtomicInt mismatches;
+};
+
+/**
+ * Reads random files and strings from the library, counting every result that doesn't
+ * match what was written to the containers. All of the threads wait until every one of
+ * them has started, so that they all race the library's first-use initialization (and
+ * each other) rather than running one after another.
+ */
+static void hammerLibrary(StressRun* run, quint32 seed)
+{
+  QRandomGenerator rng(seed);
+
+  run->started.fetchAndAddOrdered(1);
+  while (run->started.loadAcquire() < run->threadCount)
+  {
+    QThread::yieldCurrentThread();
+  }
+
+  for (int iter = 0; iter < STRESS_ITERATIONS; iter++)
+  {
+    const int op = rng.bounded(3);
+    bool match = false;
+
+    if (op == 2)
+    {
+      const ExpectedText& text = run->texts->at(rng.bounded(run->texts->size()));
+      match = (run->lib->getGameText(text.offset) == text.text);
+    }
+    else
+    {
+      const ExpectedFile& file = run->files->at(rng.bounded(run->files->size()));
+      QByteArray data;
+
+      // lookups are case-insensitive, so vary the case of the names too
+      const QString filename = (iter & 1) ? file.filename.toLower() : file.filename;
+
+      if (op == 0)
+      {
+        match = run->lib->getFileByName(file.dat, filename, data) && (data == file.data);
+      }
+      else
+      {
+        match = run->lib->getFileByKey(file.dat, DatFileKey(filename), data) && (data == file.data);
+      }
+    }
+
+    if (!match)
+    {
+      run->mismatches.fetchAndAddOrdered(1);
+    }
+  }
+}
+
+/**
+ * Stress test for the thread safety of DatLibrary. Many threads read files (both by name and
+ * by key) and GAMETEXT strings from a freshly opened library at the same time, and every
+ * result is checked against the data that the containers were built from. This is most
+ * useful in a build with NRE_ENABLE_TSAN, which also reports data races that happen not to
+ * produce a wrong result.
+ */
+class TestDatLibraryConcurrency : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void concurrentReads_data();
+  void concurrentReads();
+
+private:
+  QTemporaryDir m_dataDir;
+  QVector<ExpectedFile> m_files;
+  QVector<ExpectedText> m_texts;
+
+  static QByteArray makeFileData(QRandomGenerator& rng, int size);
+};
+
+/**
+ * Generates file contents with enough repetition in them to be compressed with a realistic
+ * mix of literals and codewords.
+ */
+QByteArray TestDatLibraryConcurrency::makeFileData(QRandomGenerator& rng, int size)
+{
+  QByteArray data(size, '\0');
+  const int alphabetSize = 2 + rng.bounded(60);
+
+  for (int pos = 0; pos < size; pos++)
+  {
+    if ((pos > 16) && (rng.bounded(3) == 0))
+    {
+      data[pos] = data[pos - 1 - rng.bounded(qMin(pos, 3000))];
+    }
+    else
+    {
+      data[pos] = static_cast<char>('0' + rng.bounded(alphabetSize));
+    }
+  }
+
+  return data;
+}
+
+void TestDatLibraryConcurrency::initTestCase()
+{
+  QVERIFY(m_dataDir.isValid());
+
+  QRandomGenerator rng(0x4E524531);
+  TestDatBuilder builder;
+
+  foreach (DatFileType dat, DatLibrary::s_datFileNames.keys())
+  {
+    for (int fileIdx = 0; fileIdx < STRESS_FILES_PER_DAT; fileIdx++)
+    {
+      ExpectedFile file;
+      file.dat = dat;
+      file.filename = QString("FILE%1.D%2").arg(fileIdx, 3, 10, QChar('0')).arg(static_cast<int>(dat));
+
+      // some files are large enough to be kept in the disk cache, and some are too large
+      // to be kept in the small memory cache at all
+      file.data = makeFileData(rng, (fileIdx % 4 == 0) ? (20000 + rng.bounded(40000)) : rng.bounded(4000));
+
+      builder.addFile(dat, file.filename, file.data, (fileIdx % 3) != 0, (fileIdx % 3) == 2);
+      m_files.append(file);
+    }
+  }
+
+  QByteArray gameText;
+  for (int strIdx = 0; strIdx < 300; strIdx++)
+  {
+    const QString text = QString("String %1 of the game text, %2").arg(strIdx).arg(rng.generate());
+    ExpectedText whole = { gameText.size(), text };
+    ExpectedText tail = { gameText.size() + 3, text.mid(3) };
+    m_texts.append(whole);
+    m_texts.append(tail);
+
+    gameText.append(text.toUtf8());
+    gameText.append('\0');
+  }
+
+  ExpectedFile gameTextFile = { DatFileType_CONVERSE, "GAMETEXT.TXT", gameText };
+  builder.addFile(gameTextFile.dat, gameTextFile.filename, gameTextFile.data, true);
+  m_files.append(gameTextFile);
+
+  // offsets outside of the file produce empty strings
+  ExpectedText pastEnd = { gameText.size() + 10, QString("") };
+  m_texts.append(pastEnd);
+
+  QVERIFY(builder.write(m_dataDir.path()));
+}
+
+void TestDatLibraryConcurrency::concurrentReads_data()
+{
+  QTest::addColumn<bool>("useMemoryMap");
+  QTest::addColumn<int>("cacheBudget");
+  QTest::addColumn<bool>("useDiskCache");
+
+  QTest::newRow("mapped") << true << DAT_CACHE_DEFAULT_BUDGET_BYTES << false;
+  QTest::newRow("mapped, evicting") << true << STRESS_SMALL_CACHE_BUDGET << false;
+  QTest::newRow("read into memory, evicting") << false << STRESS_SMALL_CACHE_BUDGET << false;
+  QTest::newRow("mapped, evicting, disk cache") << true << STRESS_SMALL_CACHE_BUDGET << true;
+}
+
+void TestDatLibraryConcurrency::concurrentReads()
+{
+  QFETCH(bool, useMemoryMap);
+  QFETCH(int, cacheBudget);
+  QFETCH(bool, useDiskCache);
+
+  QTemporaryDir diskCacheDir;
+  QVERIFY(diskCacheDir.isValid());
+
+  DatLibrary lib;
+  lib.setCacheBudget(cacheBudget);
+  if (useDiskCache)
+  {
+    lib.setDiskCacheDirectory(diskCacheDir.path());
+  }
+  QVERIFY(lib.openData(m_dataDir.path(), useMemoryMap));
+
+  // use more threads than there are cores, so that threads are also preempted while
+  // holding locks or partway through decoding
+  const int threadCount = qMax(8, 2 * QThread::idealThreadCount());
+  QThreadPool pool;
+  pool.setMaxThreadCount(threadCount);
+
+  StressRun run;
+  run.lib = &lib;
+  run.files = &m_files;
+  run.texts = &m_texts;
+  run.threadCount = threadCount;
+
+  QVector<QFuture<void> > futures;
+  for (int threadIdx = 0; threadIdx < threadCount; threadIdx++)
+  {
+    futures.append(QtConcurrent::run(&pool, &hammerLibrary, &run, static_cast<quint32>(threadIdx + 1)));
+  }
+
+  foreach (QFuture<void> future, futures)
+  {
+    future.waitForFinished();
+  }
+
+  QCOMPARE(run.mismatches.loadAcquire(), 0);
+  QVERIFY(lib.getCacheMisses() > 0);
+}
+
+QTEST_GUILESS_MAIN(TestDatLibraryConcurrency)
+
+#include "tst_datlibraryconcurrency.moc"
@@ -0,0 +1,156 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include "datlibrary.h"
+#include "gametext.h"
+#include "testdatbuilder.h"
+
+//! Number of null bytes that follow each input, since command parameters may be read past maxlen
+#define GOLDEN_INPUT_PADDING 16
+
+/**
+ * Golden tests for GameText::readString(). Each case in data/gametext_golden.json is a string
+ * of game text (with embedded commands), along with the HTML and the list of commands that the
+ * original implementation produced for it. The same file describes the GAMETEXT.TXT, META.TAB,
+ * and METATXT.TAB that the metatext in the cases refers to, which are written to a synthetic
+ * CONVERSE.DAT.
+ */
+class TestGameText : public QObject
+{
+  Q_OBJECT
+
+public:
+  TestGameText();
+
+private slots:
+  void initTestCase();
+  void readString_data();
+  void readString();
+
+private:
+  QTemporaryDir m_dataDir;
+  DatLibrary m_lib;
+  QJsonObject m_golden;
+
+  static QString formatCommands(const QVector<QPair<GTxtCmd,int> >& commands);
+};
+
+TestGameText::TestGameText()
+{
+}
+
+/**
+ * Formats a list of commands as space-separated "command:parameter" pairs, so that a mismatch
+ * is easy to read in the test output.
+ */
+QString TestGameText::formatCommands(const QVector<QPair<GTxtCmd,int> >& commands)
+{
+  QStringList formatted;
+
+  for (int cmdIdx = 0; cmdIdx < commands.size(); cmdIdx++)
+  {
+    formatted.append(QString("%1:%2").arg(static_cast<int>(commands[cmdIdx].first)).arg(commands[cmdIdx].second));
+  }
+
+  return formatted.join(' ');
+}
+
+void TestGameText::initTestCase()
+{
+  QVERIFY(m_dataDir.isValid());
+
+  QFile goldenFile(QFINDTESTDATA("data/gametext_golden.json"));
+  QVERIFY(goldenFile.open(QIODevice::ReadOnly));
+
+  QJsonParseError parseError;
+  const QJsonDocument doc = QJsonDocument::fromJson(goldenFile.readAll(), &parseError);
+  QVERIFY2(parseError.error == QJsonParseError::NoError, qPrintable(parseError.errorString()));
+  m_golden = doc.object();
+
+  // each string in GAMETEXT.TXT is null-terminated, and METATXT.TAB refers to them by offset
+  QByteArray gameText;
+  QVector<int> gameTextOffsets;
+  foreach (const QJsonValue& text, m_golden["gameText"].toArray())
+  {
+    gameTextOffsets.append(gameText.size());
+    gameText.append(text.toString().toLatin1());
+    gameText.append('\0');
+  }
+
+  QByteArray metaTextTab;
+  foreach (const QJsonValue& textIndex, m_golden["metaTextTab"].toArray())
+  {
+    char record[METATEXT_RECORDSIZE_BYTES];
+    qToLittleEndian<quint16>(static_cast<quint16>(gameTextOffsets.at(textIndex.toInt())), record);
+    metaTextTab.append(record, METATEXT_RECORDSIZE_BYTES);
+  }
+
+  QByteArray metaTab;
+  foreach (const QJsonValue& entry, m_golden["metaTab"].toArray())
+  {
+    const QJsonArray fields = entry.toArray();
+    char record[METATAB_RECORDSIZE_BYTES];
+    record[0] = static_cast<char>(fields[0].toInt());
+    record[1] = static_cast<char>(fields[1].toInt());
+    qToLittleEndian<quint16>(static_cast<quint16>(fields[2].toInt()), record + 2);
+    metaTab.append(record, METATAB_RECORDSIZE_BYTES);
+  }
+
+  TestDatBuilder builder;
+  builder.addFile(DatFileType_CONVERSE, "GAMETEXT.TXT", gameText, true);
+  builder.addFile(DatFileType_CONVERSE, "META.TAB", metaTab, false);
+  builder.addFile(DatFileType_CONVERSE, "METATXT.TAB", metaTextTab, false);
+  QVERIFY(builder.write(m_dataDir.path()));
+  QVERIFY(m_lib.openData(m_dataDir.path()));
+}
+
+void TestGameText::readString_data()
+{
+  QTest::addColumn<QByteArray>("input");
+  QTest::addColumn<int>("maxlen");
+  QTest::addColumn<bool>("showCommands");
+  QTest::addColumn<QString>("html");
+  QTest::addColumn<QString>("commands");
+
+  foreach (const QJsonValue& value, m_golden["cases"].toArray())
+  {
+    const QJsonObject goldenCase = value.toObject();
+    QVector<QPair<GTxtCmd,int> > commands;
+
+    foreach (const QJsonValue& command, goldenCase["commands"].toArray())
+    {
+      commands.append(QPair<GTxtCmd,int>(static_cast<GTxtCmd>(command.toArray()[0].toInt()), command.toArray()[1].toInt()));
+    }
+
+    QTest::newRow(qPrintable(goldenCase["name"].toString()))
+      << goldenCase["input"].toString().toLatin1()
+      << goldenCase["maxlen"].toInt()
+      << goldenCase["showCommands"].toBool()
+      << goldenCase["html"].toString()
+      << formatCommands(commands);
+  }
+}
+
+void TestGameText::readString()
+{
+  QFETCH(QByteArray, input);
+  QFETCH(int, maxlen);
+  QFETCH(bool, showCommands);
+  QFETCH(QString, html);
+  QFETCH(QString, commands);
+
+  // a fresh GameText for each case, so that every case also loads the metatext table
+  GameText gameText(m_lib);
+  QVector<QPair<GTxtCmd,int> > readCommands;
+  const QByteArray paddedInput = input + QByteArray(GOLDEN_INPUT_PADDING, '\0');
+
+  QCOMPARE(gameText.readString(paddedInput.constData(), readCommands, showCommands, maxlen), html);
+  QCOMPARE(formatCommands(readCommands), commands);
+}
+
+QTEST_GUILESS_MAIN(TestGameText)
+
+#include "tst_gametext.moc"
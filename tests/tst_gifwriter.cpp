@@ -0,0 +1,176 @@
+#include <QtTest>
+#include <QBuffer>
+#include <QImageReader>
+#include <QRandomGenerator>
+#include "gifwriter.h"
+
+/**
+ * Round-trip tests for the GIF encoder. Random animations are encoded and then decoded with
+ * Qt's own GIF plugin, and every decoded frame must have exactly the palette indices of the
+ * corresponding source frame. The larger random frames produce more than 4096 LZW codes, so
+ * they also exercise the code size changes and the table being cleared and started over.
+ */
+class TestGifWriter : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void roundTrip_data();
+  void roundTrip();
+
+private:
+  QVector<QRgb> m_palette;
+
+  QImage makeFrame(QRandomGenerator& rng, int width, int height, int colorCount) const;
+  static void changeRect(QRandomGenerator& rng, QImage& image, int colorCount);
+  static QVector<QImage> decodeFrames(const QByteArray& gifData);
+};
+
+void TestGifWriter::initTestCase()
+{
+  if (!QImageReader::supportedImageFormats().contains("gif"))
+  {
+    QSKIP("Qt's GIF image format plugin is not available.");
+  }
+
+  // every index gets a different color, so that the decoded colors can be mapped back to indices
+  for (int colorIdx = 0; colorIdx < 256; colorIdx++)
+  {
+    m_palette.append(qRgb(colorIdx, (colorIdx * 37) & 0xFF, 255 - colorIdx));
+  }
+}
+
+QImage TestGifWriter::makeFrame(QRandomGenerator& rng, int width, int height, int colorCount) const
+{
+  QImage image(width, height, QImage::Format_Indexed8);
+  image.setColorTable(m_palette);
+
+  for (int y = 0; y < height; y++)
+  {
+    uchar* const line = image.scanLine(y);
+    for (int x = 0; x < width; x++)
+    {
+      line[x] = static_cast<uchar>(rng.bounded(colorCount));
+    }
+  }
+
+  return image;
+}
+
+/**
+ * Gives a random rectangle of the image new random indices, changing at least one of them.
+ */
+void TestGifWriter::changeRect(QRandomGenerator& rng, QImage& image, int colorCount)
+{
+  const int left = rng.bounded(image.width());
+  const int top = rng.bounded(image.height());
+  const int right = left + rng.bounded(image.width() - left);
+  const int bottom = top + rng.bounded(image.height() - top);
+  const uchar corner = image.constScanLine(top)[left];
+
+  for (int y = top; y <= bottom; y++)
+  {
+    for (int x = left; x <= right; x++)
+    {
+      image.scanLine(y)[x] = static_cast<uchar>(rng.bounded(colorCount));
+    }
+  }
+
+  image.scanLine(top)[left] = static_cast<uchar>((corner + 1) % 256);
+}
+
+QVector<QImage> TestGifWriter::decodeFrames(const QByteArray& gifData)
+{
+  QVector<QImage> frames;
+  QBuffer buffer;
+  buffer.setData(gifData);
+  buffer.open(QIODevice::ReadOnly);
+
+  QImageReader reader(&buffer, "gif");
+  QImage frame;
+  while (reader.read(&frame))
+  {
+    frames.append(frame);
+  }
+
+  return frames;
+}
+
+void TestGifWriter::roundTrip_data()
+{
+  QTest::addColumn<int>("width");
+  QTest::addColumn<int>("height");
+  QTest::addColumn<int>("colorCount");
+  QTest::addColumn<quint32>("seed");
+
+  QTest::newRow("single pixel") << 1 << 1 << 256 << 1u;
+  QTest::newRow("single color") << 64 << 64 << 1 << 2u;
+  QTest::newRow("odd size, few colors") << 37 << 23 << 4 << 3u;
+  QTest::newRow("wide, all colors") << 320 << 7 << 256 << 4u;
+  QTest::newRow("several table clears") << 160 << 120 << 256 << 5u;
+  QTest::newRow("long strings, table clear") << 200 << 150 << 4 << 6u;
+}
+
+void TestGifWriter::roundTrip()
+{
+  QFETCH(int, width);
+  QFETCH(int, height);
+  QFETCH(int, colorCount);
+  QFETCH(quint32, seed);
+
+  QRandomGenerator rng(seed);
+  QVector<QImage> frames;
+  QVector<QImage> distinctFrames;
+
+  // changed frames, with repeats of the previous frame in between that must be folded into it
+  frames.append(makeFrame(rng, width, height, colorCount));
+  distinctFrames.append(frames.last());
+  for (int frameIdx = 0; frameIdx < 6; frameIdx++)
+  {
+    QImage frame = frames.last().copy();
+    changeRect(rng, frame, colorCount);
+    frames.append(frame);
+    distinctFrames.append(frame);
+
+    for (int repeatIdx = 0; repeatIdx < (frameIdx % 3); repeatIdx++)
+    {
+      frames.append(frame.copy());
+    }
+  }
+
+  QByteArray gifData;
+  QVERIFY(GifWriter().encode(frames, gifData));
+
+  const QVector<QImage> decoded = decodeFrames(gifData);
+  QCOMPARE(decoded.size(), distinctFrames.size());
+
+  QHash<QRgb,int> indexByColor;
+  for (int colorIdx = 0; colorIdx < m_palette.size(); colorIdx++)
+  {
+    indexByColor.insert(m_palette[colorIdx] | 0xFF000000, colorIdx);
+  }
+
+  for (int frameIdx = 0; frameIdx < decoded.size(); frameIdx++)
+  {
+    const QImage& expected = distinctFrames[frameIdx];
+    QCOMPARE(decoded[frameIdx].size(), expected.size());
+
+    for (int y = 0; y < height; y++)
+    {
+      for (int x = 0; x < width; x++)
+      {
+        const int index = indexByColor.value(decoded[frameIdx].pixel(x, y) | 0xFF000000, -1);
+        if (index != expected.pixelIndex(x, y))
+        {
+          QFAIL(qPrintable(QString("Frame %1 differs at (%2,%3): expected index %4, decoded %5")
+                           .arg(frameIdx).arg(x).arg(y).arg(expected.pixelIndex(x, y)).arg(index)));
+        }
+      }
+    }
+  }
+}
+
+QTEST_GUILESS_MAIN(TestGifWriter)
+
+#include "tst_gifwriter.moc"
@@ -0,0 +1,279 @@
+#include <QtTest>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include "imageconverter.h"
+#include "referencedecoders.h"
+
+//! Number of random images that are decoded for each seed
+#define DIFF_IMAGES_PER_SEED 2500
+
+/**
+ * Differential tests for the optimized image decoders. Each one is given a large number of
+ * random inputs, and must produce the same result and the same pixels as the original
+ * implementation in ReferenceDecoders. The STP inputs are mostly well-formed, but also include
+ * truncated and corrupt ones. The DEL inputs are always well-formed, since the original DEL
+ * decoder reads past the end of its input when a command is cut off.
+ */
+class TestImageConverter : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void initTestCase();
+  void stpMatchesReference_data();
+  void stpMatchesReference();
+  void delMatchesReference_data();
+  void delMatchesReference();
+
+private:
+  QVector<QRgb> m_palette;
+
+  static QByteArray makeStpData(QRandomGenerator& rng);
+  static QByteArray makeDelData(QRandomGenerator& rng, int width, int height);
+  QImage makeBaseImage(QRandomGenerator& rng, int width, int height) const;
+};
+
+/**
+ * Generates a random STP image. Most are a sequence of well-formed skip, fill, and copy runs
+ * that covers at least the whole image; the rest either stop short of the end of the image,
+ * are cut off partway through a run, or are just random bytes.
+ */
+QByteArray TestImageConverter::makeStpData(QRandomGenerator& rng)
+{
+  const int width = rng.bounded(80);
+  const int height = rng.bounded(50);
+  const int pixelCount = width * height;
+  const int kind = rng.bounded(8);
+  QByteArray data(8, '\0');
+
+  // the four bytes after the dimensions aren't used by the decoder
+  qToLittleEndian<quint16>(static_cast<quint16>(width), data.data());
+  qToLittleEndian<quint16>(static_cast<quint16>(height), data.data() + 2);
+  qToLittleEndian<quint32>(rng.generate(), data.data() + 4);
+
+  if (kind == 0)
+  {
+    const int size = rng.bounded(pixelCount + 16);
+    for (int byteIdx = 0; byteIdx < size; byteIdx++)
+    {
+      data.append(static_cast<char>(rng.bounded(256)));
+    }
+  }
+  else
+  {
+    // well-formed runs, which cover more than the whole image unless they're meant to stop short
+    const int target = (kind == 1) ? rng.bounded(pixelCount + 1) : (pixelCount + rng.bounded(100));
+    int covered = 0;
+
+    while (covered < target)
+    {
+      const int runType = rng.bounded(3);
+
+      if (runType == 0)
+      {
+        const int count = rng.bounded(0x80);
+        data.append(static_cast<char>(0x80 | count));
+        covered += count;
+      }
+      else if (runType == 1)
+      {
+        const int count = rng.bounded(0x40);
+        data.append(static_cast<char>(0x40 | count));
+        data.append(static_cast<char>(rng.bounded(256)));
+        covered += count;
+      }
+      else
+      {
+        const int count = rng.bounded(0x40);
+        data.append(static_cast<char>(count));
+        for (int byteIdx = 0; byteIdx < count; byteIdx++)
+        {
+          data.append(static_cast<char>(rng.bounded(256)));
+        }
+        covered += count;
+      }
+    }
+
+    if (kind == 2)
+    {
+      data.truncate(8 + rng.bounded(data.size() - 7));
+    }
+  }
+
+  return data;
+}
+
+/**
+ * Generates a random DEL overlay: a sequence of skip, fill, single pixel, and delta sequence
+ * commands that stays within the image. The delta sequences have every length from 0 to 63,
+ * so their deltas end at every position within a group of sixteen.
+ */
+QByteArray TestImageConverter::makeDelData(QRandomGenerator& rng, int width, int height)
+{
+  const int pixelCount = width * height;
+  const int target = rng.bounded(pixelCount + 1);
+  QByteArray data(4, '\0');
+  int covered = 0;
+
+  qToLittleEndian<quint16>(static_cast<quint16>(width), data.data());
+  qToLittleEndian<quint16>(static_cast<quint16>(height), data.data() + 2);
+
+  while (covered < target)
+  {
+    const int runType = rng.bounded(4);
+    const int maxCount = qMin(0x3F, pixelCount - covered);
+    const int count = rng.bounded(maxCount + 1);
+
+    if (runType == 0)
+    {
+      // skip, with the count in the command byte or (if that is zero) in the next byte
+      if (count == 0)
+      {
+        const int longCount = rng.bounded(qMin(0xFF, pixelCount - covered) + 1);
+        data.append(static_cast<char>(0x02));
+        data.append(static_cast<char>(longCount));
+        covered += longCount;
+      }
+      else
+      {
+        data.append(static_cast<char>((count << 2) | 0x02));
+        covered += count;
+      }
+    }
+    else if (runType == 1)
+    {
+      data.append(static_cast<char>((count << 2) | 0x01));
+      data.append(static_cast<char>(rng.bounded(256)));
+      covered += count;
+    }
+    else if (runType == 2)
+    {
+      data.append(static_cast<char>(0x03));
+      data.append(static_cast<char>(rng.bounded(256)));
+      covered++;
+    }
+    else
+    {
+      // delta sequence: the first index, then (count - 1) deltas packed two per byte
+      data.append(static_cast<char>(count << 2));
+      if (count > 0)
+      {
+        data.append(static_cast<char>(rng.bounded(256)));
+        for (int byteIdx = 0; byteIdx < (count / 2); byteIdx++)
+        {
+          data.append(static_cast<char>(rng.bounded(256)));
+        }
+      }
+      covered += count;
+    }
+  }
+
+  return data;
+}
+
+/**
+ * Generates an image of random palette indices for a DEL overlay to be drawn onto, so that
+ * the pixels it skips over can be told apart from the ones it writes.
+ */
+QImage TestImageConverter::makeBaseImage(QRandomGenerator& rng, int width, int height) const
+{
+  QImage image(width, height, QImage::Format_Indexed8);
+  image.setColorTable(m_palette);
+
+  for (int y = 0; y < height; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      image.scanLine(y)[x] = static_cast<uchar>(rng.bounded(256));
+    }
+  }
+
+  return image;
+}
+
+void TestImageConverter::initTestCase()
+{
+  for (int palIdx = 0; palIdx < 256; palIdx++)
+  {
+    m_palette.append(qRgb(palIdx, 255 - palIdx, palIdx / 2));
+  }
+}
+
+void TestImageConverter::stpMatchesReference_data()
+{
+  QTest::addColumn<quint32>("seed");
+
+  for (quint32 seed = 1; seed <= 4; seed++)
+  {
+    QTest::newRow(qPrintable(QString("seed %1").arg(seed))) << seed;
+  }
+}
+
+void TestImageConverter::stpMatchesReference()
+{
+  QFETCH(quint32, seed);
+  QRandomGenerator rng(seed);
+
+  for (int imageIdx = 0; imageIdx < DIFF_IMAGES_PER_SEED; imageIdx++)
+  {
+    const QByteArray stpData = makeStpData(rng);
+    QImage refImage;
+    QImage image;
+
+    const bool refStatus = ReferenceDecoders::stpToImage(stpData, m_palette, refImage);
+    const bool status = ImageConverter::stpToImage(stpData, m_palette, image);
+
+    // when the input runs out, neither decoder writes the rest of the image, so those
+    // pixels are left uninitialized and can only be compared when decoding succeeds
+    const QString context = QString("image %1: %2").arg(imageIdx).arg(QString(stpData.toHex()));
+    QVERIFY2(status == refStatus, qPrintable(context));
+    QVERIFY2((refImage.size() == image.size()) && (refImage.colorTable() == image.colorTable()), qPrintable(context));
+    QVERIFY2(!status || (refImage == image), qPrintable(context));
+  }
+}
+
+void TestImageConverter::delMatchesReference_data()
+{
+  QTest::addColumn<quint32>("seed");
+  QTest::addColumn<int>("maxWidth");
+
+  // narrow images make the delta sequences wrap from one scanline to the next
+  QTest::newRow("narrow") << 11u << 20;
+  QTest::newRow("seed 12") << 12u << 120;
+  QTest::newRow("seed 13") << 13u << 120;
+  QTest::newRow("wide") << 14u << 400;
+}
+
+void TestImageConverter::delMatchesReference()
+{
+  QFETCH(quint32, seed);
+  QFETCH(int, maxWidth);
+  QRandomGenerator rng(seed);
+
+  for (int imageIdx = 0; imageIdx < DIFF_IMAGES_PER_SEED; imageIdx++)
+  {
+    // widths of every residue modulo 16 (not just multiples of the SSE2 group size)
+    const int width = 1 + rng.bounded(maxWidth);
+    const int height = 1 + rng.bounded(40);
+    const QByteArray delData = makeDelData(rng, width, height);
+    const QImage base = makeBaseImage(rng, width, height);
+    QImage refImage = base.copy();
+    QImage image = base.copy();
+    QImage overlayImage = base.copy();
+    DelOverlay overlay;
+
+    const bool refStatus = ReferenceDecoders::delToImage(delData, m_palette, refImage);
+    const bool status = ImageConverter::delToImage(delData, m_palette, image);
+    const bool overlayStatus = ImageConverter::delToOverlay(delData, overlay) &&
+                               ImageConverter::applyOverlay(overlay, m_palette, overlayImage);
+
+    const QString context = QString("image %1 (%2x%3): %4").arg(imageIdx).arg(width).arg(height).arg(QString(delData.toHex()));
+    QVERIFY2(refStatus && status && overlayStatus, qPrintable(context));
+    QVERIFY2(refImage == image, qPrintable(context));
+    QVERIFY2(refImage == overlayImage, qPrintable(context));
+  }
+}
+
+QTEST_GUILESS_MAIN(TestImageConverter)
+
+#include "tst_imageconverter.moc"
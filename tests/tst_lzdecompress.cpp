@@ -0,0 +1,262 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QRandomGenerator>
+#include "datlibrary.h"
+#include "referencedecoders.h"
+#include "testdatbuilder.h"
+
+//! Number of files of each kind that are put in the container
+#define LZ_FILES_PER_KIND 60
+
+//! Number of random codeword streams that are put in the container
+#define LZ_RANDOM_STREAMS 400
+
+//! Largest stored entry that the original LZ decoder can handle, since its input position is 16 bits
+#define LZ_REFERENCE_MAX_INPUT 0xFFFF
+
+//! Position in the ring buffer that the first decoded byte is written to
+#define LZ_RINGBUF_START 0xFEE
+
+//! Kinds of data that are compressed with TestDatBuilder::lzCompress()
+enum LzDataKind
+{
+  LzDataKind_Random,
+  LzDataKind_SingleByte,
+  LzDataKind_ShortPeriod,
+  LzDataKind_Text,
+  LzDataKind_DistantRepeats,
+  LzDataKind_NumKinds
+};
+
+/**
+ * Tests for DatLibrary's LZ decoder (through DatLibrary::decodeFileAtIndex()), which copies
+ * codewords as blocks where it can. Data compressed with TestDatBuilder's encoder must come
+ * back unchanged, and random codeword streams must decode to exactly what the original
+ * byte-at-a-time decoder in ReferenceDecoders produces. Both include codewords that overlap
+ * the bytes they produce and ones that wrap around the end of the 4 KB ring buffer.
+ */
+class TestLzDecompress : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void encoderRoundTrip();
+  void randomStreamsMatchReference();
+
+private:
+  static QByteArray makeData(QRandomGenerator& rng, LzDataKind kind);
+  static QByteArray makeStream(QRandomGenerator& rng);
+};
+
+/**
+ * Generates data of the provided kind. Runs of a single byte and short repeating patterns
+ * are encoded as codewords that overlap their own output; a block that repeats after a gap
+ * of several KB is encoded as codewords whose source has wrapped around the ring buffer.
+ */
+QByteArray TestLzDecompress::makeData(QRandomGenerator& rng, LzDataKind kind)
+{
+  QByteArray data;
+  const int size = rng.bounded(20000);
+
+  if (kind == LzDataKind_Random)
+  {
+    for (int byteIdx = 0; byteIdx < size; byteIdx++)
+    {
+      data.append(static_cast<char>(rng.bounded(256)));
+    }
+  }
+  else if (kind == LzDataKind_SingleByte)
+  {
+    data.fill(static_cast<char>(rng.bounded(256)), size);
+  }
+  else if (kind == LzDataKind_ShortPeriod)
+  {
+    QByteArray pattern;
+    const int period = 1 + rng.bounded(17);
+    for (int byteIdx = 0; byteIdx < period; byteIdx++)
+    {
+      pattern.append(static_cast<char>(rng.bounded(256)));
+    }
+
+    while (data.size() < size)
+    {
+      data.append(pattern);
+      if (rng.bounded(20) == 0)
+      {
+        pattern[rng.bounded(period)] = static_cast<char>(rng.bounded(256));
+      }
+    }
+  }
+  else if (kind == LzDataKind_Text)
+  {
+    const QStringList words = QString("the a of to and you ship trade planet alien commander "
+                                      "fuel cargo mission gateway station").split(' ');
+    while (data.size() < size)
+    {
+      data.append(words[rng.bounded(words.size())].toLatin1());
+      data.append((rng.bounded(10) == 0) ? '\0' : ' ');
+    }
+  }
+  else
+  {
+    QByteArray block;
+    const int blockSize = 1000 + rng.bounded(2000);
+    for (int byteIdx = 0; byteIdx < blockSize; byteIdx++)
+    {
+      block.append(static_cast<char>(rng.bounded(256)));
+    }
+
+    data = block;
+    while (data.size() < (5000 + size))
+    {
+      for (int gapIdx = rng.bounded(2000); gapIdx > 0; gapIdx--)
+      {
+        data.append(static_cast<char>(rng.bounded(256)));
+      }
+      data.append(block);
+    }
+  }
+
+  return (kind == LzDataKind_DistantRepeats) ? data : data.left(size);
+}
+
+/**
+ * Generates a random stream of literals and codewords that ends on a whole item. A third of
+ * the codewords copy from just behind the current ring buffer position (so the copy overlaps
+ * its own output), a third copy from just before the end of the ring buffer (so the source
+ * wraps), and the rest copy from anywhere.
+ */
+QByteArray TestLzDecompress::makeStream(QRandomGenerator& rng)
+{
+  QByteArray stream;
+  const int itemCount = rng.bounded(8 * 1200);
+  int produced = 0;
+  int flagPos = 0;
+
+  for (int itemIdx = 0; itemIdx < itemCount; itemIdx++)
+  {
+    if ((itemIdx % 8) == 0)
+    {
+      flagPos = stream.size();
+      stream.append('\0');
+    }
+
+    if (rng.bounded(3) == 0)
+    {
+      stream[flagPos] = static_cast<char>(stream[flagPos] | (1 << (itemIdx % 8)));
+      stream.append(static_cast<char>(rng.bounded(256)));
+      produced++;
+    }
+    else
+    {
+      const int length = 3 + rng.bounded(16);
+      const int bufPos = (LZ_RINGBUF_START + produced) & (LZ_RINGBUF_SIZE - 1);
+      const int placement = rng.bounded(3);
+      int source = 0;
+
+      if (placement == 0)
+      {
+        source = (bufPos - 1 - rng.bounded(length)) & (LZ_RINGBUF_SIZE - 1);
+      }
+      else if (placement == 1)
+      {
+        source = LZ_RINGBUF_SIZE - 1 - rng.bounded(length);
+      }
+      else
+      {
+        source = rng.bounded(LZ_RINGBUF_SIZE);
+      }
+
+      stream.append(static_cast<char>(source & 0xFF));
+      stream.append(static_cast<char>(((length - 3) << 4) | (source >> 8)));
+      produced += length;
+    }
+  }
+
+  return stream;
+}
+
+void TestLzDecompress::encoderRoundTrip()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  QRandomGenerator rng(0x4C5A3031);
+  TestDatBuilder builder;
+  QVector<QByteArray> files;
+
+  for (int kind = 0; kind < LzDataKind_NumKinds; kind++)
+  {
+    for (int fileIdx = 0; fileIdx < LZ_FILES_PER_KIND; fileIdx++)
+    {
+      const QByteArray data = makeData(rng, static_cast<LzDataKind>(kind));
+      builder.addFile(DatFileType_CONVERSE, QString("LZ%1.BIN").arg(files.size(), 4, 10, QChar('0')), data, true, (fileIdx % 2) == 1);
+      files.append(data);
+    }
+  }
+
+  QVERIFY(builder.write(dir.path()));
+  DatLibrary lib;
+  QVERIFY(lib.openData(dir.path()));
+
+  for (int fileIdx = 0; fileIdx < files.size(); fileIdx++)
+  {
+    // the odd-numbered files have the 4-byte uncompressed header
+    const QByteArray& expected = files[fileIdx];
+    const bool uncompressedHeader = ((fileIdx % LZ_FILES_PER_KIND) % 2 == 1) && (expected.size() >= 4);
+    const QByteArray stored = uncompressedHeader ? (expected.left(4) + TestDatBuilder::lzCompress(expected.mid(4))) :
+                                                   TestDatBuilder::lzCompress(expected);
+    const QString context = QString("file %1 (kind %2, %3 bytes)").arg(fileIdx).arg(fileIdx / LZ_FILES_PER_KIND).arg(expected.size());
+    QByteArray data;
+
+    QVERIFY2(lib.decodeFileAtIndex(DatFileType_CONVERSE, fileIdx, data), qPrintable(context));
+    QVERIFY2(data == expected, qPrintable(context));
+
+    if (stored.size() <= LZ_REFERENCE_MAX_INPUT)
+    {
+      QByteArray refData;
+      QVERIFY2(ReferenceDecoders::lzDecompress(stored, refData, uncompressedHeader ? 4 : 0), qPrintable(context));
+      QVERIFY2(refData.left(expected.size()) == expected, qPrintable(context));
+    }
+  }
+}
+
+void TestLzDecompress::randomStreamsMatchReference()
+{
+  QTemporaryDir dir;
+  QVERIFY(dir.isValid());
+
+  QRandomGenerator rng(0x4C5A3032);
+  TestDatBuilder builder;
+  QVector<QByteArray> expectedFiles;
+
+  for (int streamIdx = 0; streamIdx < LZ_RANDOM_STREAMS; streamIdx++)
+  {
+    const QByteArray stream = makeStream(rng);
+    QByteArray refData;
+    QVERIFY(ReferenceDecoders::lzDecompress(stream, refData, 0));
+
+    // some of the index entries list fewer bytes than the stream produces, which cuts
+    // the decoding off partway through a literal or a codeword
+    const int listedSize = (streamIdx % 4 == 3) ? rng.bounded(refData.size() + 1) : refData.size();
+    builder.addCompressedFile(DatFileType_CONVERSE, QString("RND%1.BIN").arg(streamIdx, 4, 10, QChar('0')), stream, listedSize);
+    expectedFiles.append(refData.left(listedSize));
+  }
+
+  QVERIFY(builder.write(dir.path()));
+  DatLibrary lib;
+  QVERIFY(lib.openData(dir.path()));
+
+  for (int streamIdx = 0; streamIdx < expectedFiles.size(); streamIdx++)
+  {
+    const QString context = QString("stream %1 (%2 bytes)").arg(streamIdx).arg(expectedFiles[streamIdx].size());
+    QByteArray data;
+
+    QVERIFY2(lib.decodeFileAtIndex(DatFileType_CONVERSE, streamIdx, data), qPrintable(context));
+    QVERIFY2(data == expectedFiles[streamIdx], qPrintable(context));
+  }
+}
+
+QTEST_GUILESS_MAIN(TestLzDecompress)
+
+#include "tst_lzdecompress.moc"
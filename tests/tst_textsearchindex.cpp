@@ -0,0 +1,237 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtMath>
+#include "textsearchindex.h"
+#include "testdatbuilder.h"
+
+/**
+ * Tests for the text search index: which documents a query matches, how the hits are ranked,
+ * and whether a saved index is loaded again (or rejected) as it should be. The documents are
+ * small enough that the expected scores can be worked out by hand from the weighting that
+ * TextSearchIndex::addTermScores() describes.
+ */
+class TestTextSearchIndex : public QObject
+{
+  Q_OBJECT
+
+private slots:
+  void init();
+  void matchesAllWords();
+  void prefixMatchHasHalfWeight();
+  void ranksByScore();
+  void breaksTiesByDocIndex();
+  void truncatesToMaxHits();
+  void saveAndLoad();
+  void loadRejectsOtherSignature();
+  void loadRejectsOtherVersion();
+  void loadRejectsBadDocIndex();
+
+private:
+  DatLibrary m_lib;
+  QTemporaryDir m_dir;
+
+  static QVector<TextSearchDoc> makeDocs();
+  static QVector<int> getDocIndices(const QVector<TextSearchHit>& hits);
+};
+
+QVector<TextSearchDoc> TestTextSearchIndex::makeDocs()
+{
+  const QStringList texts = QStringList()
+    << "alpha beta"
+    << "alpha gamma"
+    << "alphabet soup"
+    << "beta alpha"
+    << "delta"
+    << "delta delta epsilon zeta omega kappa"
+    << "delta rho sigma tau";
+  QVector<TextSearchDoc> docs;
+
+  for (int docIdx = 0; docIdx < texts.size(); docIdx++)
+  {
+    TextSearchDoc doc;
+    doc.source = static_cast<TextSourceType>(docIdx % (TextSourceType_ShipName + 1));
+    doc.id = 100 + docIdx;
+    doc.subId = docIdx & 1;
+    doc.text = texts[docIdx];
+    docs.append(doc);
+  }
+
+  return docs;
+}
+
+QVector<int> TestTextSearchIndex::getDocIndices(const QVector<TextSearchHit>& hits)
+{
+  QVector<int> indices;
+
+  foreach (const TextSearchHit& hit, hits)
+  {
+    indices.append(hit.docIndex);
+  }
+
+  return indices;
+}
+
+void TestTextSearchIndex::init()
+{
+  QVERIFY(m_dir.isValid());
+}
+
+void TestTextSearchIndex::matchesAllWords()
+{
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+
+  // "alphabet soup" starts with "alpha" but doesn't contain "beta", and "alpha gamma" doesn't either
+  QCOMPARE(getDocIndices(index.search("alpha beta", 10)), QVector<int>() << 0 << 3);
+  QCOMPARE(getDocIndices(index.search("Alpha, GAMMA!", 10)), QVector<int>() << 1);
+  QVERIFY(index.search("alpha zeta", 10).isEmpty());
+  QVERIFY(index.search("nothing", 10).isEmpty());
+}
+
+void TestTextSearchIndex::prefixMatchHasHalfWeight()
+{
+  const QVector<TextSearchDoc> docs = makeDocs();
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(docs));
+
+  const QVector<TextSearchHit> hits = index.search("alpha", 10);
+  QCOMPARE(getDocIndices(hits), QVector<int>() << 0 << 1 << 3 << 2);
+
+  // "alpha" is in three of the documents, and "alphabet" is in one; all of them have two words,
+  // so the rarer term would rank first if it weren't only a prefix match
+  const double alphaScore = qLn(1.0 + docs.size() / 3.0) / qSqrt(2.0);
+  const double alphabetScore = 0.5 * qLn(1.0 + docs.size() / 1.0) / qSqrt(2.0);
+  QVERIFY(qFuzzyCompare(hits[0].score, alphaScore));
+  QVERIFY(qFuzzyCompare(hits[3].score, alphabetScore));
+}
+
+void TestTextSearchIndex::ranksByScore()
+{
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+
+  // the shortest document ranks first, and repeating the word lets a longer document outrank a shorter one
+  const QVector<TextSearchHit> hits = index.search("delta", 10);
+  QCOMPARE(getDocIndices(hits), QVector<int>() << 4 << 5 << 6);
+  QVERIFY(hits[0].score > hits[1].score);
+  QVERIFY(hits[1].score > hits[2].score);
+}
+
+void TestTextSearchIndex::breaksTiesByDocIndex()
+{
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+
+  const QVector<TextSearchHit> hits = index.search("beta alpha", 10);
+  QCOMPARE(getDocIndices(hits), QVector<int>() << 0 << 3);
+  QCOMPARE(hits[0].score, hits[1].score);
+}
+
+void TestTextSearchIndex::truncatesToMaxHits()
+{
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+
+  QCOMPARE(getDocIndices(index.search("delta", 2)), QVector<int>() << 4 << 5);
+  QCOMPARE(getDocIndices(index.search("alpha", 1)), QVector<int>() << 0);
+  QVERIFY(index.search("delta", 0).isEmpty());
+  QVERIFY(index.search("delta", -1).isEmpty());
+}
+
+void TestTextSearchIndex::saveAndLoad()
+{
+  const QString filename = m_dir.filePath("index.bin");
+  const QStringList queries = QStringList() << "alpha" << "delta" << "beta alpha" << "al" << "soup";
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+  QVERIFY(index.save(filename));
+
+  TextSearchIndex loaded(m_lib);
+  QVERIFY(loaded.load(filename));
+  QVERIFY(!loaded.isEmpty());
+
+  foreach (const QString& query, queries)
+  {
+    const QVector<TextSearchHit> hits = index.search(query, 10);
+    const QVector<TextSearchHit> loadedHits = loaded.search(query, 10);
+
+    QCOMPARE(getDocIndices(loadedHits), getDocIndices(hits));
+    for (int hitIdx = 0; hitIdx < hits.size(); hitIdx++)
+    {
+      QCOMPARE(loadedHits[hitIdx].score, hits[hitIdx].score);
+    }
+  }
+
+  const QVector<TextSearchDoc> docs = makeDocs();
+  for (int docIdx = 0; docIdx < docs.size(); docIdx++)
+  {
+    QCOMPARE(loaded.getDocument(docIdx).source, docs[docIdx].source);
+    QCOMPARE(loaded.getDocument(docIdx).id, docs[docIdx].id);
+    QCOMPARE(loaded.getDocument(docIdx).subId, docs[docIdx].subId);
+    QCOMPARE(loaded.getDocument(docIdx).text, docs[docIdx].text);
+  }
+}
+
+void TestTextSearchIndex::loadRejectsOtherSignature()
+{
+  const QString filename = m_dir.filePath("index.bin");
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+  QVERIFY(index.save(filename));
+
+  // the index was saved with no game data open, so any opened data has a different signature
+  const QString gameDir = m_dir.filePath("game");
+  QVERIFY(QDir().mkpath(gameDir));
+  QVERIFY(TestDatBuilder().write(gameDir));
+
+  DatLibrary otherLib;
+  QVERIFY(otherLib.openData(gameDir));
+  QVERIFY(otherLib.getDataSignature() != m_lib.getDataSignature());
+
+  TextSearchIndex loaded(otherLib);
+  QVERIFY(!loaded.load(filename));
+  QVERIFY(loaded.isEmpty());
+}
+
+void TestTextSearchIndex::loadRejectsOtherVersion()
+{
+  const QString filename = m_dir.filePath("index.bin");
+  TextSearchIndex index(m_lib);
+  QVERIFY(index.build(makeDocs()));
+  QVERIFY(index.save(filename));
+
+  // the version follows the magic number
+  QFile indexFile(filename);
+  QVERIFY(indexFile.open(QIODevice::ReadWrite));
+  QVERIFY(indexFile.seek(4));
+  QDataStream ds(&indexFile);
+  ds << quint32(TEXT_SEARCH_INDEX_VERSION + 1);
+  indexFile.close();
+
+  TextSearchIndex loaded(m_lib);
+  QVERIFY(!loaded.load(filename));
+  QVERIFY(loaded.isEmpty());
+}
+
+void TestTextSearchIndex::loadRejectsBadDocIndex()
+{
+  const QString filename = m_dir.filePath("index.bin");
+  QFile indexFile(filename);
+  QVERIFY(indexFile.open(QIODevice::WriteOnly));
+
+  // one document, and one term whose posting refers to a document that doesn't exist
+  QDataStream ds(&indexFile);
+  ds.setVersion(QDataStream::Qt_5_12);
+  ds << quint32(TEXT_SEARCH_INDEX_MAGIC) << quint32(TEXT_SEARCH_INDEX_VERSION) << m_lib.getDataSignature();
+  ds << qint32(1) << qint32(TextSourceType_Fact) << qint32(1) << qint32(0) << QString("alpha");
+  ds << qint32(1) << QString("alpha") << qint32(1) << qint32(1) << qint32(1);
+  indexFile.close();
+
+  TextSearchIndex loaded(m_lib);
+  QVERIFY(!loaded.load(filename));
+  QVERIFY(loaded.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestTextSearchIndex)
+
+#include "tst_textsearchindex.moc"
@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <QFile>
+#include <QtMath>
+#include <QtConcurrent/QtConcurrentMap>
+#include "textsearchindex.h"
+
+//! Weight of a match on a longer word that starts with a query word, relative to a match on the whole word
+#define TEXT_SEARCH_PREFIX_WEIGHT 0.5
+
+TextSearchIndex::TextSearchIndex(DatLibrary& lib) :
+  m_lib(&lib)
+{
+}
+
+/**
+ * Discards the index, which must be done whenever the game data is closed.
+ */
+void TextSearchIndex::clear()
+{
+  m_docs.clear();
+  m_terms.clear();
+  m_postings.clear();
+  m_docWordCounts.clear();
+}
+
+/**
+ * Returns true if the index hasn't been built or loaded.
+ */
+bool TextSearchIndex::isEmpty() const
+{
+  return m_terms.isEmpty();
+}
+
+/**
+ * Breaks a piece of text into lowercase words, which are runs of letters and digits.
+ * Apostrophes are dropped without ending the word, so that "don't" is found by "dont".
+ */
+QStringList TextSearchIndex::getWords(const QString& text)
+{
+  QStringList words;
+  QString word;
+
+  for (int charIdx = 0; charIdx < text.size(); charIdx++)
+  {
+    const QChar c = text.at(charIdx);
+
+    if (c.isLetterOrNumber())
+    {
+      word.append(c.toLower());
+    }
+    else if ((c != '\'') && !word.isEmpty())
+    {
+      words.append(word);
+      word.clear();
+    }
+  }
+
+  if (!word.isEmpty())
+  {
+    words.append(word);
+  }
+
+  return words;
+}
+
+/**
+ * Counts the occurrences of each word in a single document. This runs on a thread from the
+ * global pool.
+ */
+QHash<QString,int> TextSearchIndex::countTerms(const TextSearchDoc& doc)
+{
+  QHash<QString,int> counts;
+
+  foreach (const QString& word, getWords(doc.text))
+  {
+    counts[word]++;
+  }
+
+  return counts;
+}
+
+/**
+ * Builds the index from the provided documents. The documents are broken into words in
+ * parallel, and their postings are then merged in document order.
+ * @return True if any of the documents had at least one word; false otherwise.
+ */
+bool TextSearchIndex::build(const QVector<TextSearchDoc>& docs)
+{
+  clear();
+  m_docs = docs;
+
+  const QList<QHash<QString,int> > docTerms =
+    QtConcurrent::blockingMapped<QList<QHash<QString,int> > >(m_docs, &TextSearchIndex::countTerms);
+
+  QHash<QString,QVector<Posting> > postingsByTerm;
+  for (int docIdx = 0; docIdx < docTerms.size(); docIdx++)
+  {
+    QHash<QString,int>::const_iterator term;
+    for (term = docTerms[docIdx].constBegin(); term != docTerms[docIdx].constEnd(); ++term)
+    {
+      Posting posting;
+      posting.docIndex = docIdx;
+      posting.count = term.value();
+      postingsByTerm[term.key()].append(posting);
+    }
+  }
+
+  m_terms = postingsByTerm.keys().toVector();
+  std::sort(m_terms.begin(), m_terms.end());
+
+  m_postings.reserve(m_terms.size());
+  foreach (const QString& term, m_terms)
+  {
+    m_postings.append(postingsByTerm.value(term));
+  }
+
+  countDocWords();
+
+  return !m_terms.isEmpty();
+}
+
+/**
+ * Totals the number of words in each document from the postings, which saves having to
+ * store the totals in the index file.
+ */
+void TextSearchIndex::countDocWords()
+{
+  m_docWordCounts.fill(0, m_docs.size());
+
+  foreach (const QVector<Posting>& postings, m_postings)
+  {
+    foreach (const Posting& posting, postings)
+    {
+      m_docWordCounts[posting.docIndex] += posting.count;
+    }
+  }
+}
+
+/**
+ * Adds the score that each document earns for a single query word. The word matches every
+ * term that starts with it, so that results can be shown while the word is still being typed.
+ * Rare terms count for more than common ones, and whole-word matches count for more than
+ * prefix matches.
+ */
+void TextSearchIndex::addTermScores(const QString& word, QHash<int,double>& scores) const
+{
+  QVector<QString>::const_iterator term = std::lower_bound(m_terms.constBegin(), m_terms.constEnd(), word);
+
+  while ((term != m_terms.constEnd()) && term->startsWith(word))
+  {
+    const QVector<Posting>& postings = m_postings.at(term - m_terms.constBegin());
+    double weight = qLn(1.0 + static_cast<double>(m_docs.size()) / postings.size());
+
+    if (*term != word)
+    {
+      weight *= TEXT_SEARCH_PREFIX_WEIGHT;
+    }
+
+    foreach (const Posting& posting, postings)
+    {
+      scores[posting.docIndex] += weight * posting.count / qSqrt(m_docWordCounts.at(posting.docIndex));
+    }
+
+    ++term;
+  }
+}
+
+static bool isHigherRanked(const TextSearchHit& a, const TextSearchHit& b)
+{
+  return (a.score > b.score) || ((a.score == b.score) && (a.docIndex < b.docIndex));
+}
+
+/**
+ * Finds the documents that contain every word in the query (or a word that starts with it),
+ * and returns the highest ranked of them in descending order of relevance.
+ */
+QVector<TextSearchHit> TextSearchIndex::search(const QString& query, int maxHits) const
+{
+  QVector<TextSearchHit> hits;
+  const QStringList words = getWords(query);
+  QHash<int,double> scores;
+
+  for (int wordIdx = 0; wordIdx < words.size(); wordIdx++)
+  {
+    if (wordIdx == 0)
+    {
+      addTermScores(words[wordIdx], scores);
+    }
+    else
+    {
+      QHash<int,double> wordScores;
+      addTermScores(words[wordIdx], wordScores);
+
+      QHash<int,double>::iterator docScore = scores.begin();
+      while (docScore != scores.end())
+      {
+        if (wordScores.contains(docScore.key()))
+        {
+          docScore.value() += wordScores.value(docScore.key());
+          ++docScore;
+        }
+        else
+        {
+          docScore = scores.erase(docScore);
+        }
+      }
+    }
+  }
+
+  hits.reserve(scores.size());
+  for (QHash<int,double>::const_iterator docScore = scores.constBegin(); docScore != scores.constEnd(); ++docScore)
+  {
+    TextSearchHit hit;
+    hit.docIndex = docScore.key();
+    hit.score = docScore.value();
+    hits.append(hit);
+  }
+
+  // only the hits that will be returned have to be put in order
+  const int hitCount = qMin(qMax(maxHits, 0), hits.size());
+  std::partial_sort(hits.begin(), hits.begin() + hitCount, hits.end(), &isHigherRanked);
+  hits.resize(hitCount);
+
+  return hits;
+}
+
+/**
+ * Gets the document with the provided index, which must be taken from a TextSearchHit.
+ */
+const TextSearchDoc& TextSearchIndex::getDocument(int docIndex) const
+{
+  return m_docs.at(docIndex);
+}
+
+/**
+ * Saves the index to the specified file, along with the signature of the game data
+ * that it was built from.
+ * @return True if the file was written; false otherwise.
+ */
+bool TextSearchIndex::save(const QString& filename) const
+{
+  bool status = false;
+  QFile outFile(filename);
+
+  if (outFile.open(QIODevice::WriteOnly))
+  {
+    QDataStream ds(&outFile);
+    ds.setVersion(QDataStream::Qt_5_12);
+
+    ds << quint32(TEXT_SEARCH_INDEX_MAGIC) << quint32(TEXT_SEARCH_INDEX_VERSION);
+    ds << m_lib->getDataSignature();
+
+    ds << qint32(m_docs.size());
+    foreach (const TextSearchDoc& doc, m_docs)
+    {
+      ds << qint32(doc.source) << qint32(doc.id) << qint32(doc.subId) << doc.text;
+    }
+
+    ds << qint32(m_terms.size());
+    for (int termIdx = 0; termIdx < m_terms.size(); termIdx++)
+    {
+      ds << m_terms[termIdx] << qint32(m_postings[termIdx].size());
+
+      foreach (const Posting& posting, m_postings[termIdx])
+      {
+        ds << qint32(posting.docIndex) << qint32(posting.count);
+      }
+    }
+
+    status = (ds.status() == QDataStream::Ok);
+    outFile.close();
+  }
+
+  return status;
+}
+
+/**
+ * Loads an index that was previously saved to the specified file. The file is rejected if
+ * it has a different format version, or if it was built from game data with a different
+ * signature than the data that is open now.
+ * @return True if the index was loaded; false otherwise.
+ */
+bool TextSearchIndex::load(const QString& filename)
+{
+  bool status = false;
+  QFile inFile(filename);
+
+  clear();
+
+  if (inFile.open(QIODevice::ReadOnly))
+  {
+    QDataStream ds(&inFile);
+    ds.setVersion(QDataStream::Qt_5_12);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QByteArray signature;
+    ds >> magic >> version >> signature;
+
+    status = (magic == TEXT_SEARCH_INDEX_MAGIC) && (version == TEXT_SEARCH_INDEX_VERSION) &&
+             (signature == m_lib->getDataSignature());
+
+    qint32 docCount = 0;
+    if (status)
+    {
+      ds >> docCount;
+      status = (docCount > 0);
+    }
+
+    for (int docIdx = 0; status && (docIdx < docCount); docIdx++)
+    {
+      TextSearchDoc doc;
+      qint32 source = 0;
+      qint32 id = 0;
+      qint32 subId = 0;
+      ds >> source >> id >> subId >> doc.text;
+
+      doc.source = static_cast<TextSourceType>(source);
+      doc.id = id;
+      doc.subId = subId;
+
+      m_docs.append(doc);
+      status = (ds.status() == QDataStream::Ok);
+    }
+
+    qint32 termCount = 0;
+    if (status)
+    {
+      ds >> termCount;
+      status = (termCount > 0);
+    }
+
+    for (int termIdx = 0; status && (termIdx < termCount); termIdx++)
+    {
+      QString term;
+      qint32 postingCount = 0;
+      ds >> term >> postingCount;
+
+      QVector<Posting> postings;
+      for (int postingIdx = 0; (ds.status() == QDataStream::Ok) && (postingIdx < postingCount); postingIdx++)
+      {
+        Posting posting;
+        qint32 docIndex = 0;
+        qint32 count = 0;
+        ds >> docIndex >> count;
+
+        posting.docIndex = docIndex;
+        posting.count = count;
+        postings.append(posting);
+
+        // a corrupt file mustn't be able to point past the end of the document list
+        if ((docIndex < 0) || (docIndex >= m_docs.size()))
+        {
+          ds.setStatus(QDataStream::ReadCorruptData);
+        }
+      }
+
+      m_terms.append(term);
+      m_postings.append(postings);
+      status = (ds.status() == QDataStream::Ok);
+    }
+
+    inFile.close();
+  }
+
+  if (status)
+  {
+    countDocWords();
+  }
+  else
+  {
+    clear();
+  }
+
+  return status;
+}
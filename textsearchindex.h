@@ -0,0 +1,115 @@
+#ifndef TEXTSEARCHINDEX_H
+#define TEXTSEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QDataStream>
+#include "datlibrary.h"
+
+//! Identifies a text search index file ("NTSI")
+#define TEXT_SEARCH_INDEX_MAGIC 0x4953544E
+
+//! Version of the text search index file format; bump this whenever the format changes
+#define TEXT_SEARCH_INDEX_VERSION 1
+
+//! Places in the game data that a searchable piece of text comes from
+enum TextSourceType
+{
+  TextSourceType_Fact,
+  TextSourceType_Mission,
+  TextSourceType_AlienLine,
+  TextSourceType_ObjectName,
+  TextSourceType_ObjectText,
+  TextSourceType_AlienName,
+  TextSourceType_PlaceName,
+  TextSourceType_ShipName
+};
+
+static const QMap<TextSourceType,QString> g_textSourceTypeName =
+{
+  { TextSourceType_Fact,       "Fact" },
+  { TextSourceType_Mission,    "Mission" },
+  { TextSourceType_AlienLine,  "Dialogue" },
+  { TextSourceType_ObjectName, "Object name" },
+  { TextSourceType_ObjectText, "Object description" },
+  { TextSourceType_AlienName,  "Alien name" },
+  { TextSourceType_PlaceName,  "Place name" },
+  { TextSourceType_ShipName,   "Ship name" }
+};
+
+/**
+ * A searchable piece of text, and where it comes from. The ID is that of the fact, mission,
+ * object, alien, place, or ship; for a line of dialogue it is the ID of the alien or race that
+ * speaks it. The sub-ID distinguishes several texts from the same source: it is 0 for a
+ * mission's start text and 1 for its completion text, and it is the ConvTableType of a line
+ * of dialogue.
+ */
+struct TextSearchDoc
+{
+  TextSourceType source;
+  int id;
+  int subId;
+  QString text;
+};
+
+//! A document that matched a search, and its relevance (higher is better)
+struct TextSearchHit
+{
+  int docIndex;
+  double score;
+};
+
+/**
+ * Inverted index over the plain text of every fact, mission, line of dialogue, and named
+ * entity in the game data, which answers word and word-prefix queries with ranked hits.
+ * The documents are broken into words in parallel when the index is built, and the index
+ * can be saved to disk and loaded again in later sessions.
+ *
+ * Thread safety: build() and load() may run on a worker thread, as long as nothing searches
+ * the index until they have finished. The queries are const and may then be made from any
+ * thread.
+ */
+class TextSearchIndex
+{
+public:
+  TextSearchIndex(DatLibrary& lib);
+
+  void clear();
+  bool isEmpty() const;
+  bool build(const QVector<TextSearchDoc>& docs);
+  bool load(const QString& filename);
+  bool save(const QString& filename) const;
+
+  QVector<TextSearchHit> search(const QString& query, int maxHits) const;
+  const TextSearchDoc& getDocument(int docIndex) const;
+
+  static QStringList getWords(const QString& text);
+
+private:
+  //! The documents that a term appears in, and how many times it appears in each
+  struct Posting
+  {
+    int docIndex;
+    int count;
+  };
+
+  DatLibrary* m_lib;
+
+  QVector<TextSearchDoc> m_docs;
+  //! Every distinct term in the documents, in sorted order so that prefixes can be found by binary search
+  QVector<QString> m_terms;
+  //! The postings for each term in m_terms, in ascending order of document index
+  QVector<QVector<Posting> > m_postings;
+  //! The number of words in each document, so that long documents don't outrank short ones just by being long
+  QVector<int> m_docWordCounts;
+
+  static QHash<QString,int> countTerms(const TextSearchDoc& doc);
+  void countDocWords();
+  void addTermScores(const QString& word, QHash<int,double>& scores) const;
+};
+
+#endif // TEXTSEARCHINDEX_H